@@ -0,0 +1,476 @@
+// End-to-end latency/throughput harness.
+//
+// Generates a deterministic synthetic corpus (images of several resolutions
+// and formats, short MJPEG videos of several lengths), then drives
+// AIDetector::detectImage/detectVideo from a fixed number of concurrent
+// clients per level. Each client owns its own detector, as independent
+// server workers would. Reports p50/p90/p99 latency, throughput and peak
+// RSS per workload and concurrency, and compares them against a JSON
+// baseline: exits 1 when any metric is worse than the baseline by more than
+// the tolerance. Without a baseline file, the results are written as the new
+// baseline.
+
+#include "../include/ai_detector.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct HarnessOptions {
+    std::string corpus = "e2e_corpus";
+    std::string baseline;
+    std::string model;
+    std::vector<int> concurrency = {1, 2, 4};
+    int image_passes = 3;           // Times every image is scored per level
+    int video_passes = 1;
+    size_t threads_per_client = 1;  // Pool size of each client's detector
+    double tolerance = 0.2;         // Allowed relative regression
+    bool write_baseline = false;
+};
+
+struct LevelResult {
+    std::string workload;
+    int concurrency = 0;
+    size_t requests = 0;
+    double p50_ms = 0.0;
+    double p90_ms = 0.0;
+    double p99_ms = 0.0;
+    double throughput = 0.0;        // Requests per second
+    double peak_rss_mb = 0.0;
+};
+
+// Bumped whenever the generator changes, so stale corpora are not reused
+constexpr int CORPUS_VERSION = 1;
+constexpr uint64_t CORPUS_SEED = 0x5EED2024;
+
+// Peak resident set size of the process so far
+double peakRssMegabytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    }
+    return 0.0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);    // Bytes
+#else
+    return usage.ru_maxrss / 1024.0;               // Kilobytes
+#endif
+#endif
+}
+
+// Photo-like test content: a two-colour gradient, filled shapes, blur and grain
+cv::Mat syntheticImage(cv::RNG& rng, int width, int height) {
+    cv::Mat image(height, width, CV_8UC3);
+    cv::Vec3f from(rng.uniform(0.0f, 255.0f), rng.uniform(0.0f, 255.0f), rng.uniform(0.0f, 255.0f));
+    cv::Vec3f to(rng.uniform(0.0f, 255.0f), rng.uniform(0.0f, 255.0f), rng.uniform(0.0f, 255.0f));
+    for (int y = 0; y < height; ++y) {
+        float t = static_cast<float>(y) / std::max(1, height - 1);
+        cv::Vec3f color = from * (1.0f - t) + to * t;
+        image.row(y).setTo(cv::Scalar(color[0], color[1], color[2]));
+    }
+
+    int shapes = 8 + rng.uniform(0, 16);
+    for (int i = 0; i < shapes; ++i) {
+        cv::Scalar color(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+        cv::Point center(rng.uniform(0, width), rng.uniform(0, height));
+        int radius = rng.uniform(4, std::max(5, std::min(width, height) / 4));
+        if (rng.uniform(0, 2) == 0) {
+            cv::circle(image, center, radius, color, cv::FILLED, cv::LINE_AA);
+        } else {
+            cv::rectangle(image, cv::Rect(center.x, center.y, radius * 2, radius), color, cv::FILLED);
+        }
+    }
+    cv::GaussianBlur(image, image, cv::Size(5, 5), 1.2);
+
+    cv::Mat grain(height, width, CV_16SC3);
+    rng.fill(grain, cv::RNG::NORMAL, 0, 6);
+    cv::Mat noisy;
+    image.convertTo(noisy, CV_16SC3);
+    noisy += grain;
+    noisy.convertTo(image, CV_8UC3);
+    return image;
+}
+
+// Write the corpus under <directory>/v<CORPUS_VERSION> unless it is already there
+bool prepareCorpus(const std::string& directory, std::vector<std::string>& images, std::vector<std::string>& videos) {
+    namespace fs = std::filesystem;
+    fs::path root = fs::path(directory) / ("v" + std::to_string(CORPUS_VERSION));
+    std::error_code error;
+    fs::create_directories(root, error);
+    if (error) {
+        std::cerr << "Cannot create corpus directory: " << root.string() << std::endl;
+        return false;
+    }
+
+    const std::vector<cv::Size> resolutions = {{320, 240}, {640, 480}, {1280, 720}, {1920, 1080}};
+    const std::vector<std::string> formats = {".jpg", ".png", ".bmp"};
+    const int images_per_kind = 2;
+    int index = 0;
+    for (const auto& size : resolutions) {
+        for (const auto& format : formats) {
+            for (int i = 0; i < images_per_kind; ++i, ++index) {
+                char name[64];
+                std::snprintf(name, sizeof(name), "image_%dx%d_%d%s", size.width, size.height, i, format.c_str());
+                fs::path path = root / name;
+                if (!fs::exists(path)) {
+                    cv::RNG rng(CORPUS_SEED + index);
+                    if (!cv::imwrite(path.string(), syntheticImage(rng, size.width, size.height))) {
+                        std::cerr << "Failed to write " << path.string() << std::endl;
+                        return false;
+                    }
+                }
+                images.push_back(path.string());
+            }
+        }
+    }
+
+    // Short clips of a drifting scene; MJPEG in AVI is the most widely available writer
+    const cv::Size frame_size(640, 360);
+    for (int frames : {30, 60, 120}) {
+        fs::path path = root / ("video_" + std::to_string(frames) + "f.avi");
+        if (!fs::exists(path)) {
+            cv::VideoWriter writer(path.string(), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 30.0, frame_size);
+            if (!writer.isOpened()) {
+                std::cerr << "No MJPEG video writer; skipping video workloads" << std::endl;
+                break;
+            }
+            cv::RNG rng(CORPUS_SEED + 1000 + frames);
+            cv::Mat scene = syntheticImage(rng, frame_size.width * 2, frame_size.height * 2);
+            for (int f = 0; f < frames; ++f) {
+                int x = (f * 5) % frame_size.width;
+                int y = (f * 3) % frame_size.height;
+                cv::Mat frame = scene(cv::Rect(x, y, frame_size.width, frame_size.height)).clone();
+                cv::circle(frame, cv::Point((f * 11) % frame_size.width, frame_size.height / 2), 24,
+                           cv::Scalar(40, 200, 240), cv::FILLED, cv::LINE_AA);
+                writer.write(frame);
+            }
+        }
+        videos.push_back(path.string());
+    }
+    return true;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Run every input `passes` times from `clients` threads, each with its own detector
+bool runLevel(const std::string& workload, const std::vector<std::string>& inputs, int clients,
+              int passes, const HarnessOptions& options, LevelResult& result) {
+    std::vector<std::unique_ptr<AIDetector>> detectors;
+    for (int c = 0; c < clients; ++c) {
+        detectors.push_back(std::make_unique<AIDetector>(options.threads_per_client));
+        if (!detectors.back()->initialize(options.model)) {
+            return false;
+        }
+    }
+    bool video = workload == "video";
+    auto score = [video](AIDetector& detector, const std::string& path) {
+        return video ? detector.detectVideo(path) : detector.detectImage(path);
+    };
+
+    // Warm up every detector on one input so first-touch costs are not timed
+    for (auto& detector : detectors) {
+        score(*detector, inputs.front());
+    }
+
+    const size_t total = inputs.size() * static_cast<size_t>(passes);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::vector<double>> latencies(clients);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c]() {
+            for (size_t i = next++; i < total; i = next++) {
+                auto begin = std::chrono::steady_clock::now();
+                float confidence = score(*detectors[c], inputs[i % inputs.size()]);
+                auto end = std::chrono::steady_clock::now();
+                if (confidence < 0.0f) {
+                    failed = true;
+                }
+                latencies[c].push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (const auto& client : latencies) {
+        all.insert(all.end(), client.begin(), client.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    result.workload = workload;
+    result.concurrency = clients;
+    result.requests = all.size();
+    result.p50_ms = percentile(all, 0.50);
+    result.p90_ms = percentile(all, 0.90);
+    result.p99_ms = percentile(all, 0.99);
+    result.throughput = seconds > 0.0 ? all.size() / seconds : 0.0;
+    result.peak_rss_mb = peakRssMegabytes();
+    return !failed;
+}
+
+std::string resultKey(const std::string& workload, int concurrency) {
+    return workload + "@" + std::to_string(concurrency);
+}
+
+bool writeBaseline(const std::string& path, const std::vector<LevelResult>& results) {
+    std::ofstream out(path);
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"version\": 1,\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const LevelResult& r = results[i];
+        out << "    {\"workload\": \"" << r.workload << "\", \"concurrency\": " << r.concurrency
+            << ", \"p50_ms\": " << r.p50_ms << ", \"p90_ms\": " << r.p90_ms << ", \"p99_ms\": " << r.p99_ms
+            << ", \"throughput\": " << r.throughput << ", \"peak_rss_mb\": " << r.peak_rss_mb << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Reads the flat objects of the "results" array written by writeBaseline
+bool readBaseline(const std::string& path, std::map<std::string, LevelResult>& baseline) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t results = text.find("\"results\"");
+    if (results == std::string::npos) {
+        return false;
+    }
+
+    for (size_t open = text.find('{', results); open != std::string::npos; open = text.find('{', open + 1)) {
+        size_t close = text.find('}', open);
+        if (close == std::string::npos) {
+            return false;
+        }
+        // "key": value pairs; string values are quoted
+        std::map<std::string, std::string> fields;
+        std::string object = text.substr(open + 1, close - open - 1);
+        std::stringstream pairs(object);
+        std::string pair;
+        while (std::getline(pairs, pair, ',')) {
+            size_t colon = pair.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            auto unquote = [](std::string value) {
+                value.erase(0, value.find_first_not_of(" \t\r\n\""));
+                value.erase(value.find_last_not_of(" \t\r\n\"") + 1);
+                return value;
+            };
+            fields[unquote(pair.substr(0, colon))] = unquote(pair.substr(colon + 1));
+        }
+
+        try {
+            LevelResult r;
+            r.workload = fields.at("workload");
+            r.concurrency = std::stoi(fields.at("concurrency"));
+            r.p50_ms = std::stod(fields.at("p50_ms"));
+            r.p90_ms = std::stod(fields.at("p90_ms"));
+            r.p99_ms = std::stod(fields.at("p99_ms"));
+            r.throughput = std::stod(fields.at("throughput"));
+            r.peak_rss_mb = std::stod(fields.at("peak_rss_mb"));
+            baseline[resultKey(r.workload, r.concurrency)] = r;
+        } catch (const std::exception&) {
+            std::cerr << "Malformed baseline entry: {" << object << "}" << std::endl;
+            return false;
+        }
+        open = close;
+    }
+    return true;
+}
+
+// Print every metric that is worse than the baseline by more than the tolerance
+int countRegressions(const std::vector<LevelResult>& results, const std::map<std::string, LevelResult>& baseline,
+                     double tolerance) {
+    int regressions = 0;
+    auto check = [&](const LevelResult& r, const char* metric, double current, double reference, bool higher_is_better) {
+        if (reference <= 0.0) {
+            return;
+        }
+        double change = (current - reference) / reference;
+        bool regressed = higher_is_better ? change < -tolerance : change > tolerance;
+        if (regressed) {
+            ++regressions;
+            std::cout << "REGRESSION " << resultKey(r.workload, r.concurrency) << " " << metric << ": "
+                      << std::fixed << std::setprecision(2) << current << " vs baseline " << reference
+                      << " (" << std::showpos << change * 100.0 << std::noshowpos << "%)" << std::endl;
+        }
+    };
+
+    for (const auto& r : results) {
+        auto it = baseline.find(resultKey(r.workload, r.concurrency));
+        if (it == baseline.end()) {
+            std::cout << "No baseline for " << resultKey(r.workload, r.concurrency) << std::endl;
+            continue;
+        }
+        const LevelResult& b = it->second;
+        check(r, "p50_ms", r.p50_ms, b.p50_ms, false);
+        check(r, "p90_ms", r.p90_ms, b.p90_ms, false);
+        check(r, "p99_ms", r.p99_ms, b.p99_ms, false);
+        check(r, "throughput", r.throughput, b.throughput, true);
+        check(r, "peak_rss_mb", r.peak_rss_mb, b.peak_rss_mb, false);
+    }
+    return regressions;
+}
+
+void printUsage() {
+    std::cout << "Usage: e2e_harness [--corpus <dir>] [--baseline <json>] [--write-baseline on]\n";
+    std::cout << "                   [--tolerance <f>] [--concurrency <n,..>] [--image-passes <n>]\n";
+    std::cout << "                   [--video-passes <n>] [--client-threads <n>] [--model <path>]\n";
+}
+
+bool parseOptions(int argc, char* argv[], HarnessOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0 || i + 1 >= argc) {
+            return false;
+        }
+        std::string name = arg.substr(2);
+        std::string value = argv[++i];
+        if (name == "corpus") {
+            options.corpus = value;
+        } else if (name == "baseline") {
+            options.baseline = value;
+        } else if (name == "write-baseline") {
+            options.write_baseline = value == "on" || value == "1" || value == "true";
+        } else if (name == "model") {
+            options.model = value;
+        } else if (name == "tolerance") {
+            options.tolerance = std::stod(value);
+        } else if (name == "image-passes") {
+            options.image_passes = std::max(1, std::stoi(value));
+        } else if (name == "video-passes") {
+            options.video_passes = std::max(1, std::stoi(value));
+        } else if (name == "client-threads") {
+            options.threads_per_client = static_cast<size_t>(std::max(1, std::stoi(value)));
+        } else if (name == "concurrency") {
+            options.concurrency.clear();
+            std::stringstream levels(value);
+            std::string level;
+            while (std::getline(levels, level, ',')) {
+                options.concurrency.push_back(std::max(1, std::stoi(level)));
+            }
+        } else {
+            return false;
+        }
+    }
+    return !options.concurrency.empty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    HarnessOptions options;
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            printUsage();
+            return 2;
+        }
+    } catch (const std::exception&) {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<std::string> images;
+    std::vector<std::string> videos;
+    if (!prepareCorpus(options.corpus, images, videos)) {
+        return 2;
+    }
+    std::cout << "Corpus: " << images.size() << " images, " << videos.size() << " videos" << std::endl;
+
+    std::vector<LevelResult> results;
+    try {
+        for (const auto& [workload, inputs, passes] :
+             {std::make_tuple(std::string("image"), images, options.image_passes),
+              std::make_tuple(std::string("video"), videos, options.video_passes)}) {
+            if (inputs.empty()) {
+                continue;
+            }
+            for (int clients : options.concurrency) {
+                LevelResult result;
+                if (!runLevel(workload, inputs, clients, passes, options, result)) {
+                    std::cerr << "Detector failed during the " << workload << " workload" << std::endl;
+                    return 2;
+                }
+                results.push_back(result);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+
+    std::cout << std::left << std::setw(8) << "workload" << std::right << std::setw(8) << "clients"
+              << std::setw(10) << "requests" << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+              << std::setw(10) << "p99 ms" << std::setw(10) << "req/s" << std::setw(10) << "RSS MB" << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& r : results) {
+        std::cout << std::left << std::setw(8) << r.workload << std::right << std::setw(8) << r.concurrency
+                  << std::setw(10) << r.requests << std::setw(10) << r.p50_ms << std::setw(10) << r.p90_ms
+                  << std::setw(10) << r.p99_ms << std::setw(10) << r.throughput << std::setw(10) << r.peak_rss_mb << "\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+
+    if (options.baseline.empty()) {
+        return 0;
+    }
+    std::map<std::string, LevelResult> baseline;
+    if (options.write_baseline || !std::filesystem::exists(options.baseline)) {
+        if (!writeBaseline(options.baseline, results)) {
+            std::cerr << "Failed to write baseline: " << options.baseline << std::endl;
+            return 2;
+        }
+        std::cout << "Baseline written: " << options.baseline << std::endl;
+        return 0;
+    }
+    if (!readBaseline(options.baseline, baseline)) {
+        std::cerr << "Failed to read baseline: " << options.baseline << std::endl;
+        return 2;
+    }
+
+    int regressions = countRegressions(results, baseline, options.tolerance);
+    if (regressions > 0) {
+        std::cout << regressions << " metric(s) regressed beyond " << options.tolerance * 100.0 << "%" << std::endl;
+        return 1;
+    }
+    std::cout << "No regressions against " << options.baseline << std::endl;
+    return 0;
+}
@@ -2,41 +2,201 @@
 
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <atomic>
 #include <memory>
+#include "cascade_model.h"
 #include "feature_extractor.h"
 #include "neural_network.h"
+#include "model_ensemble.h"
+#include "near_duplicate_index.h"
+#include "feature_dataset.h"
+#include "hyperparameter_sweep.h"
 #include "video_processor.h"
+#include "stream_processor.h"
+#include "thread_pool.h"
 
 class AIDetector {
 public:
-    AIDetector();
+    // All parallel work runs on one pool of this many workers (0 = the
+    // AI_DETECTOR_THREADS environment variable, else one per hardware thread)
+    explicit AIDetector(size_t threads = 0);
     ~AIDetector() = default;
 
     // Initialize the detector with a pre-trained model
     bool initialize(const std::string& model_path = "");
     
+    // Initialize with a model compiled in from a header written by
+    // export-cpp, e.g. initializeFrozen<ai_detector_model::Model>(); the
+    // parameters are copied from memory, no file is read
+    template <typename Model>
+    bool initializeFrozen() {
+        neural_network_->loadFrozen<Model>();
+        return finishInitialization();
+    }
+    
     // Detect AI-generated content in an image
     float detectImage(const std::string& image_path);
     float detectImage(const cv::Mat& image);
     
+    // Score within a deadline: expensive feature families are downgraded or
+    // replaced by the model's trained feature means (see FeatureExtractor);
+    // report lists the stages that ran degraded
+    float detectImage(const cv::Mat& image, const Deadline& deadline, QualityReport& report);
+    
+    // Score an image under every loaded model from one feature extraction.
+    // Without extra models only the primary model is listed.
+    ModelScores scoreImageModels(const std::string& image_path);
+    ModelScores scoreImageModels(const std::string& image_path, const Deadline& deadline, QualityReport& report);
+    
+    // Answer images that are near-duplicates of ones scored before (same
+    // models) from an index of perceptual hashes instead of extracting
+    // features. Only full-quality scores are added to the index.
+    void enableNearDuplicateIndex(const NearDuplicateOptions& options);
+    
+    // Warm-restart snapshot of the index; load ignores a snapshot of other models
+    bool loadNearDuplicateIndex(const std::string& path);
+    bool saveNearDuplicateIndex(const std::string& path) const;
+    
+    // Score every image under real/ (label 0) and ai_generated/ (label 1) of
+    // labeled_dir. Features are extracted in parallel and scored in batches;
+    // unreadable images are skipped. Scores and labels are in matching order.
+    bool scoreLabeledImages(const std::string& labeled_dir, Eigen::VectorXf& scores, Eigen::VectorXf& labels);
+    
+    // Scores of image files, extracted in parallel and scored in batches; -1
+    // for an image that cannot be read
+    std::vector<float> scoreImages(const std::vector<std::string>& image_paths);
+    
+    // Identifies the loaded model or ensemble; changes whenever scores could
+    uint64_t modelFingerprint() const;
+    
+    // Two-stage cascade for images: a stage-1 model on the cheap statistical
+    // and color features answers confident images before the frequency,
+    // texture and noise families run (see CascadeModel). Not used with extra
+    // models. Fails for a cascade tuned against another model.
+    bool loadCascade(const std::string& cascade_path);
+    bool saveCascade(const std::string& cascade_path) const;
+    
+    // Re-choose the cascade band on the images under real/ and ai_generated/
+    // of labeled_dir: every image is scored by both stages and the band keeps
+    // the accuracy loss against the full model within max_accuracy_loss
+    bool tuneCascade(const std::string& labeled_dir, float max_accuracy_loss, CascadeReport& report);
+    
+    // Images decided by each cascade stage so far
+    CascadeCounts cascadeCounts() const;
+    
+    // Evaluate another model next to the primary one on the same features.
+    // The primary model joins the ensemble as "primary" with weight 1; a
+    // weight of 0 reports a model's scores without affecting the verdict.
+    bool addModel(const std::string& model_path, float weight = 1.0f);
+    void setEnsembleCombine(EnsembleCombine combine);
+    
     // Detect AI-generated content in a video
     float detectVideo(const std::string& video_path);
+    VideoAnalysis analyzeVideo(const std::string& video_path);
+    VideoAnalysis analyzeVideo(const std::string& video_path, const Deadline& deadline);
+    
+    // Score a live stream of raw frames, calling on_score for every rolling score
+    bool detectStream(FrameReader& reader, const StreamOptions& options,
+                      const std::function<void(const StreamScore&)>& on_score);
+    
+    // Decode and analyze videos in this many parallel timeline segments
+    void setVideoSegments(int segments);
+    
+    // Coarse-to-fine video sampling with early exit
+    void setAdaptiveSampling(const AdaptiveSampling& adaptive);
+    
+    // Shot-aware representative frame selection for videos
+    void setShotSampling(const ShotSampling& shots);
+    
+    // Cache per-segment video results so later runs decode only new segments
+    void setSegmentCaching(const SegmentCaching& caching);
     
-    // Train the model with labeled data
-    bool train(const std::string& training_data_path, const std::string& output_model_path);
+    // Optical-flow tier used for video motion analysis
+    void setMotionQuality(MotionQuality quality);
+    
+    // Recompute video frame features only for blocks that changed
+    void setIncrementalFeatures(bool enabled);
+    
+    // Workers in the shared pool
+    size_t threadCount() const { return thread_pool_->size(); }
+    
+    // Train the model with labeled data: a feature dataset directory, or an
+    // image directory with real/ and ai_generated/ subdirectories whose
+    // features are first extracted into <output_model_path>.dataset. With
+    // cascade, a cascade first stage is then fitted on the same data, its band
+    // chosen on a held-out part, and saved to cascade->output_path.
+    bool train(const std::string& training_data_path, const std::string& output_model_path,
+               const TrainingOptions& options = TrainingOptions(), const CascadeOptions* cascade = nullptr);
+    
+    // Train every configuration on every fold of the data at once, print the
+    // ranked results and save the best configuration trained on all samples
+    bool sweep(const std::string& training_data_path, const std::string& output_model_path,
+               const SweepOptions& options);
+    
+    // Extract features of every image under real/ (label 0) and ai_generated/
+    // (label 1) into a sharded dataset, in shuffled order
+    bool buildDataset(const std::string& training_data_path, const std::string& dataset_path,
+                      FeatureEncoding encoding = FeatureEncoding::F16, size_t samples_per_shard = 16384);
+    
+    // Prune the loaded model and save the result. Images in calibration_dir
+    // (optional) reveal neurons that never activate on real inputs.
+    bool pruneModel(const std::string& output_model_path, const PruneOptions& options,
+                    const std::string& calibration_dir = "");
     
     // Save/load model
     bool saveModel(const std::string& model_path);
     bool loadModel(const std::string& model_path);
+    
+    // Write the primary model as a C++ header (see NeuralNetwork::exportCpp)
+    bool exportModelCpp(const std::string& header_path, const std::string& name_space) const;
 
 private:
+    // Common tail of initialize and initializeFrozen
+    bool finishInitialization();
+    
+    // Dataset directory for training data given as a dataset or as images;
+    // empty if the features could not be extracted
+    std::string prepareDataset(const std::string& training_data_path, const std::string& output_model_path);
+    
+    // Scores of a decoded image, from the near-duplicate index when it has a match
+    ModelScores scoreImage(const cv::Mat& image, const Deadline& deadline, QualityReport& report);
+    
+    // scoreImages; with stage_scores, every image is also scored by the
+    // cascade's first stage and none exits early
+    std::vector<float> scoreImages(const std::vector<std::string>& image_paths, std::vector<float>* stage_scores);
+    
+    // The cascade if it applies: loaded and no extra models
+    const CascadeModel* activeCascade() const { return ensemble_ ? nullptr : cascade_.get(); }
+    
+    // Fit the cascade's first stage for the primary model on a dataset
+    bool fitCascade(const FeatureDataset& dataset, const CascadeOptions& options);
+    
+    // Drop a cascade whose band was chosen for another primary model
+    void dropStaleCascade();
+    
+    // Count an image decided by stage 1, or passed on to the full model
+    void countCascade(bool early_exit);
+    
+    // Drop indexed scores once the models they came from change
+    void refreshNearDuplicateIndex();
+    
+    // Declared first so it outlives every component that submits to it
+    std::unique_ptr<ThreadPool> thread_pool_;
     std::unique_ptr<FeatureExtractor> feature_extractor_;
     std::unique_ptr<NeuralNetwork> neural_network_;
+    std::unique_ptr<ModelEnsemble> ensemble_;   // Only once extra models are added
     std::unique_ptr<VideoProcessor> video_processor_;
+    std::unique_ptr<NearDuplicateIndex> duplicate_index_;      // Only once enabled
+    std::unique_ptr<CascadeModel> cascade_;                     // Only once loaded or trained
+    std::atomic<uint64_t> cascade_exits_;
+    std::atomic<uint64_t> cascade_passes_;
     
     bool is_initialized_;
+    EnsembleCombine ensemble_combine_;
     
     // Configuration parameters
     static constexpr int INPUT_SIZE = 224;
     static constexpr float CONFIDENCE_THRESHOLD = 0.5f;
+    static constexpr uint32_t DATASET_SHUFFLE_SEED = 20240601;
+    static constexpr size_t EVALUATION_BATCH = 256;    // Images extracted and scored together
 }; 
\ No newline at end of file
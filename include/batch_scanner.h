@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ai_detector.h"
+
+// One of count disjoint parts of a scan. A file belongs to the shard given
+// by the FNV-1a hash of its path relative to the scanned directory, so every
+// machine computes the same partition without talking to the others.
+struct ShardSpec {
+    int index = 0;
+    int count = 1;
+
+    // "i/N" with 0 <= i < N
+    static bool parse(const std::string& text, ShardSpec& shard);
+
+    bool owns(const std::string& relative_path) const;
+
+    // "shard-0003-of-0016", the stem of the shard's output files
+    std::string name() const;
+};
+
+struct BatchOptions {
+    ShardSpec shard;
+    size_t chunk = 256;                 // Files scored between manifest updates
+    float possibly_threshold = 0.3f;    // Verdict thresholds written per file
+    float likely_threshold = 0.7f;
+};
+
+// Aggregate statistics of a set of results
+struct BatchSummary {
+    uint64_t images = 0;
+    uint64_t videos = 0;
+    uint64_t errors = 0;                // Files that could not be scored
+    uint64_t likely_ai = 0;
+    uint64_t possibly_ai = 0;
+    uint64_t real = 0;
+    double score_sum = 0.0;
+    uint64_t histogram[10] = {};        // Scores in tenths
+
+    void add(const std::string& type, float score, const BatchOptions& options);
+    void print(std::ostream& out) const;
+};
+
+// Scans a directory tree of images and videos, one shard per process. Each
+// shard appends "path<TAB>type<TAB>score<TAB>result" rows to
+// <output_dir>/<shard>.tsv and, after every chunk, rewrites
+// <output_dir>/<shard>.manifest atomically with the last finished path and
+// the committed size of the results. A restarted shard truncates rows past
+// that size and continues after that path.
+class BatchScanner {
+public:
+    BatchScanner(AIDetector& detector, const BatchOptions& options);
+
+    bool run(const std::string& input_dir, const std::string& output_dir);
+
+    // Concatenate every shard's results in results_dir into merged_path and
+    // recompute the statistics; warns about missing or unfinished shards and
+    // fails on shards of different inputs or models, or one shard found twice
+    static bool merge(const std::string& results_dir, const std::string& merged_path,
+                      const BatchOptions& options, BatchSummary& summary);
+
+private:
+    struct Manifest {
+        std::string input;
+        ShardSpec shard;
+        uint64_t model = 0;             // AIDetector::modelFingerprint
+        uint64_t files_done = 0;
+        uint64_t results_bytes = 0;
+        std::string last_path;          // Files sort by relative path; all up to this one are done
+        bool complete = false;
+    };
+
+    static bool readManifest(const std::string& path, Manifest& manifest);
+    static bool writeManifest(const std::string& path, const Manifest& manifest);
+
+    // Image and video files of the shard, relative to input_dir, in sorted order
+    std::vector<std::string> listShardFiles(const std::string& input_dir) const;
+
+    std::string resultRow(const std::string& path, const std::string& type, float score) const;
+
+    AIDetector& detector_;
+    BatchOptions options_;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <vector>
+
+// Confusion-matrix rates of scores above a threshold counted as positive
+struct ThresholdMetrics {
+    float threshold = 0.5f;
+    float precision = 0.0f;     // 0 when nothing is flagged
+    float recall = 0.0f;        // True positive rate
+    float false_positive_rate = 0.0f;
+    float accuracy = 0.0f;
+};
+
+// One point of the ROC curve: rates when scores >= threshold count as positive
+struct RocPoint {
+    float threshold;
+    float true_positive_rate;
+    float false_positive_rate;
+};
+
+// Quality measures for detector scores in [0,1] against 0/1 labels (1 = AI)
+class BinaryMetrics {
+public:
+    // Area under the ROC curve; tied scores count half. 0.5 if a class is missing.
+    static float auc(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels);
+
+    // Mean binary cross-entropy
+    static float logLoss(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels);
+
+    // Fraction of samples on the right side of the threshold
+    static float accuracy(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels, float threshold = 0.5f);
+
+    static ThresholdMetrics atThreshold(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels, float threshold);
+
+    // ROC curve from the highest threshold down, one point per distinct score
+    static std::vector<RocPoint> roc(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels);
+
+    // Expected calibration error: |mean score - positive rate| over equal-width
+    // score bins, weighted by the fraction of samples in each bin
+    static float calibrationError(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels, int bins = 10);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Weight matrix in block-CSR form: only the 8x4 blocks holding a nonzero weight
+// are stored, row-block by row-block. Each block is a fixed-size Eigen product,
+// so the multiply vectorizes like the dense path while skipping pruned blocks.
+// Edge blocks of matrices whose size is not a multiple of the block are partial.
+class BlockSparseMatrix {
+public:
+    static constexpr int BLOCK_ROWS = 8;
+    static constexpr int BLOCK_COLS = 4;
+
+    BlockSparseMatrix() : rows_(0), cols_(0) {}
+
+    // Keep every block of dense with at least one nonzero weight
+    static BlockSparseMatrix fromDense(const Eigen::MatrixXf& dense);
+    Eigen::MatrixXf toDense() const;
+
+    Eigen::Index rows() const { return rows_; }
+    Eigen::Index cols() const { return cols_; }
+    bool empty() const { return rows_ == 0; }
+    size_t blockCount() const { return col_index_.size(); }
+
+    // Stored blocks over all blocks of the matrix
+    float density() const;
+
+    // out = this * inputs, one sample per column; out must be rows() x inputs.cols()
+    void multiply(const Eigen::Ref<const Eigen::MatrixXf>& inputs, Eigen::Ref<Eigen::MatrixXf> out) const;
+
+    // Binary form used inside model files
+    void write(std::ostream& stream) const;
+    bool read(std::istream& stream);
+
+private:
+    using Block = Eigen::Matrix<float, BLOCK_ROWS, BLOCK_COLS>;
+
+    // Sanity bound on either dimension when reading files
+    static constexpr int64_t MAX_DIMENSION = 1 << 16;
+
+    Eigen::Index blockRows() const { return (rows_ + BLOCK_ROWS - 1) / BLOCK_ROWS; }
+    Eigen::Index blockCols() const { return (cols_ + BLOCK_COLS - 1) / BLOCK_COLS; }
+
+    Eigen::Index rows_;
+    Eigen::Index cols_;
+    std::vector<int32_t> row_start_;    // First block of each row-block, plus the end
+    std::vector<int32_t> col_index_;    // Column-block of each stored block
+    std::vector<float> values_;         // BLOCK_ROWS x BLOCK_COLS per block, column-major
+};
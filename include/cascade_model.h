@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "neural_network.h"
+
+// Stage-1 scores a cascade answers on its own: below low the image is real,
+// above high it is AI-generated; scores in between go on to the full model
+struct CascadeBand {
+    float low = 0.0f;
+    float high = 1.0f;
+
+    bool decides(float score) const { return score < low || score > high; }
+};
+
+// Early exits of a band against the full model on labeled samples
+struct CascadeReport {
+    CascadeBand band;
+    size_t samples = 0;
+    float exit_fraction = 0.0f;         // Samples decided by stage 1
+    float full_accuracy = 0.0f;         // Full model alone
+    float cascade_accuracy = 0.0f;      // Stage 1 outside the band, the full model inside
+
+    void print(std::ostream& out) const;
+};
+
+// Images decided by each stage since the cascade was enabled
+struct CascadeCounts {
+    uint64_t early_exits = 0;
+    uint64_t full_model = 0;
+
+    float exitFraction() const;
+};
+
+struct CascadeOptions {
+    std::string output_path;            // Where the fitted cascade is saved
+    std::vector<int> hidden_layers = {32};
+    float max_accuracy_loss = 0.005f;   // Accuracy the early exits may cost against the full model
+    float holdout = 0.2f;               // Fraction of samples kept back to choose the band
+    TrainingOptions training;
+};
+
+// First stage of a two-stage cascade: a small network on the statistical and
+// color features (FeatureExtractor::cascadeFeatures), the two families that
+// cost the least. A confident stage-1 score is final; only images inside the
+// band pay for the frequency, texture and noise families and the full model.
+// The band is chosen against one full model and is tied to it by fingerprint.
+class CascadeModel {
+public:
+    CascadeModel();
+
+    // Train a fresh stage-1 network on the given columns of cascade features
+    void fit(const Eigen::MatrixXf& features, const Eigen::VectorXf& labels,
+             const std::vector<Eigen::Index>& samples, const CascadeOptions& options);
+
+    // Stage-1 scores of cascade features, one sample per column; safe to call concurrently
+    Eigen::VectorXf predictBatch(const Eigen::MatrixXf& features) const;
+    float predict(const Eigen::VectorXf& features) const;
+
+    // Widest band whose early exits lose at most max_accuracy_loss accuracy
+    // against the full model's scores at threshold; low <= threshold <= high
+    static CascadeReport chooseBand(const Eigen::VectorXf& stage_scores, const Eigen::VectorXf& full_scores,
+                                    const Eigen::VectorXf& labels, float max_accuracy_loss, float threshold);
+
+    static CascadeReport measure(const CascadeBand& band, const Eigen::VectorXf& stage_scores,
+                                 const Eigen::VectorXf& full_scores, const Eigen::VectorXf& labels,
+                                 float threshold);
+
+    const CascadeBand& band() const { return band_; }
+    void setBand(const CascadeBand& band, uint64_t model_fingerprint);
+
+    // NeuralNetwork::fingerprint of the full model the band was chosen for
+    uint64_t modelFingerprint() const { return model_fingerprint_; }
+
+    // Hash of the stage-1 network and the band
+    uint64_t fingerprint() const;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+private:
+    NeuralNetwork network_;
+    CascadeBand band_;
+    uint64_t model_fingerprint_;
+
+    // Band candidates are multiples of this
+    static constexpr float BAND_STEP = 0.005f;
+
+    // File format
+    static constexpr char MAGIC[4] = {'A', 'I', 'D', 'K'};     // Checkpoints use AIDC
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t MAX_LAYERS = 16;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Everything needed to continue a training run exactly where it stopped
+struct TrainingCheckpoint {
+    std::vector<int> layer_sizes;
+    std::vector<Eigen::MatrixXf> weights;
+    std::vector<Eigen::VectorXf> biases;
+
+    // Optimizer state (plain SGD: the rate and the number of steps taken)
+    float learning_rate = 0.0f;
+    uint64_t step = 0;
+
+    // Cursor: batches already trained in the current epoch
+    int epoch = 0;
+    uint64_t batch = 0;
+    uint64_t batch_size = 0;
+
+    // RNG states; the reader's is taken at the start of the epoch so the
+    // epoch's sample order can be replayed up to the cursor
+    std::string network_rng;
+    std::string reader_rng;
+};
+
+// Writes checkpoints on a background thread. submit() has the caller fill a
+// staging buffer in place and returns; the writer swaps it with its own buffer, so
+// the two are reused and training never waits for the disk. A snapshot that
+// arrives while the previous one is still being written replaces the staged
+// one. Files are written to a temporary name and renamed into place, and
+// carry a checksum, so a crash mid-write never leaves a checkpoint that
+// looks valid but is not.
+class Checkpointer {
+public:
+    // Keep the newest `keep` checkpoints in directory
+    explicit Checkpointer(const std::string& directory, int keep = 2);
+    ~Checkpointer();
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    // Stage a snapshot for writing; fill writes it straight into the staging
+    // buffer, whose previous contents it should overwrite
+    void submit(const std::function<void(TrainingCheckpoint&)>& fill);
+
+    // Wait until everything submitted so far is on disk
+    void flush();
+
+    // Newest checkpoint in directory that reads back intact
+    static bool loadLatest(const std::string& directory, TrainingCheckpoint& checkpoint);
+
+private:
+    void writerLoop();
+    bool write(const TrainingCheckpoint& checkpoint);
+    void removeOld();
+
+    static std::string serialize(const TrainingCheckpoint& checkpoint);
+    static bool deserialize(const std::string& data, TrainingCheckpoint& checkpoint);
+    static std::vector<std::string> listCheckpoints(const std::string& directory);
+
+    std::string directory_;
+    int keep_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    TrainingCheckpoint staged_;     // Filled by submit()
+    TrainingCheckpoint writing_;    // Owned by the writer thread
+    bool has_staged_;
+    bool writing_busy_;
+    bool stopping_;
+    std::thread writer_;
+
+    static constexpr char MAGIC[4] = {'A', 'I', 'D', 'C'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t MAX_RNG_STATE = 1 << 20;  // Bytes of a serialized RNG state
+};
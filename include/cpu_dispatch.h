@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Instruction sets the hot kernels are built for, lowest first
+enum class CpuLevel : int {
+    Scalar = 0,     // Reference path, built without vectorization
+    SSE42 = 1,
+    AVX2 = 2,
+    AVX512 = 3      // F, BW, DQ and VL
+};
+
+// Per-pixel and per-neuron loops, compiled once per CpuLevel from the same
+// source (src/kernels.inl). Every variant gives bit-identical results.
+struct CpuKernels {
+    CpuLevel level;
+
+    // counts[v] += number of bytes equal to v; counts has 256 entries
+    void (*histogram_u8)(const uint8_t* data, size_t size, uint32_t* counts);
+
+    // counts[bin] += 1 per value, bin = value * (bins - 1) clamped to [0, bins - 1]
+    void (*histogram_f32)(const float* data, size_t size, int bins, uint32_t* counts);
+
+    // Adds the sum and the sum of squares of the values
+    void (*moments_f32)(const float* data, size_t size, double* sum, double* sum_sq);
+
+    // Adds sign to the 4-direction GLCM of pixels [begin, end) of one row
+    // (0, 45, 90, 135 degrees; counts holds 4 x 256 x 256 entries) and keeps
+    // sum_sq[angle], the sum of squared counts, current. above and row are
+    // the previous and current image rows.
+    void (*glcm_row)(const uint8_t* above, const uint8_t* row, size_t begin, size_t end,
+                     int sign, int32_t* counts, double* sum_sq);
+
+    // In-place activations
+    void (*relu)(float* data, size_t size);
+    void (*sigmoid)(float* data, size_t size);
+
+    // y = W x for a column-major rows x cols W
+    void (*gemv)(const float* weights, size_t rows, size_t cols, const float* x, float* y);
+};
+
+// Highest level this build and CPU support (OS-enabled register state included)
+CpuLevel detectedCpuLevel();
+
+// Level the kernels run at: the detected level, capped by the
+// AI_DETECTOR_CPU environment variable (scalar, sse4.2, avx2, avx512).
+// Decided once, on first use.
+CpuLevel activeCpuLevel();
+
+// Kernels for the active level
+const CpuKernels& cpuKernels();
+
+// Kernels built for a level; nullptr if not compiled in or not supported here
+const CpuKernels* kernelsFor(CpuLevel level);
+
+const char* cpuLevelName(CpuLevel level);
+bool parseCpuLevel(const std::string& name, CpuLevel& level);
+
+// Run every supported variant on randomized inputs and compare it with the
+// scalar reference; prints one line per level and returns false on any mismatch
+bool verifyKernels(std::ostream& out);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// Time budget of one request. A default-constructed deadline never expires.
+class Deadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Deadline() : limited_(false) {}
+
+    // Expires budget_ms from now; a budget <= 0 means no limit
+    explicit Deadline(double budget_ms)
+        : limited_(budget_ms > 0.0),
+          end_(Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                  std::chrono::duration<double, std::milli>(budget_ms))) {}
+
+    bool limited() const { return limited_; }
+
+    // Milliseconds left, negative once expired; infinite without a limit
+    double remainingMs() const {
+        if (!limited_) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return std::chrono::duration<double, std::milli>(end_ - Clock::now()).count();
+    }
+
+    // True if work estimated to take cost_ms still fits
+    bool allows(double cost_ms) const { return !limited_ || remainingMs() >= cost_ms; }
+
+private:
+    bool limited_;
+    Clock::time_point end_;
+};
+
+// Stages that can run at reduced quality to meet a deadline
+enum class DegradedStage : uint32_t {
+    FrequencyReduced = 1u << 0, // FFT at half resolution
+    FrequencySkipped = 1u << 1, // Frequency features replaced by trained defaults
+    TextureSkipped = 1u << 2,   // GLCM features replaced by trained defaults
+    NoiseSkipped = 1u << 3,     // Noise features replaced by trained defaults
+    FramesReduced = 1u << 4,    // Fewer video frames than the sampling plan
+    MotionReduced = 1u << 5,    // Part of the optical flow on the cheapest tier
+    MotionSkipped = 1u << 6     // No optical flow; motion left out of the score
+};
+
+// Which stages of one request ran degraded; none means full quality
+struct QualityReport {
+    uint32_t degraded = 0;
+
+    void add(DegradedStage stage) { degraded |= static_cast<uint32_t>(stage); }
+    bool has(DegradedStage stage) const { return (degraded & static_cast<uint32_t>(stage)) != 0; }
+    bool fullQuality() const { return degraded == 0; }
+
+    // Comma-separated degraded stages, "full" when there are none
+    std::string describe() const {
+        static const std::pair<DegradedStage, const char*> names[] = {
+            {DegradedStage::FrequencyReduced, "frequency-reduced"},
+            {DegradedStage::FrequencySkipped, "frequency-skipped"},
+            {DegradedStage::TextureSkipped, "texture-skipped"},
+            {DegradedStage::NoiseSkipped, "noise-skipped"},
+            {DegradedStage::FramesReduced, "frames-reduced"},
+            {DegradedStage::MotionReduced, "motion-reduced"},
+            {DegradedStage::MotionSkipped, "motion-skipped"},
+        };
+        std::string text;
+        for (const auto& [stage, name] : names) {
+            if (has(stage)) {
+                text += (text.empty() ? "" : ",") + std::string(name);
+            }
+        }
+        return text.empty() ? "full" : text;
+    }
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <future>
+#include <random>
+#include <string>
+#include <vector>
+
+// How feature values are stored in a dataset shard
+enum class FeatureEncoding : uint32_t {
+    F32 = 0,    // Plain floats
+    F16 = 1,    // IEEE half floats
+    I8 = 2      // 8-bit codes with a per-feature scale and offset per shard
+};
+
+// Features and labels of one shard, one sample per column
+struct FeatureShard {
+    Eigen::MatrixXf features;
+    Eigen::VectorXf labels;
+};
+
+// A training set stored as a directory of shard files plus a text manifest.
+// Each shard holds a fixed number of samples with their features laid out
+// sample after sample, so a shard maps straight onto an Eigen matrix with
+// one column per sample. Shards are memory-mapped when read; only the shards
+// being consumed are resident.
+class FeatureDataset {
+public:
+    struct ShardInfo {
+        std::string path;
+        size_t samples;
+        size_t first_sample;    // Index of the shard's first sample in the dataset
+    };
+
+    // Read the manifest of a dataset directory; false if it is not a dataset
+    bool open(const std::string& directory);
+    static bool isDataset(const std::string& directory);
+
+    size_t featureCount() const { return features_; }
+    size_t sampleCount() const { return samples_; }
+    size_t shardCount() const { return shards_.size(); }
+    FeatureEncoding encoding() const { return encoding_; }
+    const ShardInfo& shard(size_t index) const { return shards_[index]; }
+
+    // Map and decode one shard; false on a missing or malformed file
+    bool loadShard(size_t index, FeatureShard& shard) const;
+
+    // Decode every shard into one in-memory matrix, in dataset order
+    bool loadAll(FeatureShard& all) const;
+
+    static bool parseEncoding(const std::string& name, FeatureEncoding& encoding);
+    static const char* encodingName(FeatureEncoding encoding);
+
+private:
+    friend class FeatureDatasetWriter;
+
+    std::string directory_;
+    size_t features_ = 0;
+    size_t samples_ = 0;
+    FeatureEncoding encoding_ = FeatureEncoding::F32;
+    std::vector<ShardInfo> shards_;
+
+    // Shard file layout: a HEADER_SIZE header, float labels, for I8 a float
+    // scale and offset per feature, then the feature codes from a
+    // DATA_ALIGNMENT boundary
+    static constexpr char SHARD_MAGIC[4] = {'A', 'I', 'D', 'F'};
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 64;
+    static constexpr size_t DATA_ALIGNMENT = 64;
+    static constexpr const char* MANIFEST_NAME = "manifest.txt";
+};
+
+// Appends samples to a new dataset directory, cutting a shard every
+// samples_per_shard samples. finish() writes the last shard and the manifest.
+class FeatureDatasetWriter {
+public:
+    FeatureDatasetWriter(const std::string& directory, size_t features,
+                         FeatureEncoding encoding = FeatureEncoding::F16,
+                         size_t samples_per_shard = 16384);
+
+    bool add(const Eigen::VectorXf& features, float label);
+    bool finish();
+
+    size_t sampleCount() const { return dataset_.samples_ + pending_; }
+
+private:
+    bool writeShard();
+
+    FeatureDataset dataset_;
+    size_t samples_per_shard_;
+    Eigen::MatrixXf buffer_;
+    Eigen::VectorXf labels_;
+    size_t pending_;
+    bool failed_;
+};
+
+// Streams a dataset in minibatches through a bounded shuffle buffer. Shards
+// are visited in a new random order every epoch; while one shard feeds the
+// buffer, the next is mapped and decoded on a background thread. Samples
+// leave the buffer from random slots and are replaced by the next incoming
+// sample, so memory stays at one buffer plus two decoded shards however
+// large the dataset is.
+class DatasetReader {
+public:
+    DatasetReader(const FeatureDataset& dataset, size_t shuffle_buffer, uint32_t seed);
+    ~DatasetReader();
+
+    DatasetReader(const DatasetReader&) = delete;
+    DatasetReader& operator=(const DatasetReader&) = delete;
+
+    // Rewind to the start of a new pass over the data
+    void startEpoch();
+
+    // Fill up to batch_size samples, one per column; 0 once the epoch is done
+    // or a shard failed to load
+    size_t nextBatch(size_t batch_size, Eigen::MatrixXf& inputs, Eigen::VectorXf& targets);
+
+    // A shard failed to load; the epoch is cut short and must not be trusted
+    bool failed() const { return failed_; }
+
+    // Shuffle RNG state. Restoring the state saved before startEpoch()
+    // replays that epoch's sample order exactly.
+    std::string rngState() const;
+    bool setRngState(const std::string& state);
+
+private:
+    void prefetch();
+    bool advanceShard();
+    bool nextSample(Eigen::Ref<Eigen::VectorXf> features, float& label);
+
+    const FeatureDataset& dataset_;
+    std::mt19937 rng_;
+    std::vector<size_t> order_;
+    size_t next_shard_;
+
+    FeatureShard current_;
+    size_t cursor_;
+    FeatureShard prefetched_;       // Written by the pending load
+    std::future<bool> pending_;
+    bool failed_;
+
+    Eigen::MatrixXf buffer_;
+    Eigen::VectorXf buffer_labels_;
+    size_t filled_;
+};
@@ -1,17 +1,86 @@
 #pragma once
 
 #include <opencv2/opencv.hpp>
+#include <atomic>
 #include <vector>
+#include "deadline.h"
+#include "thread_pool.h"
 #include <Eigen/Dense>
 
+// Per-stream state for FeatureExtractor::extractFeaturesIncremental. Holds
+// block-decomposable accumulators of the previous frame so that only the
+// blocks that changed need to be recomputed.
+class IncrementalFeatureState {
+public:
+    IncrementalFeatureState() = default;
+
+    // Forget the previous frame; the next call recomputes everything
+    void reset() { initialized_ = false; }
+
+    // Blocks recomputed for the most recent frame (0 = whole frame reused)
+    int lastChangedBlocks() const { return last_changed_blocks_; }
+
+private:
+    friend class FeatureExtractor;
+
+    // Sums, sums of squares and histograms of one block. Slots: gray, B, G, R,
+    // noise residual (histogrammed) and Laplacian (moments only)
+    struct BlockAccumulator {
+        static constexpr int SLOTS = 6;
+        static constexpr int HISTOGRAM_SLOTS = 5;
+        double sum[SLOTS] = {};
+        double sum_sq[SLOTS] = {};
+        std::vector<int> histogram;
+    };
+
+    bool initialized_ = false;
+    int last_changed_blocks_ = 0;
+    cv::Mat gray_;                          // Gray image the blocks were built from
+    cv::Mat texture_gray_;                  // 8-bit texture image behind the GLCM counts
+    std::vector<BlockAccumulator> blocks_;
+    std::vector<int> glcm_counts_;          // 4 directions x 256 x 256
+    double glcm_sum_sq_[4] = {};
+    std::vector<bool> changed_since_fft_;
+    Eigen::VectorXf frequency_;
+    Eigen::VectorXf features_;
+};
+
 class FeatureExtractor {
 public:
     FeatureExtractor();
     ~FeatureExtractor() = default;
 
+    // Run the feature families of one image as parallel tasks (not owned; nullptr = serial)
+    void setThreadPool(ThreadPool* pool) { thread_pool_ = pool; }
+
     // Extract features from an image
     Eigen::VectorXf extractFeatures(const cv::Mat& image);
     
+    // Extract features within a deadline. Families are planned in order of
+    // value per cost (statistical, color, noise, frequency, texture) against
+    // running estimates of what each costs: the first two always run, the FFT
+    // falls back to half resolution, and a family that does not fit is
+    // skipped and takes its values from defaults (the model's trained feature
+    // means; zeros if the sizes differ). Degraded stages are added to report.
+    // With cascade_features the statistical and color families are taken
+    // from it and only the other three are planned.
+    Eigen::VectorXf extractFeatures(const cv::Mat& image, const Deadline& deadline,
+                                    const Eigen::VectorXf& defaults, QualityReport& report,
+                                    const Eigen::VectorXf* cascade_features = nullptr);
+    
+    // Statistical and color features of an image (CASCADE_FEATURES values),
+    // the two families a cascade's first stage scores
+    Eigen::VectorXf extractCascadeFeatures(const cv::Mat& image);
+    
+    // Full feature vector of an image whose cascade features are known: only
+    // the noise, frequency and texture families are extracted
+    Eigen::VectorXf completeFeatures(const cv::Mat& image, const Eigen::VectorXf& cascade_features);
+    
+    // Cascade features of full feature vectors, one sample per column
+    static Eigen::MatrixXf cascadeFeatures(const Eigen::MatrixXf& features);
+    
+    static constexpr int CASCADE_FEATURES = 128;
+    
     // Extract statistical features
     Eigen::VectorXf extractStatisticalFeatures(const cv::Mat& image);
     
@@ -26,16 +95,60 @@ public:
     
     // Extract color distribution features
     Eigen::VectorXf extractColorFeatures(const cv::Mat& image);
+    
+    // Extract features for the next frame of a sequence, recomputing only the
+    // blocks that changed since the previous frame. Histograms, moments, GLCM
+    // counts and noise residual statistics are updated per block; the FFT
+    // features are refreshed once enough of the frame has changed.
+    Eigen::VectorXf extractFeaturesIncremental(const cv::Mat& image, IncrementalFeatureState& state);
 
 private:
+    // Feature families, in the order a deadline plans them
+    enum Family { STATISTICAL, COLOR, NOISE, FREQUENCY, FREQUENCY_REDUCED, TEXTURE, FAMILY_COUNT };
+    
+    // All five families of a preprocessed image, as one feature vector; with
+    // cascade_features the statistical and color families are taken from it
+    Eigen::VectorXf extractFamilies(const cv::Mat& processed, const Eigen::VectorXf* cascade_features);
+    
+    // FFT features computed on an fft_size x fft_size resampling (at most FFT_SIZE)
+    Eigen::VectorXf frequencyFeatures(const cv::Mat& image, int fft_size);
+    
     // Helper methods
     cv::Mat preprocessImage(const cv::Mat& image);
     std::vector<float> calculateHistogram(const cv::Mat& image);
     std::vector<float> calculateGLCM(const cv::Mat& image);
     std::vector<float> calculateNoiseMetrics(const cv::Mat& image);
     
+    // GLCM helpers shared by the full and incremental paths
+    static int histogramBin(float value);
+    static void accumulateGLCM(const cv::Mat& image, const cv::Rect& region, int sign,
+                               std::vector<int>& counts, double* sum_sq);
+    static std::vector<float> glcmStatistics(const double* sum_sq, const cv::Size& size);
+    
+    // Incremental path helpers
+    void accumulateBlock(const cv::Mat& processed, const cv::Mat& gray, const cv::Rect& block,
+                         IncrementalFeatureState::BlockAccumulator& acc);
+    cv::Mat textureImage(const cv::Mat& gray);
+    Eigen::VectorXf assembleIncrementalFeatures(IncrementalFeatureState& state);
+    
+    ThreadPool* thread_pool_;
+    
+    // Running mean cost of each family in ms, refined by every deadline-bounded extraction
+    std::atomic<float> family_cost_ms_[FAMILY_COUNT];
+    
     // Configuration
+    static constexpr int INPUT_SIZE = 224;
     static constexpr int FEATURE_SIZE = 512;
+    static constexpr int STATISTICAL_FEATURES = 64;         // First in the feature vector
+    static constexpr int COLOR_FEATURES = 64;               // Last in the feature vector
     static constexpr int HISTOGRAM_BINS = 64;
     static constexpr int GLCM_DISTANCE = 1;
+    static constexpr int GLCM_LEVELS = 256;
+    static constexpr int TEXTURE_SIZE = 128;
+    static constexpr int BLOCK_SIZE = 32;                   // Incremental block size at INPUT_SIZE
+    static constexpr int TEXTURE_BLOCK_SIZE = 16;           // Incremental block size at TEXTURE_SIZE
+    static constexpr float CHANGE_THRESHOLD = 2.0f / 255.0f; // Mean abs gray change that dirties a block
+    static constexpr float FFT_REFRESH_FRACTION = 0.25f;    // Changed area that forces an FFT refresh
+    static constexpr int FFT_SIZE = 256;
+    static constexpr float COST_SMOOTHING = 0.2f;           // Weight of the newest cost sample
 }; 
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Write content to path through a temporary file and a rename, so readers
+// never see a partially written file
+bool writeAtomically(const std::string& path, const std::string& content);
+
+// Binary snapshots (checkpoints, cascades, near-duplicate indexes, segment
+// caches) store their payload followed by its FNV-1a checksum and are
+// published atomically, so a crash mid-write never leaves a file that looks
+// valid but is not. what names the file in error messages.
+bool writeSnapshot(const std::string& path, const std::string& payload, const std::string& what);
+
+enum class SnapshotStatus {
+    Ok,
+    Missing,    // The file cannot be opened
+    Damaged     // Too short for a checksum, or the checksum does not match
+};
+
+// Payload of a snapshot, checksum removed; set only when Ok
+SnapshotStatus readSnapshot(const std::string& path, std::string& payload);
+
+// FNV-1a of size bytes, continuing from hash
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ull;
+uint64_t fnv1a(const char* data, size_t size, uint64_t hash = FNV_OFFSET);
+
+// Values in snapshot payloads, in native byte order
+template <typename T>
+void put(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool get(std::istream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// Length-prefixed strings; getString rejects one longer than max_size
+void putString(std::ostream& out, const std::string& value);
+bool getString(std::istream& in, std::string& value, uint64_t max_size);
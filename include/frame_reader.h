@@ -0,0 +1,51 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Raw frame formats accepted on a stream
+enum class StreamFormat {
+    Y4M,   // YUV4MPEG2 with 4:2:0 or mono planes, dimensions from the header
+    BGR,   // Packed 8-bit BGR, dimensions given by the caller
+    I420   // Planar 4:2:0 YUV, dimensions given by the caller
+};
+
+// Reads uncompressed frames from stdin ("-"), a FIFO or a regular file
+class FrameReader {
+public:
+    FrameReader();
+    ~FrameReader();
+
+    FrameReader(const FrameReader&) = delete;
+    FrameReader& operator=(const FrameReader&) = delete;
+
+    // Open the source; width/height are required for BGR and I420
+    bool open(const std::string& source, StreamFormat format, int width = 0, int height = 0);
+    void close();
+
+    // Read the next frame as BGR; false at end of stream or on a short read
+    bool readFrame(cv::Mat& frame);
+
+    // Parse "y4m", "bgr" or "i420"
+    static bool parseFormat(const std::string& name, StreamFormat& format);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t bytesRead() const { return bytes_read_; }
+
+private:
+    bool readY4MHeader();
+    bool skipY4MFrameHeader();
+    bool readExact(void* buffer, size_t size);
+
+    std::FILE* file_;
+    bool owns_file_;
+    StreamFormat format_;
+    int width_;
+    int height_;
+    bool monochrome_;
+    size_t bytes_read_;
+    std::vector<uchar> buffer_;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "neural_network.h"
+#include "thread_pool.h"
+
+// One network shape and learning rate to try
+struct SweepConfig {
+    std::vector<int> hidden_layers;
+    float learning_rate = 0.01f;
+
+    // "256-128-64 lr 0.01"
+    std::string describe() const;
+};
+
+struct SweepOptions {
+    std::vector<SweepConfig> configs;
+    int folds = 5;                  // k-fold cross-validation; 1 = a single holdout split
+    float holdout = 0.2f;           // Validation fraction when folds is 1, in (0, 1)
+    TrainingOptions training;       // Epochs, batch size and base seed; the rate comes from each config
+};
+
+// Validation metrics of one configuration, averaged over its folds
+struct SweepResult {
+    SweepConfig config;
+    std::vector<float> fold_auc;
+    float auc = 0.0f;
+    float auc_stddev = 0.0f;
+    float loss = 0.0f;
+    float accuracy = 0.0f;
+};
+
+// Trains every configuration on every fold of one in-memory feature set, all
+// runs at once on a thread pool. The features are shared read-only; each run
+// has its own network and an RNG stream seeded from the base seed and the run
+// index, so results do not depend on scheduling.
+class HyperparameterSweep {
+public:
+    HyperparameterSweep(const Eigen::MatrixXf& features, const Eigen::VectorXf& labels, ThreadPool& pool);
+
+    // Results ranked by mean validation AUC, best first
+    std::vector<SweepResult> run(const SweepOptions& options);
+
+    // Train a configuration on every sample
+    std::unique_ptr<NeuralNetwork> trainFinal(const SweepConfig& config, const TrainingOptions& training) const;
+
+    // Parse "256,128,64;128,64" into one hidden-layer list per configuration
+    static bool parseLayers(const std::string& text, std::vector<std::vector<int>>& layers);
+
+    static void printTable(const std::vector<SweepResult>& results, std::ostream& out);
+
+private:
+    struct RunMetrics {
+        float auc;
+        float loss;
+        float accuracy;
+    };
+
+    std::unique_ptr<NeuralNetwork> createNetwork(const SweepConfig& config, uint32_t seed) const;
+    RunMetrics trainRun(const SweepConfig& config, const std::vector<Eigen::Index>& train,
+                        const std::vector<Eigen::Index>& validation, const TrainingOptions& training,
+                        uint32_t seed) const;
+
+    const Eigen::MatrixXf& features_;
+    const Eigen::VectorXf& labels_;
+    ThreadPool& pool_;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <memory>
+#include <string>
+#include <vector>
+#include "neural_network.h"
+#include "thread_pool.h"
+
+// How member scores are reduced to the ensemble score
+enum class EnsembleCombine {
+    Mean,   // Weighted mean
+    Max,    // Most confident "AI" verdict of the weighted members
+    Min     // Least confident "AI" verdict of the weighted members
+};
+
+// Scores of one input under every member model
+struct ModelScores {
+    std::vector<std::string> names;
+    std::vector<float> scores;
+    float combined = -1.0f;
+    int duplicate_distance = -1;    // pHash distance of the cached near-duplicate used; -1 = scored
+    bool early_exit = false;        // Decided by the cascade's first stage
+};
+
+// Several detector models evaluated on one shared feature vector. The first
+// layers of all members are stacked into one matrix, so a batch costs one wide
+// GEMM plus each member's remaining layers. Members with weight 0 are scored
+// but do not affect the combined score (shadow models).
+class ModelEnsemble {
+public:
+    ModelEnsemble();
+
+    void setThreadPool(ThreadPool* pool) { thread_pool_ = pool; }
+
+    // Load a model file as a new member; false if it cannot be read or its
+    // input size differs from the existing members
+    bool addModel(const std::string& path, float weight = 1.0f);
+
+    // Add a network owned by the caller, which must outlive the ensemble
+    bool addNetwork(const NeuralNetwork* network, const std::string& name, float weight = 1.0f);
+
+    // Re-stack the first layers after a member network was reloaded
+    void refresh();
+
+    size_t size() const { return members_.size(); }
+    const std::string& name(size_t member) const { return members_[member].name; }
+    int inputSize() const { return members_.empty() ? 0 : members_[0].network->inputSize(); }
+
+    void setCombine(EnsembleCombine combine) { combine_ = combine; }
+    static bool parseCombine(const std::string& name, EnsembleCombine& combine);
+
+    // Score every column of inputs under every member; one row per member
+    Eigen::MatrixXf predictBatch(const Eigen::MatrixXf& inputs) const;
+
+    // Combined score per column of a predictBatch result
+    Eigen::VectorXf combine(const Eigen::MatrixXf& scores) const;
+
+    // Per-member and combined scores for a single feature vector
+    ModelScores score(const Eigen::VectorXf& features) const;
+
+    // Hash of every member's parameters and weight and of the combine mode
+    uint64_t fingerprint() const;
+
+private:
+    struct Member {
+        std::unique_ptr<NeuralNetwork> owned;
+        const NeuralNetwork* network;
+        std::string name;
+        float weight;
+        Eigen::Index first_row;     // Offset of its first layer in the stacked matrix
+    };
+
+    Eigen::MatrixXf predictColumns(const Eigen::Ref<const Eigen::MatrixXf>& inputs) const;
+
+    std::vector<Member> members_;
+    Eigen::MatrixXf stacked_weights_;
+    Eigen::VectorXf stacked_biases_;
+    EnsembleCombine combine_;
+    ThreadPool* thread_pool_;
+
+    // Configuration
+    static constexpr Eigen::Index MIN_COLUMNS_PER_TASK = 8;
+};
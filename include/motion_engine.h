@@ -0,0 +1,56 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+// Optical-flow quality tiers, from most to least expensive
+enum class MotionQuality {
+    Full,      // Full-resolution dense Farneback
+    Pyramid,   // Dense Farneback on a downscaled pyramid level
+    Sparse,    // Pyramidal Lucas-Kanade on a fixed grid of points
+    Block      // Block-matching SAD flow
+};
+
+// Magnitude statistics of one flow field
+struct FlowStats {
+    double mean = 0.0;
+    double stddev = 0.0;
+};
+
+class MotionEngine {
+public:
+    explicit MotionEngine(MotionQuality quality = MotionQuality::Full);
+    ~MotionEngine() = default;
+
+    void setQuality(MotionQuality quality) { quality_ = quality; }
+    MotionQuality getQuality() const { return quality_; }
+
+    // Parse "full", "pyramid", "sparse" or "block"
+    static bool parseQuality(const std::string& name, MotionQuality& quality);
+
+    // Convert a frame once into the grayscale input the current tier works on
+    cv::Mat prepareFrame(const cv::Mat& frame) const;
+
+    // Flow magnitude statistics of two prepared frames
+    FlowStats calculateFlowStats(const cv::Mat& prev, const cv::Mat& next) const;
+
+    // Motion uniformity of two prepared frames, 1 = perfectly uniform motion
+    float calculateUniformity(const cv::Mat& prev, const cv::Mat& next) const;
+    static float uniformity(const FlowStats& stats);
+
+private:
+    FlowStats denseFlowStats(const cv::Mat& prev, const cv::Mat& next) const;
+    FlowStats sparseFlowStats(const cv::Mat& prev, const cv::Mat& next) const;
+    FlowStats blockFlowStats(const cv::Mat& prev, const cv::Mat& next) const;
+
+    // Single pass over a dense flow field, no magnitude/angle temporaries
+    static FlowStats flowMagnitudeStats(const cv::Mat& flow);
+
+    MotionQuality quality_;
+
+    // Configuration
+    static constexpr int PYRAMID_LEVELS = 2;    // Pyramid tier runs at 1/4 resolution
+    static constexpr int GRID_STEP = 16;        // Sparse tier point spacing
+    static constexpr int BLOCK_SIZE = 16;       // Block tier block size
+    static constexpr int SEARCH_RANGE = 6;      // Block tier search radius
+};
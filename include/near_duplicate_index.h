@@ -0,0 +1,83 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "model_ensemble.h"
+
+// 64-bit perceptual hashes of an image. Both survive re-encoding and
+// resizing; a light crop moves a few bits.
+struct PerceptualHash {
+    uint64_t phash = 0;     // Signs of the 8x8 lowest DCT frequencies of a 32x32 thumbnail vs. their median
+    uint64_t dhash = 0;     // Signs of the horizontal gradients of a 9x8 thumbnail
+
+    static PerceptualHash compute(const cv::Mat& image);
+    static int distance(uint64_t a, uint64_t b);
+};
+
+// Settings for NearDuplicateIndex
+struct NearDuplicateOptions {
+    int max_distance = 6;           // Bits each hash may differ by and still match (0-32)
+    size_t capacity = 100000;       // Entries kept; the least recently used are evicted
+};
+
+// Scores of previously scored images, looked up by perceptual-hash
+// similarity. The pHash is split into max_distance + 1 disjoint bit ranges
+// with one hash table per range (multi-index hashing): two hashes within
+// max_distance bits agree exactly on at least one range, so a lookup probes
+// one bucket per table and checks only those candidates. A candidate matches
+// when both its pHash and its dHash are within max_distance. Thread-safe.
+class NearDuplicateIndex {
+public:
+    explicit NearDuplicateIndex(const NearDuplicateOptions& options = NearDuplicateOptions());
+
+    // Scores of the closest stored image that matches; distance is its pHash
+    // distance. false if nothing matches.
+    bool lookup(const PerceptualHash& hash, ModelScores& scores, int* distance = nullptr);
+    void insert(const PerceptualHash& hash, const ModelScores& scores);
+
+    // Scores depend on the model; entries stored under another fingerprint are dropped
+    void setModel(uint64_t fingerprint);
+
+    size_t size() const;
+    void clear();
+
+    // Snapshot for warm restarts, written atomically with a checksum. A
+    // snapshot of another model, or a damaged one, loads nothing.
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+private:
+    struct Entry {
+        PerceptualHash hash;
+        std::vector<float> scores;      // One per name in names_
+        float combined;
+        std::list<uint64_t>::iterator recent;
+    };
+
+    uint64_t rangeKey(uint64_t phash, size_t range) const;
+    void insertLocked(const PerceptualHash& hash, const std::vector<float>& scores, float combined);
+    void evictLocked(uint64_t id);
+    void clearLocked();
+
+    NearDuplicateOptions options_;
+    std::vector<int> range_start_;      // First bit of each range; the last entry is 64
+    uint64_t fingerprint_;
+    std::vector<std::string> names_;    // Model names shared by all entries
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, Entry> entries_;
+    std::vector<std::unordered_map<uint64_t, std::vector<uint64_t>>> tables_;
+    std::list<uint64_t> recent_;        // Entry ids, most recently used first
+    uint64_t next_id_;
+
+    // Snapshot file format
+    static constexpr char MAGIC[4] = {'A', 'I', 'D', 'N'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t MAX_NAME = 4096;          // Bytes of a model name
+    static constexpr int MAX_DISTANCE_LIMIT = 32;
+};
@@ -1,9 +1,35 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <random>
+#include "block_sparse.h"
+#include "thread_pool.h"
+
+// Settings for NeuralNetwork::prune
+struct PruneOptions {
+    float sparsity = 0.7f;              // Fraction of weight blocks zeroed in each hidden layer
+    bool remove_dead_neurons = true;    // Drop neurons that never activate
+};
+
+// Settings for minibatch training
+struct TrainingOptions {
+    int epochs = 20;
+    size_t batch_size = 64;
+    float learning_rate = 0.01f;
+    size_t shuffle_buffer = 1 << 16;    // Samples held for shuffling when streaming
+    uint32_t seed = 0;                  // 0 = random
+    
+    // Streaming training only
+    std::string checkpoint_dir;         // Empty = no checkpoints
+    size_t checkpoint_every = 500;      // Batches between checkpoints; one is also taken per epoch
+    bool resume = false;                // Continue from the newest valid checkpoint in checkpoint_dir
+};
+
+class DatasetReader;
+struct TrainingCheckpoint;
 
 class NeuralNetwork {
 public:
@@ -22,43 +48,141 @@ public:
                float learning_rate = 0.01f,
                int epochs = 100);
     
+    // Stream minibatches from a dataset reader for options.epochs passes,
+    // checkpointing in the background and resuming as the options ask;
+    // false if a dataset shard fails to load
+    bool train(DatasetReader& reader, const TrainingOptions& options);
+    
+    // Minibatch SGD over the given columns of an in-memory feature matrix,
+    // which is only read; prints nothing
+    void train(const Eigen::MatrixXf& inputs, const Eigen::VectorXf& targets,
+               const std::vector<Eigen::Index>& samples, const TrainingOptions& options);
+    
+    // One SGD step on a minibatch (one sample per column); returns the mean loss
+    float trainBatch(const Eigen::Ref<const Eigen::MatrixXf>& inputs,
+                     const Eigen::Ref<const Eigen::VectorXf>& targets, float learning_rate);
+    
     // Prediction
     float predict(const Eigen::VectorXf& input);
     
+    // Batched prediction, one sample per column; does not touch the
+    // training buffers so it is safe to call concurrently
+    Eigen::VectorXf predictBatch(const Eigen::MatrixXf& inputs) const;
+    
+    // Split large batches into column blocks run on the pool (not owned; nullptr = serial)
+    void setThreadPool(ThreadPool* pool) { thread_pool_ = pool; }
+    
+    // Number of input features, 0 if not initialized
+    int inputSize() const { return weights_.empty() ? 0 : static_cast<int>(weights_[0].cols()); }
+    
+    // Layer parameters, for callers that evaluate a layer themselves
+    size_t layerCount() const { return weights_.size(); }
+    const Eigen::MatrixXf& layerWeights(size_t layer) const { return weights_[layer]; }
+    const Eigen::VectorXf& layerBiases(size_t layer) const { return biases_[layer]; }
+    
+    // Finish a batched forward pass from the pre-activation output of a
+    // layer (one column per sample); returns the output score per column
+    Eigen::VectorXf predictFromLayer(size_t layer, const Eigen::Ref<const Eigen::MatrixXf>& preactivation) const;
+    
+    // Zero the weakest 8x4 weight blocks of every hidden layer, then remove
+    // neurons that stay at zero after ReLU for every calibration sample (one
+    // per column; may be empty) or for any input. Layers that end up sparse
+    // enough are evaluated with block-sparse kernels and saved in that form.
+    void prune(const PruneOptions& options, const Eigen::MatrixXf& calibration);
+    
+    // True if the layer runs on the block-sparse kernel
+    bool isSparseLayer(size_t layer) const { return !sparse_weights_[layer].empty(); }
+    
+    // Mean of every input feature over the training samples, stored with the
+    // model; stands in for features skipped to meet a deadline. Empty for
+    // models saved before version 2 or never trained.
+    const Eigen::VectorXf& featureDefaults() const { return feature_defaults_; }
+    void setFeatureDefaults(const Eigen::VectorXf& defaults) { feature_defaults_ = defaults; }
+    
+    // Hash of the layer shapes and parameters; equal for networks that score alike
+    uint64_t fingerprint() const;
+    
     // Save/load model
     bool saveModel(const std::string& filename);
     bool loadModel(const std::string& filename);
     
+    // Write the model as a self-contained C++ header: alignas(64) constexpr
+    // weight arrays in the column-major layout of the gemv kernel, and a
+    // predict() with one call per layer whose dimensions are template
+    // arguments, so every loop bound is a compile-time constant
+    bool exportCpp(const std::string& filename, const std::string& name_space) const;
+    
+    // Copy parameters from memory: layer_sizes.size() - 1 column-major weight
+    // arrays and bias arrays; feature_defaults may be nullptr
+    void loadParameters(const std::vector<int>& layer_sizes, const float* const* weights,
+                        const float* const* biases, const float* feature_defaults);
+    
+    // Load a model compiled in from a header written by exportCpp, e.g.
+    // loadFrozen<ai_detector_model::Model>()
+    template <typename Model>
+    void loadFrozen() {
+        loadParameters(std::vector<int>(Model::LAYER_SIZES, Model::LAYER_SIZES + Model::LAYERS + 1),
+                       Model::WEIGHTS, Model::BIASES, Model::FEATURE_DEFAULTS);
+    }
+    
     // Set/get parameters
+    void setSeed(uint32_t seed) { rng_.seed(seed); }
     void setLearningRate(float lr) { learning_rate_ = lr; }
     float getLearningRate() const { return learning_rate_; }
 
 private:
+    // Forward pass over a block of columns using arena scratch buffers
+    Eigen::VectorXf predictColumns(const Eigen::Ref<const Eigen::MatrixXf>& inputs) const;
+    
+    // out = layer weights * inputs, on the sparse kernel for pruned layers
+    void multiplyLayer(size_t layer, const Eigen::Ref<const Eigen::MatrixXf>& inputs,
+                       Eigen::Ref<Eigen::MatrixXf> out) const;
+    
+    // Rebuild the block-sparse form of every layer sparse enough to benefit
+    void compressLayers();
+    void pruneBlocks(float sparsity);
+    void removeDeadNeurons(const Eigen::MatrixXf& calibration);
+    
+    // Copy parameters, learning rate and RNG state into/out of a checkpoint
+    void captureCheckpoint(TrainingCheckpoint& checkpoint) const;
+    void restoreCheckpoint(const TrainingCheckpoint& checkpoint);
+    
+    ThreadPool* thread_pool_;
+    static constexpr int MIN_COLUMNS_PER_TASK = 8;
+    
     // Network layers
     std::vector<Eigen::MatrixXf> weights_;
     std::vector<Eigen::VectorXf> biases_;
+    std::vector<BlockSparseMatrix> sparse_weights_;     // Empty for dense layers
+    Eigen::VectorXf feature_defaults_;
     std::vector<Eigen::VectorXf> activations_;
     std::vector<Eigen::VectorXf> z_values_;
     
+    // Minibatch training buffers, one column per sample
+    std::vector<Eigen::MatrixXf> batch_activations_;
+    std::vector<Eigen::MatrixXf> batch_z_;
+    Eigen::MatrixXf delta_;
+    
     // Training parameters
     float learning_rate_;
     std::mt19937 rng_;
     
     // Activation functions
     Eigen::VectorXf sigmoid(const Eigen::VectorXf& x);
-    Eigen::VectorXf sigmoidDerivative(const Eigen::VectorXf& x);
     Eigen::VectorXf relu(const Eigen::VectorXf& x);
-    Eigen::VectorXf reluDerivative(const Eigen::VectorXf& x);
-    
-    // Loss function
-    float crossEntropyLoss(const Eigen::VectorXf& predicted, const Eigen::VectorXf& target);
-    Eigen::VectorXf crossEntropyDerivative(const Eigen::VectorXf& predicted, const Eigen::VectorXf& target);
-    
-    // Backpropagation
-    void backward(const Eigen::VectorXf& input, const Eigen::VectorXf& target);
-    void updateWeights(float learning_rate);
     
     // Helper methods
-    Eigen::VectorXf softmax(const Eigen::VectorXf& x);
     void initializeWeights();
+    
+    // Model file format. Versioned files start with the magic tag; files
+    // without it are the original unversioned layout and load as dense.
+    // Version 2 appends the feature defaults after the biases.
+    static constexpr char MODEL_MAGIC[4] = {'A', 'I', 'D', 'M'};
+    static constexpr uint32_t MODEL_VERSION = 2;
+    enum LayerEncoding : uint8_t { DENSE_LAYER = 0, BLOCK_SPARSE_LAYER = 1 };
+    
+    // Use the sparse kernel only when at most this fraction of blocks is kept
+    static constexpr float SPARSE_DENSITY_LIMIT = 0.4f;
+    static constexpr size_t MAX_LAYERS = 64;    // Sanity bounds when reading files
+    static constexpr int MAX_LAYER_SIZE = 1 << 16;
 }; 
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Instrumented pipeline stages
+enum class ProfileStage {
+    Decode,              // Reading and decoding one frame or image
+    FrameExtraction,     // Sampling frames from a video
+    Preprocess,          // FeatureExtractor::preprocessImage
+    StatisticalFeatures,
+    FrequencyFeatures,
+    TextureFeatures,
+    NoiseFeatures,
+    ColorFeatures,
+    IncrementalFeatures, // Block-delta feature update
+    Forward,             // Neural network forward pass (single or batched)
+    OpticalFlow,
+    TemporalAnalysis,    // Frame-difference consistency
+    MotionAnalysis,      // Motion uniformity over frame pairs
+    PerceptualHash,      // Near-duplicate hashes of one image
+    Count
+};
+
+// Monotonic counters
+enum class ProfileCounter {
+    BytesDecoded,
+    FramesSampled,
+    DuplicateHits,       // Images answered from the near-duplicate index
+    DuplicateMisses,
+    SegmentsReused,      // Video segments read back from the segment cache
+    SegmentsDecoded,     // Video segments decoded for the segment cache
+    CascadeExits,        // Images decided by the cascade's first stage
+    CascadePassed,       // Images the first stage passed on to the full model
+    Count
+};
+
+// Process-wide profiler. Each thread records into its own log-linear latency
+// histograms (16 sub-buckets per power of two, ~6% resolution) without locks;
+// reports merge all threads. While disabled, every hook is a single flag check.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Start recording; with tracing, every timed scope is also kept as a trace event
+    static void enable(bool tracing = false);
+
+    static void record(ProfileStage stage, Clock::time_point start, Clock::time_point end);
+    static void count(ProfileCounter counter, uint64_t amount) {
+        if (enabled()) {
+            addCount(counter, amount);
+        }
+    }
+
+    static const char* stageName(ProfileStage stage);
+
+    // Per-stage summary table (count, total, mean, p50, p90, p99, max)
+    static void printSummary(std::ostream& out);
+
+    // Prometheus text exposition format, written atomically (temp file + rename)
+    static bool writePrometheus(const std::string& path);
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto); needs enable(true)
+    static bool writeChromeTrace(const std::string& path);
+
+private:
+    static void addCount(ProfileCounter counter, uint64_t amount);
+
+    static std::atomic<bool> enabled_;
+};
+
+// Times the enclosing scope into a stage histogram
+class ScopedTimer {
+public:
+    explicit ScopedTimer(ProfileStage stage) : stage_(stage), active_(Profiler::enabled()) {
+        if (active_) {
+            start_ = Profiler::Clock::now();
+        }
+    }
+    ~ScopedTimer() {
+        if (active_) {
+            Profiler::record(stage_, start_, Profiler::Clock::now());
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    ProfileStage stage_;
+    bool active_;
+    Profiler::Clock::time_point start_;
+};
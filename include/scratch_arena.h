@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Per-thread bump allocator for request-scoped scratch memory. Allocating is a
+// pointer bump and freeing is a no-op; memory comes back when the enclosing
+// ScratchScope ends, which rewinds the arena in O(1). Chunks up to
+// MAX_RETAINED bytes are kept for the next request, so a warmed-up thread
+// neither calls malloc nor faults pages for its temporaries, while one
+// unusually large request does not pin its peak for the life of the thread.
+class ScratchArena {
+public:
+    // The calling thread's arena
+    static ScratchArena& local();
+
+    // Make cv::Mat allocations inside a ScratchScope come from the arena.
+    // Process-wide and idempotent; outside a scope the standard allocator is used.
+    static void installMatAllocator();
+
+    void* allocate(size_t bytes, size_t alignment = ALIGNMENT);
+    float* floats(size_t count) { return static_cast<float*>(allocate(count * sizeof(float))); }
+
+    // True while a ScratchScope is open on this thread
+    bool active() const { return depth_ > 0; }
+
+    // Bytes reserved across all chunks
+    size_t capacity() const;
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+private:
+    friend class ScratchScope;
+    friend class ScratchPause;
+
+    struct Mark {
+        size_t chunk;
+        size_t offset;
+    };
+
+    struct Chunk {
+        std::unique_ptr<unsigned char[]> memory;
+        size_t size;
+    };
+
+    ScratchArena() = default;
+
+    Mark mark() const { return {current_, offset_}; }
+    void rewind(const Mark& mark) {
+        current_ = mark.chunk;
+        offset_ = mark.offset;
+    }
+
+    // Free unused chunks beyond MAX_RETAINED bytes
+    void trim();
+
+    std::vector<Chunk> chunks_;
+    size_t current_ = 0;
+    size_t offset_ = 0;
+    int depth_ = 0;
+
+    // Configuration
+    static constexpr size_t ALIGNMENT = 64;             // Matches OpenCV's fastMalloc
+    static constexpr size_t MIN_CHUNK_SIZE = 4 << 20;
+    static constexpr size_t MAX_RETAINED = 32 << 20;    // Kept once the outermost scope ends
+};
+
+// Routes the calling thread's cv::Mat allocations to its arena and rewinds the
+// arena on exit. Scopes nest. Nothing allocated inside may outlive the scope,
+// so only open one where every cv::Mat created inside is a local temporary.
+class ScratchScope {
+public:
+    ScratchScope() : arena_(ScratchArena::local()), mark_(arena_.mark()) { ++arena_.depth_; }
+    ~ScratchScope() {
+        arena_.rewind(mark_);
+        if (--arena_.depth_ == 0) {
+            arena_.trim();
+        }
+    }
+
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+
+private:
+    ScratchArena& arena_;
+    ScratchArena::Mark mark_;
+};
+
+// Sends the calling thread's cv::Mat allocations back to the standard
+// allocator until it ends, even inside a ScratchScope. For work that runs on
+// this thread but belongs to someone else, such as a pool task taken while
+// waiting, whose results must outlive the caller's scope. Scopes opened
+// inside still use the arena above the caller's allocations.
+class ScratchPause {
+public:
+    ScratchPause() : arena_(ScratchArena::local()), depth_(arena_.depth_) { arena_.depth_ = 0; }
+    ~ScratchPause() { arena_.depth_ = depth_; }
+
+    ScratchPause(const ScratchPause&) = delete;
+    ScratchPause& operator=(const ScratchPause&) = delete;
+
+private:
+    ScratchArena& arena_;
+    int depth_;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// What identifies a video file's content without reading all of it
+struct FileIdentity {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t head_hash = 0;     // FNV-1a of the first IDENTITY_BYTES
+    uint64_t tail_hash = 0;     // FNV-1a of the last IDENTITY_BYTES
+
+    static bool read(const std::string& path, FileIdentity& identity);
+
+    bool operator==(const FileIdentity& other) const;
+
+    // True if the file at path is this file with data appended: it is
+    // larger and its bytes still hash to head_hash and tail_hash at the
+    // same offsets
+    bool isPrefixOf(const std::string& path) const;
+
+    static constexpr uint64_t IDENTITY_BYTES = 64 * 1024;
+};
+
+// Model-independent results of one timeline segment of a video
+struct CachedSegment {
+    bool complete = false;                      // All of the segment's frames were in the video
+    Eigen::MatrixXf features;                   // One column per owned frame
+    std::vector<std::vector<float>> samples;    // Per analyzer; empty for model-dependent ones
+};
+
+// Per-video files of cached segments in a directory, named after the
+// video's head hash so renamed or copied files still hit. Files are written
+// atomically with a checksum; a damaged one loads nothing.
+class SegmentCache {
+public:
+    explicit SegmentCache(const std::string& directory);
+
+    // Segments stored for the video at path under the same settings: all of
+    // them if the file is unchanged, the complete ones if it only grew by
+    // appending, none otherwise. total_frames is the stored frame count when
+    // the file is unchanged, else 0.
+    std::map<int, CachedSegment> load(const std::string& path, const FileIdentity& identity,
+                                      uint64_t settings, int& total_frames) const;
+
+    bool save(const FileIdentity& identity, uint64_t settings, int total_frames,
+              const std::map<int, CachedSegment>& segments) const;
+
+private:
+    std::string entryPath(const FileIdentity& identity) const;
+
+    std::string directory_;
+
+    // File format
+    static constexpr char MAGIC[4] = {'A', 'I', 'D', 'V'};
+    static constexpr uint32_t VERSION = 1;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <deque>
+#include <functional>
+#include <Eigen/Dense>
+#include "feature_extractor.h"
+#include "neural_network.h"
+#include "motion_engine.h"
+#include "video_analyzers.h"
+#include "frame_reader.h"
+
+// Streaming configuration
+struct StreamOptions {
+    int window = 30;               // Frames kept in the sliding window
+    int emit_every = 15;           // Emit a rolling score every K analyzed frames
+    int latency_budget_ms = 250;   // Frames older than this are dropped unanalyzed
+    int analysis_size = 224;       // Frames are reduced to this square size on arrival
+    bool incremental_features = false; // Recompute features only for changed blocks
+};
+
+// One rolling score
+struct StreamScore {
+    long long frame_number = 0;    // Source frame the score was emitted at
+    float score = 0.0f;            // Rolling AI detection confidence over the window
+    int window_frames = 0;         // Frames currently in the window
+    long long analyzed = 0;        // Frames analyzed so far
+    long long dropped = 0;         // Frames dropped so far to keep up with the source
+    double latency_ms = 0.0;       // Arrival of the newest frame to emission
+};
+
+// Scores a live stream over a sliding window; a reader thread keeps only the
+// newest frame so a slow analyzer drops frames instead of building a backlog
+class StreamProcessor {
+public:
+    StreamProcessor(FeatureExtractor& feature_extractor,
+                    const NeuralNetwork& neural_network,
+                    MotionQuality motion_quality);
+    ~StreamProcessor() = default;
+
+    // Run until the reader reaches the end of the stream
+    bool run(FrameReader& reader, const StreamOptions& options,
+             const std::function<void(const StreamScore&)>& on_score);
+
+private:
+    // Per-frame accumulators kept for the window
+    struct WindowEntry {
+        long long frame_number = 0;
+        float score = 0.0f;
+        bool scored = false;
+        bool has_pair = false;     // Difference/motion against the previous entry
+        float difference = 0.0f;
+        float motion = 0.0f;
+    };
+
+    float rollingScore() const;
+
+    FeatureExtractor& feature_extractor_;
+    const NeuralNetwork& neural_network_;
+    FrameScoreAnalyzer frame_scorer_;  // Network scores, or the heuristic when its input size differs
+    MotionEngine motion_engine_;
+    std::deque<WindowEntry> window_;
+};
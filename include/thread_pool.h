@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <chrono>
+
+// Work-stealing pool. Each worker owns a deque: tasks submitted from a worker
+// go to the back of its own deque and are run LIFO, idle workers steal from
+// the front of the others. Tasks submitted from outside go through a shared
+// injection queue. wait() runs queued tasks while the awaited one is pending,
+// so tasks can spawn and wait for subtasks without deadlocking the pool.
+class ThreadPool {
+public:
+    // Create a pool with the given number of workers (0 = one per hardware thread)
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task and return a future for its result
+    template <typename F>
+    auto submit(F&& task) -> std::future<decltype(task())>;
+
+    // Get a task's result, helping with queued work until it is ready.
+    // Use instead of future.get() for anything submitted to this pool.
+    template <typename T>
+    T wait(std::future<T>& future);
+
+    size_t size() const { return workers_.size(); }
+
+    // Worker count from the AI_DETECTOR_THREADS environment variable, else 0
+    static size_t threadsFromEnvironment();
+
+private:
+    using Task = std::function<void()>;
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void enqueue(Task task);
+    bool runOne();
+    bool popTask(int self, Task& task);
+    void workerLoop(int index);
+
+    // Index of the calling thread among this pool's workers, -1 otherwise
+    int currentWorker() const;
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    WorkQueue injection_;
+    std::vector<std::thread> workers_;
+
+    // Sleeping workers wake when queued_ becomes positive or the pool stops.
+    // queued_ may dip below zero briefly when a task is popped before the
+    // submitter has counted it.
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<long> queued_;
+    bool stopping_;
+};
+
+template <typename F>
+auto ThreadPool::submit(F&& task) -> std::future<decltype(task())> {
+    using Result = decltype(task());
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    std::future<Result> result = packaged->get_future();
+    enqueue([packaged]() { (*packaged)(); });
+    return result;
+}
+
+template <typename T>
+T ThreadPool::wait(std::future<T>& future) {
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if (!runOne()) {
+            // Nothing left to help with; the task is running on another thread
+            future.wait_for(std::chrono::microseconds(200));
+        }
+    }
+    return future.get();
+}
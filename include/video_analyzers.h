@@ -0,0 +1,117 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <Eigen/Dense>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "motion_engine.h"
+#include "model_ensemble.h"
+#include "neural_network.h"
+
+// Per-video intermediate products, computed lazily and at most once, shared by
+// every analyzer. Frames are kept in timeline order by source frame index.
+// Context frames only take part in the pair with the next frame; their own
+// per-frame samples belong to another segment.
+class FrameProducts {
+public:
+    // Extracts one feature column per frame
+    using FeatureSource = std::function<Eigen::MatrixXf(const std::vector<cv::Mat>&)>;
+
+    // The products keep their own copy of the engine, so one analysis can
+    // change its flow tier without affecting others
+    FrameProducts(const MotionEngine& motion_engine, FeatureSource feature_source);
+
+    // Flow tier for this video; only before any motion input is prepared
+    void setMotionQuality(MotionQuality quality) { motion_engine_.setQuality(quality); }
+    MotionQuality motionQuality() const { return motion_engine_.getQuality(); }
+
+    // Insert a decoded frame at its source position
+    void addFrame(int index, const cv::Mat& frame, bool owned = true);
+
+    size_t frameCount() const { return entries_.size(); }
+    bool isOwned(size_t position) const { return entries_[position].owned; }
+    int sourceIndex(size_t position) const { return entries_[position].index; }
+    const cv::Mat& frame(size_t position) const { return entries_[position].frame; }
+
+    // Per-frame products
+    const cv::Mat& gray(size_t position);
+    const cv::Mat& motionInput(size_t position);
+
+    // Feature columns of all owned frames; missing ones are extracted in one call
+    Eigen::MatrixXf ownedFeatures();
+
+    // Pair products between the frame at position - 1 and the one at position
+    float difference(size_t position);
+    const FlowStats& flowStats(size_t position);
+
+private:
+    struct Entry {
+        int index = 0;
+        bool owned = true;
+        cv::Mat frame;
+        cv::Mat gray;
+        cv::Mat motion_input;
+        Eigen::VectorXf features;
+    };
+
+    std::pair<int, int> pairKey(size_t position) const;
+
+    MotionEngine motion_engine_;
+    FeatureSource feature_source_;
+    std::vector<Entry> entries_;
+
+    // Pair caches survive insertions between frames (adaptive sampling)
+    std::map<std::pair<int, int>, float> differences_;
+    std::map<std::pair<int, int>, FlowStats> flow_stats_;
+};
+
+// A video analysis stage. collect() turns the owned frames (or the pairs that
+// end at them) into samples; samples of all segments are concatenated in
+// timeline order and reduced to one score in [0, 1].
+class VideoAnalyzer {
+public:
+    virtual ~VideoAnalyzer() = default;
+
+    virtual std::string name() const = 0;
+    virtual std::vector<float> collect(FrameProducts& products) = 0;
+    virtual float reduce(const std::vector<float>& samples) const = 0;
+};
+
+// Per-frame scores from the trained network, or a feature-spread heuristic
+class FrameScoreAnalyzer : public VideoAnalyzer {
+public:
+    FrameScoreAnalyzer() : neural_network_(nullptr), ensemble_(nullptr) {}
+
+    void setNeuralNetwork(const NeuralNetwork* network) { neural_network_ = network; }
+    // Takes precedence over the single network; frames get the combined score
+    void setEnsemble(const ModelEnsemble* ensemble) { ensemble_ = ensemble; }
+
+    std::string name() const override { return "frames"; }
+    std::vector<float> collect(FrameProducts& products) override;
+    float reduce(const std::vector<float>& samples) const override;
+
+    // Scores of feature columns, as collect() gives for the frames they came from
+    std::vector<float> score(const Eigen::MatrixXf& features) const;
+
+private:
+    const NeuralNetwork* neural_network_;
+    const ModelEnsemble* ensemble_;
+};
+
+// Consistency of frame-to-frame differences
+class TemporalConsistencyAnalyzer : public VideoAnalyzer {
+public:
+    std::string name() const override { return "temporal"; }
+    std::vector<float> collect(FrameProducts& products) override;
+    float reduce(const std::vector<float>& samples) const override;
+};
+
+// Uniformity of optical-flow magnitudes
+class MotionPatternAnalyzer : public VideoAnalyzer {
+public:
+    std::string name() const override { return "motion"; }
+    std::vector<float> collect(FrameProducts& products) override;
+    float reduce(const std::vector<float>& samples) const override;
+};
@@ -3,7 +3,59 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include <string>
+#include <memory>
+#include <map>
+#include <atomic>
 #include "feature_extractor.h"
+#include "neural_network.h"
+#include "thread_pool.h"
+#include "motion_engine.h"
+#include "video_analyzers.h"
+#include "deadline.h"
+#include "segment_cache.h"
+
+// Outcome of analyzing one video
+struct VideoAnalysis {
+    float score = -1.0f;        // AI detection confidence, -1 on failure
+    int frames_used = 0;        // Sampled frames that were decoded and scored
+    bool stopped_early = false; // Adaptive mode stopped before the frame cap
+    int shots = 0;              // Shots found by shot-aware sampling
+    int segments = 0;           // Timeline segments of a cached analysis
+    int segments_reused = 0;    // Of those, read back from the segment cache
+    std::map<std::string, float> analyzer_scores; // Score of each registered analyzer
+    QualityReport quality;      // Stages cut back to meet a deadline
+};
+
+// Sequential early-exit sampling settings
+struct AdaptiveSampling {
+    bool enabled = false;
+    int min_frames = 6;              // Never decide on fewer frames than this
+    int max_frames = 30;             // Frame cap across the timeline
+    float low_threshold = 0.3f;      // Stop once confidently below this score
+    float high_threshold = 0.7f;     // Stop once confidently above this score
+    float confidence_z = 1.96f;      // Confidence interval width (95%)
+};
+
+// Shot-aware representative frame selection settings
+struct ShotSampling {
+    bool enabled = false;
+    int frames_per_shot = 2;         // Upper bound on representatives per shot
+    int max_frames = 30;             // Total representative frame budget
+    int thumbnail_size = 32;         // Pre-pass thumbnails are this square size
+    int histogram_bins = 32;         // Gray-level bins for the cut detector
+    float cut_threshold = 0.35f;     // Bhattacharyya distance that marks a cut
+    float samples_per_second = 5.0f; // Pre-pass thumbnail rate
+};
+
+// Per-segment result cache settings. Cached analysis samples every
+// frame_stride-th source frame and groups segment_samples samples into a
+// segment, so segment boundaries do not move when footage is appended.
+struct SegmentCaching {
+    bool enabled = false;
+    std::string directory;
+    int frame_stride = 15;           // Source frames between samples
+    int segment_samples = 8;         // Samples per cached segment
+};
 
 class VideoProcessor {
 public:
@@ -13,28 +65,153 @@ public:
     // Process video and return AI detection confidence
     float processVideo(const std::string& video_path);
     
+    // Process video and report how the score was obtained
+    VideoAnalysis analyzeVideo(const std::string& video_path);
+    
+    // Analyze within a deadline. Frames are added coarse-to-fine in rounds
+    // while the next round is expected to finish in time. Optical flow, the
+    // costliest stage per sample, is collected last in each round: it drops
+    // to the block tier when the plan cannot afford the configured one, and
+    // stops when its next pairs no longer fit. A stage without samples is
+    // left out of the score. analysis.quality lists what was cut back.
+    VideoAnalysis analyzeVideo(const std::string& video_path, const Deadline& deadline);
+
     // Extract frames from video
     std::vector<cv::Mat> extractFrames(const std::string& video_path, int max_frames = 30);
-    
+
     // Process individual frames
     std::vector<float> processFrames(const std::vector<cv::Mat>& frames);
-    
+
     // Temporal analysis
     float analyzeTemporalConsistency(const std::vector<cv::Mat>& frames);
-    
+
     // Motion analysis
     float analyzeMotionPatterns(const std::vector<cv::Mat>& frames);
 
+    // Run all parallel work on a shared pool (not owned); without one a private
+    // pool is created on first use
+    void setThreadPool(ThreadPool* pool);
+    
+    // Split the timeline into this many segments decoded in parallel (1 = sequential)
+    void setParallelSegments(int segments);
+    int getParallelSegments() const { return parallel_segments_; }
+    
+    // Score frames with a trained network (not owned); nullptr uses the heuristic
+    void setNeuralNetwork(const NeuralNetwork* network) { frame_analyzer_->setNeuralNetwork(network); }
+    
+    // Score frames with several models at once (not owned); overrides the network
+    void setEnsemble(const ModelEnsemble* ensemble) { frame_analyzer_->setEnsemble(ensemble); }
+    
+    // Add an analysis stage; the final score is the weighted mean of all stages.
+    // The built-in frame (0.6), temporal (0.2) and motion (0.2) stages are
+    // registered by the constructor. Stages share the per-video products, so
+    // adding one adds no decode or conversion passes.
+    void registerAnalyzer(std::unique_ptr<VideoAnalyzer> analyzer, float weight);
+    
+    // Sample coarse-to-fine and stop once the verdict is clear
+    void setAdaptiveSampling(const AdaptiveSampling& adaptive) { adaptive_ = adaptive; }
+    
+    // Find shot boundaries in a cheap pre-pass and analyze representative frames
+    // only; not used while adaptive sampling is enabled
+    void setShotSampling(const ShotSampling& shots) { shots_ = shots; }
+    
+    // Keep frame features and model-independent analyzer samples per timeline
+    // segment, keyed by file identity. Later runs reuse the segments of an
+    // unchanged file, or of a file that only grew by appending, and decode
+    // only the rest; re-scoring with another model decodes nothing.
+    void setSegmentCaching(const SegmentCaching& caching) { caching_ = caching; }
+    
+    // Reuse the previous frame's feature accumulators for unchanged image blocks
+    void setIncrementalFeatures(bool enabled) { incremental_features_ = enabled; }
+    
+    // Select the optical-flow tier used by motion analysis
+    void setMotionQuality(MotionQuality quality) { motion_engine_.setQuality(quality); }
+    MotionQuality getMotionQuality() const { return motion_engine_.getQuality(); }
+
+    // Score reduction shared by every analysis path, including streaming
+    static float temporalScore(const std::vector<float>& differences);
+    static float motionScore(const std::vector<float>& motion_scores);
+    static float combineScores(const std::vector<float>& frame_scores,
+                               const std::vector<float>& differences,
+                               const std::vector<float>& motion_scores);
+
 private:
+    // One sample list per registered analyzer, in registration order
+    using AnalyzerSamples = std::vector<std::vector<float>>;
+
+    struct RegisteredAnalyzer {
+        std::unique_ptr<VideoAnalyzer> analyzer;
+        float weight;
+    };
+
     std::unique_ptr<FeatureExtractor> feature_extractor_;
+    std::unique_ptr<ThreadPool> own_thread_pool_;
+    ThreadPool* thread_pool_;
+    MotionEngine motion_engine_;
+    std::vector<RegisteredAnalyzer> analyzers_;
+    FrameScoreAnalyzer* frame_analyzer_;
+    VideoAnalyzer* motion_analyzer_;
+    int parallel_segments_;
+    bool incremental_features_;
+    AdaptiveSampling adaptive_;
+    ShotSampling shots_;
+    SegmentCaching caching_;
     
-    // Helper methods
-    cv::Mat calculateOpticalFlow(const cv::Mat& frame1, const cv::Mat& frame2);
-    std::vector<float> calculateFrameDifferences(const std::vector<cv::Mat>& frames);
-    float calculateTemporalVariance(const std::vector<cv::Mat>& frames);
+    ThreadPool& threadPool();
+
+    // Analysis paths
+    VideoAnalysis analyzeVideoSequential(const std::string& video_path);
+    VideoAnalysis analyzeVideoParallel(const std::string& video_path);
+    VideoAnalysis analyzeVideoAdaptive(const std::string& video_path);
+    VideoAnalysis analyzeVideoShots(const std::string& video_path);
+    VideoAnalysis analyzeVideoDeadline(const std::string& video_path, const Deadline& deadline);
+    VideoAnalysis analyzeVideoCached(const std::string& video_path);
+    VideoAnalysis analyzeFrameSet(const std::vector<cv::Mat>& frames);
+    // Segment workers; false if the segment could not decode every listed frame
+    bool processSegment(const std::string& video_path, const std::vector<int>& frame_indices,
+                        size_t first_owned, AnalyzerSamples& samples);
+    bool processCachedSegment(const std::string& video_path, const std::vector<int>& frame_indices,
+                              size_t first_owned, CachedSegment& segment);
     
+    // Decode the listed source frames into products; the first first_owned
+    // are context frames. False if the video ends or fails before the last one.
+    bool decodeFrames(const std::string& video_path, const std::vector<int>& frame_indices,
+                      size_t first_owned, FrameProducts& products);
+    
+    // Hash of everything besides the file that cached segments depend on
+    uint64_t cacheSettings() const;
+    float estimateAdaptiveScore(FrameProducts& products, float& margin);
+    std::vector<size_t> coarseToFineOrder(size_t count) const;
+    
+    // Shot-aware sampling helpers; a shot is a [first, last) source frame range
+    std::vector<std::pair<int, int>> detectShots(cv::VideoCapture& cap) const;
+    std::vector<int> selectShotFrames(const std::vector<std::pair<int, int>>& shots) const;
+
+    // Products and analyzers
+    FrameProducts makeProducts(bool parallel);
+    FrameProducts makeProducts(const std::vector<cv::Mat>& frames, bool parallel);
+    AnalyzerSamples collectSamples(FrameProducts& products);
+    float reduceSamples(const AnalyzerSamples& samples, VideoAnalysis& analysis) const;
+    float totalWeight() const;
+    
+    // Position of a registered analyzer in analyzers_, or analyzers_.size()
+    size_t analyzerSlot(const VideoAnalyzer* analyzer) const;
+
+    // Feature columns for a list of frames, spread over the pool when parallel
+    Eigen::MatrixXf extractFrameFeatures(const std::vector<cv::Mat>& frames, bool parallel);
+    
+    // Helper methods
+    std::vector<int> sampleFrameIndices(int total_frames, int max_frames) const;
+    void normalizeFrameSize(cv::Mat& frame) const;
+
     // Configuration
     static constexpr int MAX_FRAMES = 30;
     static constexpr float FRAME_SAMPLE_RATE = 1.0f; // Extract every frame
     static constexpr int MIN_FRAME_SIZE = 224;
-}; 
\ No newline at end of file
+    static constexpr size_t CACHE_SAVE_BATCH = 4;   // Decoded segments between segment cache saves
+    
+    // Running mean optical-flow cost per frame pair in ms, one per MotionQuality
+    // tier; shared by concurrent deadline analyses
+    std::atomic<double> motion_cost_ms_[4] = {{20.0}, {6.0}, {3.0}, {2.0}};
+    static constexpr double COST_SMOOTHING = 0.2;
+};
\ No newline at end of file
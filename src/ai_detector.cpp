@@ -1,11 +1,70 @@
 #include "../include/ai_detector.h"
+#include "../include/profiler.h"
+#include "../include/scratch_arena.h"
 #include <iostream>
 #include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+#include <random>
 
-AIDetector::AIDetector() : is_initialized_(false) {
+namespace {
+
+// Image files directly inside a directory, in name order
+std::vector<std::string> listImages(const std::string& directory) {
+    static const std::vector<std::string> extensions = {".jpg", ".jpeg", ".png", ".bmp", ".webp", ".tif", ".tiff"};
+    std::vector<std::string> images;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (entry.is_regular_file() &&
+            std::find(extensions.begin(), extensions.end(), extension) != extensions.end()) {
+            images.push_back(entry.path().string());
+        }
+    }
+    std::sort(images.begin(), images.end());
+    return images;
+}
+
+// Images under real/ (label 0) and ai_generated/ (label 1) of a labeled directory
+std::vector<std::pair<std::string, float>> listLabeledImages(const std::string& directory) {
+    std::vector<std::pair<std::string, float>> samples;
+    for (const auto& [name, label] : {std::make_pair("real", 0.0f), std::make_pair("ai_generated", 1.0f)}) {
+        std::filesystem::path subdirectory = std::filesystem::path(directory) / name;
+        if (std::filesystem::is_directory(subdirectory)) {
+            for (const auto& path : listImages(subdirectory.string())) {
+                samples.emplace_back(path, label);
+            }
+        }
+    }
+    return samples;
+}
+
+} // namespace
+
+AIDetector::AIDetector(size_t threads)
+    : cascade_exits_(0), cascade_passes_(0), is_initialized_(false), ensemble_combine_(EnsembleCombine::Mean) {
+    ScratchArena::installMatAllocator();
+    
+    if (threads == 0) {
+        threads = ThreadPool::threadsFromEnvironment();
+    }
+    thread_pool_ = std::make_unique<ThreadPool>(threads);
+    
+    // The pool is the only source of parallelism; OpenCV's and Eigen's own
+    // threading would oversubscribe the cores it already keeps busy
+    cv::setNumThreads(1);
+    Eigen::setNbThreads(1);
+    
     feature_extractor_ = std::make_unique<FeatureExtractor>();
+    feature_extractor_->setThreadPool(thread_pool_.get());
     neural_network_ = std::make_unique<NeuralNetwork>();
+    neural_network_->setThreadPool(thread_pool_.get());
     video_processor_ = std::make_unique<VideoProcessor>();
+    video_processor_->setThreadPool(thread_pool_.get());
+    video_processor_->setNeuralNetwork(neural_network_.get());
 }
 
 bool AIDetector::initialize(const std::string& model_path) {
@@ -19,13 +78,19 @@ bool AIDetector::initialize(const std::string& model_path) {
         std::vector<int> layer_sizes = {512, 256, 128, 64, 1};
         neural_network_->initialize(layer_sizes);
     }
-    
+    return finishInitialization();
+}
+
+bool AIDetector::finishInitialization() {
     is_initialized_ = true;
+    refreshNearDuplicateIndex();
     std::cout << "AI Detector initialized successfully" << std::endl;
     return true;
 }
 
 float AIDetector::detectImage(const std::string& image_path) {
+    // Every image buffer of the request is scratch; the score is all that survives
+    ScratchScope scope;
     cv::Mat image = cv::imread(image_path);
     if (image.empty()) {
         std::cerr << "Failed to load image: " << image_path << std::endl;
@@ -35,62 +100,676 @@ float AIDetector::detectImage(const std::string& image_path) {
 }
 
 float AIDetector::detectImage(const cv::Mat& image) {
+    QualityReport report;
+    return detectImage(image, Deadline(), report);
+}
+
+float AIDetector::detectImage(const cv::Mat& image, const Deadline& deadline, QualityReport& report) {
     if (!is_initialized_) {
         std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
         return -1.0f;
     }
+    return scoreImage(image, deadline, report).combined;
+}
+
+ModelScores AIDetector::scoreImageModels(const std::string& image_path) {
+    QualityReport report;
+    return scoreImageModels(image_path, Deadline(), report);
+}
+
+ModelScores AIDetector::scoreImageModels(const std::string& image_path, const Deadline& deadline,
+                                         QualityReport& report) {
+    ModelScores result;
+    if (!is_initialized_) {
+        std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
+        return result;
+    }
+    
+    ScratchScope scope;
+    cv::Mat image = cv::imread(image_path);
+    if (image.empty()) {
+        std::cerr << "Failed to load image: " << image_path << std::endl;
+        return result;
+    }
+    
+    return scoreImage(image, deadline, report);
+}
+
+ModelScores AIDetector::scoreImage(const cv::Mat& image, const Deadline& deadline, QualityReport& report) {
+    // A hash costs two thumbnails, far less than feature extraction
+    PerceptualHash hash;
+    ModelScores result;
+    if (duplicate_index_) {
+        hash = PerceptualHash::compute(image);
+        int distance = 0;
+        if (duplicate_index_->lookup(hash, result, &distance)) {
+            result.duplicate_distance = distance;
+            return result;
+        }
+    }
+    
+    const CascadeModel* cascade = activeCascade();
+    Eigen::VectorXf cascade_features;
+    if (cascade) {
+        // Stage 1 needs only the cheapest families; a confident score is final
+        cascade_features = feature_extractor_->extractCascadeFeatures(image);
+        float stage_score = cascade->predict(cascade_features);
+        result.early_exit = cascade->band().decides(stage_score);
+        countCascade(result.early_exit);
+        if (result.early_exit) {
+            result.names.push_back("primary");
+            result.scores.push_back(stage_score);
+            result.combined = stage_score;
+        }
+    }
+    
+    if (!result.early_exit) {
+        // Stage 1's families are reused; under a deadline the rest are planned
+        Eigen::VectorXf features = feature_extractor_->extractFeatures(
+            image, deadline, neural_network_->featureDefaults(), report, cascade ? &cascade_features : nullptr);
+        if (ensemble_) {
+            result = ensemble_->score(features);
+        } else {
+            result.names.push_back("primary");
+            result.scores.push_back(neural_network_->predict(features));
+            result.combined = result.scores[0];
+        }
+    }
+    
+    // Degraded scores would be served as full-quality ones to every later copy
+    if (duplicate_index_ && report.fullQuality()) {
+        duplicate_index_->insert(hash, result);
+    }
+    return result;
+}
+
+void AIDetector::enableNearDuplicateIndex(const NearDuplicateOptions& options) {
+    duplicate_index_ = std::make_unique<NearDuplicateIndex>(options);
+    refreshNearDuplicateIndex();
+}
+
+bool AIDetector::loadNearDuplicateIndex(const std::string& path) {
+    return duplicate_index_ && duplicate_index_->load(path);
+}
+
+bool AIDetector::saveNearDuplicateIndex(const std::string& path) const {
+    return duplicate_index_ && duplicate_index_->save(path);
+}
+
+void AIDetector::refreshNearDuplicateIndex() {
+    if (duplicate_index_ && is_initialized_) {
+        duplicate_index_->setModel(modelFingerprint());
+    }
+}
+
+uint64_t AIDetector::modelFingerprint() const {
+    if (ensemble_) {
+        return ensemble_->fingerprint();
+    }
+    // Early exits answer with stage-1 scores
+    uint64_t fingerprint = neural_network_->fingerprint();
+    return cascade_ ? (fingerprint ^ cascade_->fingerprint()) * 1099511628211ull : fingerprint;
+}
+
+bool AIDetector::loadCascade(const std::string& cascade_path) {
+    if (!is_initialized_) {
+        std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
+        return false;
+    }
+    
+    auto cascade = std::make_unique<CascadeModel>();
+    if (!cascade->load(cascade_path)) {
+        return false;
+    }
+    if (cascade->modelFingerprint() != neural_network_->fingerprint()) {
+        std::cerr << "Cascade was tuned for another model: " << cascade_path << std::endl;
+        return false;
+    }
+    if (ensemble_) {
+        std::cerr << "The cascade is not used with extra models" << std::endl;
+    }
+    cascade_ = std::move(cascade);
+    refreshNearDuplicateIndex();
+    return true;
+}
+
+bool AIDetector::saveCascade(const std::string& cascade_path) const {
+    if (!cascade_) {
+        std::cerr << "No cascade to save" << std::endl;
+        return false;
+    }
+    return cascade_->save(cascade_path);
+}
+
+bool AIDetector::tuneCascade(const std::string& labeled_dir, float max_accuracy_loss, CascadeReport& report) {
+    if (!is_initialized_ || !activeCascade()) {
+        std::cerr << "No cascade to tune" << std::endl;
+        return false;
+    }
+    
+    std::vector<std::pair<std::string, float>> samples = listLabeledImages(labeled_dir);
+    if (samples.empty()) {
+        std::cerr << "No images found under real/ or ai_generated/ in " << labeled_dir << std::endl;
+        return false;
+    }
+    std::vector<std::string> paths;
+    for (const auto& sample : samples) {
+        paths.push_back(sample.first);
+    }
+    std::vector<float> image_stage_scores;
+    std::vector<float> image_scores = scoreImages(paths, &image_stage_scores);
+    
+    std::vector<float> stage_scores, full_scores, labels;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (image_scores[i] < 0.0f) {
+            std::cerr << "Skipping unreadable image: " << samples[i].first << std::endl;
+            continue;
+        }
+        stage_scores.push_back(image_stage_scores[i]);
+        full_scores.push_back(image_scores[i]);
+        labels.push_back(samples[i].second);
+    }
     
-    // Extract features
-    Eigen::VectorXf features = feature_extractor_->extractFeatures(image);
+    report = CascadeModel::chooseBand(Eigen::Map<Eigen::VectorXf>(stage_scores.data(), stage_scores.size()),
+                                      Eigen::Map<Eigen::VectorXf>(full_scores.data(), full_scores.size()),
+                                      Eigen::Map<Eigen::VectorXf>(labels.data(), labels.size()),
+                                      max_accuracy_loss, CONFIDENCE_THRESHOLD);
+    cascade_->setBand(report.band, neural_network_->fingerprint());
+    refreshNearDuplicateIndex();
+    return true;
+}
+
+CascadeCounts AIDetector::cascadeCounts() const {
+    CascadeCounts counts;
+    counts.early_exits = cascade_exits_.load(std::memory_order_relaxed);
+    counts.full_model = cascade_passes_.load(std::memory_order_relaxed);
+    return counts;
+}
+
+void AIDetector::countCascade(bool early_exit) {
+    (early_exit ? cascade_exits_ : cascade_passes_).fetch_add(1, std::memory_order_relaxed);
+    Profiler::count(early_exit ? ProfileCounter::CascadeExits : ProfileCounter::CascadePassed, 1);
+}
+
+void AIDetector::dropStaleCascade() {
+    if (cascade_ && cascade_->modelFingerprint() != neural_network_->fingerprint()) {
+        std::cerr << "Dropping the cascade; it was tuned for the previous model" << std::endl;
+        cascade_.reset();
+    }
+}
+
+std::vector<float> AIDetector::scoreImages(const std::vector<std::string>& image_paths) {
+    return scoreImages(image_paths, nullptr);
+}
+
+std::vector<float> AIDetector::scoreImages(const std::vector<std::string>& image_paths,
+                                           std::vector<float>* stage_scores) {
+    std::vector<float> scores(image_paths.size(), -1.0f);
+    if (stage_scores) {
+        stage_scores->assign(image_paths.size(), -1.0f);
+    }
+    if (!is_initialized_) {
+        std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
+        return scores;
+    }
     
-    // Make prediction
-    float confidence = neural_network_->predict(features);
+    // Full features, or none and the stage-1 score for an early exit
+    struct Extraction {
+        Eigen::VectorXf features;
+        float stage_score = -1.0f;
+    };
+    const CascadeModel* cascade = activeCascade();
+    const bool measure = stage_scores != nullptr;
     
-    return confidence;
+    // Extract a batch of images in parallel, then score it in one batched pass
+    Eigen::MatrixXf batch;
+    std::vector<size_t> positions;
+    for (size_t start = 0; start < image_paths.size(); start += EVALUATION_BATCH) {
+        size_t end = std::min(image_paths.size(), start + EVALUATION_BATCH);
+        std::vector<std::future<Extraction>> pending;
+        for (size_t i = start; i < end; ++i) {
+            const std::string& path = image_paths[i];
+            pending.push_back(thread_pool_->submit([this, &path, cascade, measure]() {
+                ScratchScope scope;
+                Extraction extraction;
+                cv::Mat image;
+                {
+                    ScopedTimer timer(ProfileStage::Decode);
+                    image = cv::imread(path);
+                }
+                if (image.empty()) {
+                    return extraction;
+                }
+                if (!cascade) {
+                    extraction.features = feature_extractor_->extractFeatures(image);
+                    return extraction;
+                }
+                Eigen::VectorXf cascade_features = feature_extractor_->extractCascadeFeatures(image);
+                extraction.stage_score = cascade->predict(cascade_features);
+                if (measure || !cascade->band().decides(extraction.stage_score)) {
+                    extraction.features = feature_extractor_->completeFeatures(image, cascade_features);
+                }
+                return extraction;
+            }));
+        }
+        
+        positions.clear();
+        for (size_t i = start; i < end; ++i) {
+            Extraction extraction = thread_pool_->wait(pending[i - start]);
+            Eigen::VectorXf& features = extraction.features;
+            if (features.size() == 0) {
+                if (extraction.stage_score >= 0.0f) {
+                    scores[i] = extraction.stage_score;
+                    countCascade(true);
+                }
+                continue;
+            }
+            if (measure) {
+                (*stage_scores)[i] = extraction.stage_score;
+            } else if (cascade) {
+                countCascade(false);
+            }
+            if (batch.rows() != features.size()) {
+                batch.resize(features.size(), EVALUATION_BATCH);
+            }
+            batch.col(positions.size()) = features;
+            positions.push_back(i);
+        }
+        if (positions.empty()) {
+            continue;
+        }
+        
+        Eigen::MatrixXf inputs = batch.leftCols(positions.size());
+        Eigen::VectorXf batch_scores = ensemble_ ? ensemble_->combine(ensemble_->predictBatch(inputs))
+                                                 : neural_network_->predictBatch(inputs);
+        for (size_t k = 0; k < positions.size(); ++k) {
+            scores[positions[k]] = batch_scores(k);
+        }
+    }
+    return scores;
+}
+
+bool AIDetector::scoreLabeledImages(const std::string& labeled_dir, Eigen::VectorXf& scores,
+                                    Eigen::VectorXf& labels) {
+    if (!is_initialized_) {
+        std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
+        return false;
+    }
+    
+    std::vector<std::pair<std::string, float>> samples = listLabeledImages(labeled_dir);
+    if (samples.empty()) {
+        std::cerr << "No images found under real/ or ai_generated/ in " << labeled_dir << std::endl;
+        return false;
+    }
+    
+    std::vector<std::string> paths;
+    for (const auto& sample : samples) {
+        paths.push_back(sample.first);
+    }
+    std::vector<float> image_scores = scoreImages(paths);
+    
+    std::vector<float> all_scores;
+    std::vector<float> all_labels;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (image_scores[i] < 0.0f) {
+            std::cerr << "Skipping unreadable image: " << samples[i].first << std::endl;
+            continue;
+        }
+        all_scores.push_back(image_scores[i]);
+        all_labels.push_back(samples[i].second);
+    }
+    
+    scores = Eigen::Map<Eigen::VectorXf>(all_scores.data(), all_scores.size());
+    labels = Eigen::Map<Eigen::VectorXf>(all_labels.data(), all_labels.size());
+    return scores.size() > 0;
+}
+
+bool AIDetector::addModel(const std::string& model_path, float weight) {
+    if (!is_initialized_) {
+        std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
+        return false;
+    }
+    
+    if (!ensemble_) {
+        ensemble_ = std::make_unique<ModelEnsemble>();
+        ensemble_->setThreadPool(thread_pool_.get());
+        ensemble_->setCombine(ensemble_combine_);
+        if (!ensemble_->addNetwork(neural_network_.get(), "primary")) {
+            ensemble_.reset();
+            return false;
+        }
+        video_processor_->setEnsemble(ensemble_.get());
+        if (cascade_) {
+            std::cerr << "The cascade is not used with extra models" << std::endl;
+        }
+    }
+    bool added = ensemble_->addModel(model_path, weight);
+    refreshNearDuplicateIndex();
+    return added;
+}
+
+void AIDetector::setEnsembleCombine(EnsembleCombine combine) {
+    ensemble_combine_ = combine;
+    if (ensemble_) {
+        ensemble_->setCombine(combine);
+    }
+    refreshNearDuplicateIndex();
 }
 
 float AIDetector::detectVideo(const std::string& video_path) {
+    return analyzeVideo(video_path).score;
+}
+
+VideoAnalysis AIDetector::analyzeVideo(const std::string& video_path) {
     if (!is_initialized_) {
         std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
-        return -1.0f;
+        return VideoAnalysis();
+    }
+    
+    // Decoded frames and per-video products outlive every per-frame stage, so
+    // they come from the standard allocator; feature extraction, differencing
+    // and optical flow open their own scopes per frame or frame pair
+    return video_processor_->analyzeVideo(video_path);
+}
+
+VideoAnalysis AIDetector::analyzeVideo(const std::string& video_path, const Deadline& deadline) {
+    if (!is_initialized_) {
+        std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
+        return VideoAnalysis();
     }
     
-    return video_processor_->processVideo(video_path);
+    return video_processor_->analyzeVideo(video_path, deadline);
+}
+
+bool AIDetector::detectStream(FrameReader& reader, const StreamOptions& options,
+                              const std::function<void(const StreamScore&)>& on_score) {
+    if (!is_initialized_) {
+        std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
+        return false;
+    }
+    
+    StreamProcessor stream_processor(*feature_extractor_, *neural_network_,
+                                     video_processor_->getMotionQuality());
+    return stream_processor.run(reader, options, on_score);
+}
+
+void AIDetector::setVideoSegments(int segments) {
+    video_processor_->setParallelSegments(segments);
+}
+
+void AIDetector::setAdaptiveSampling(const AdaptiveSampling& adaptive) {
+    video_processor_->setAdaptiveSampling(adaptive);
+}
+
+void AIDetector::setShotSampling(const ShotSampling& shots) {
+    video_processor_->setShotSampling(shots);
+}
+
+void AIDetector::setSegmentCaching(const SegmentCaching& caching) {
+    video_processor_->setSegmentCaching(caching);
+}
+
+void AIDetector::setMotionQuality(MotionQuality quality) {
+    video_processor_->setMotionQuality(quality);
 }
 
-bool AIDetector::train(const std::string& training_data_path, const std::string& output_model_path) {
-    // This is a simplified training implementation
-    // In a real scenario, you would load training data from files
+void AIDetector::setIncrementalFeatures(bool enabled) {
+    video_processor_->setIncrementalFeatures(enabled);
+}
+
+bool AIDetector::train(const std::string& training_data_path, const std::string& output_model_path,
+                       const TrainingOptions& options, const CascadeOptions* cascade) {
     std::cout << "Training model..." << std::endl;
     
-    // For demonstration, we'll create some synthetic training data
-    std::vector<Eigen::VectorXf> inputs;
-    std::vector<Eigen::VectorXf> targets;
+    std::string dataset_path = prepareDataset(training_data_path, output_model_path);
+    FeatureDataset dataset;
+    if (dataset_path.empty() || !dataset.open(dataset_path)) {
+        return false;
+    }
+    if (dataset.sampleCount() == 0) {
+        std::cerr << "Dataset is empty: " << dataset_path << std::endl;
+        return false;
+    }
     
-    // Generate synthetic training data
-    for (int i = 0; i < 1000; ++i) {
-        Eigen::VectorXf input = Eigen::VectorXf::Random(512);
-        Eigen::VectorXf target(1);
-        target(0) = (i % 2 == 0) ? 1.0f : 0.0f; // Alternate between AI and real
-        inputs.push_back(input);
-        targets.push_back(target);
+    // Without a loaded model, start from the default architecture
+    if (neural_network_->layerCount() == 0) {
+        neural_network_->initialize({static_cast<int>(dataset.featureCount()), 256, 128, 64, 1});
+        is_initialized_ = true;
+    } else if (static_cast<size_t>(neural_network_->inputSize()) != dataset.featureCount()) {
+        std::cerr << "Dataset has " << dataset.featureCount() << " features, the model expects "
+                  << neural_network_->inputSize() << std::endl;
+        return false;
     }
     
-    // Train the network
-    neural_network_->train(inputs, targets, 0.01f, 50);
+    std::cout << "Training on " << dataset.sampleCount() << " samples in "
+              << dataset.shardCount() << " shards" << std::endl;
+    DatasetReader reader(dataset, options.shuffle_buffer, options.seed);
+    if (!neural_network_->train(reader, options)) {
+        return false;
+    }
+    if (ensemble_) {
+        ensemble_->refresh();
+    }
+    dropStaleCascade();
+    refreshNearDuplicateIndex();
     
     // Save the trained model
-    if (!output_model_path.empty()) {
-        return saveModel(output_model_path);
+    if (!output_model_path.empty() && !saveModel(output_model_path)) {
+        return false;
     }
     
+    return !cascade || fitCascade(dataset, *cascade);
+}
+
+bool AIDetector::fitCascade(const FeatureDataset& dataset, const CascadeOptions& options) {
+    FeatureShard samples;
+    if (!dataset.loadAll(samples)) {
+        return false;
+    }
+    if (samples.features.rows() != neural_network_->inputSize() ||
+        samples.features.rows() <= FeatureExtractor::CASCADE_FEATURES) {
+        std::cerr << "A cascade needs the full feature vector; the dataset has "
+                  << samples.features.rows() << " features" << std::endl;
+        return false;
+    }
+    
+    // Stage 1 learns on one part of the samples, the band is chosen on the
+    // rest. The full model has seen those too, so its accuracy there is
+    // optimistic and the band errs on the narrow side.
+    const Eigen::Index count = samples.labels.size();
+    std::vector<Eigen::Index> permutation(count);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::shuffle(permutation.begin(), permutation.end(),
+                 std::mt19937(options.training.seed ? options.training.seed : DATASET_SHUFFLE_SEED));
+    const Eigen::Index holdout_start = count - static_cast<Eigen::Index>(options.holdout * count);
+    std::vector<Eigen::Index> fit_samples(permutation.begin(), permutation.begin() + holdout_start);
+    std::vector<Eigen::Index> holdout(permutation.begin() + holdout_start, permutation.end());
+    if (fit_samples.empty() || holdout.empty()) {
+        std::cerr << "Too few samples to fit and tune a cascade: " << count << std::endl;
+        return false;
+    }
+    
+    std::cout << "Fitting cascade stage 1 on " << fit_samples.size() << " samples, choosing its band on "
+              << holdout.size() << std::endl;
+    Eigen::MatrixXf cascade_features = FeatureExtractor::cascadeFeatures(samples.features);
+    auto cascade = std::make_unique<CascadeModel>();
+    cascade->fit(cascade_features, samples.labels, fit_samples, options);
+    
+    Eigen::VectorXf stage_scores = cascade->predictBatch(cascade_features(Eigen::all, holdout));
+    Eigen::VectorXf full_scores = neural_network_->predictBatch(samples.features(Eigen::all, holdout));
+    CascadeReport report = CascadeModel::chooseBand(stage_scores, full_scores, samples.labels(holdout),
+                                                    options.max_accuracy_loss, CONFIDENCE_THRESHOLD);
+    cascade->setBand(report.band, neural_network_->fingerprint());
+    report.print(std::cout);
+    
+    cascade_ = std::move(cascade);
+    refreshNearDuplicateIndex();
+    return saveCascade(options.output_path);
+}
+
+bool AIDetector::sweep(const std::string& training_data_path, const std::string& output_model_path,
+                       const SweepOptions& options) {
+    if (options.configs.empty()) {
+        std::cerr << "No configurations to sweep" << std::endl;
+        return false;
+    }
+    if (!(options.holdout > 0.0f && options.holdout < 1.0f)) {
+        std::cerr << "Holdout fraction must lie strictly between 0 and 1: " << options.holdout << std::endl;
+        return false;
+    }
+    
+    std::string dataset_path = prepareDataset(training_data_path, output_model_path);
+    FeatureDataset dataset;
+    FeatureShard samples;
+    if (dataset_path.empty() || !dataset.open(dataset_path) || !dataset.loadAll(samples)) {
+        return false;
+    }
+    if (samples.labels.size() < std::max(2, options.folds)) {
+        std::cerr << "Too few samples to validate: " << samples.labels.size() << std::endl;
+        return false;
+    }
+    
+    std::cout << "Sweeping " << options.configs.size() << " configurations x "
+              << std::max(1, options.folds) << " folds over " << samples.labels.size()
+              << " samples on " << thread_pool_->size() << " threads" << std::endl;
+    HyperparameterSweep sweep(samples.features, samples.labels, *thread_pool_);
+    std::vector<SweepResult> results = sweep.run(options);
+    HyperparameterSweep::printTable(results, std::cout);
+    
+    // The winner is retrained on every sample for the saved model
+    std::cout << "Training best configuration (" << results[0].config.describe() << ") on all samples" << std::endl;
+    std::unique_ptr<NeuralNetwork> best = sweep.trainFinal(results[0].config, options.training);
+    if (!best->saveModel(output_model_path)) {
+        std::cerr << "Failed to save model: " << output_model_path << std::endl;
+        return false;
+    }
     return true;
 }
 
+std::string AIDetector::prepareDataset(const std::string& training_data_path, const std::string& output_model_path) {
+    if (FeatureDataset::isDataset(training_data_path)) {
+        return training_data_path;
+    }
+    std::string dataset_path = output_model_path.empty() ? "features.dataset" : output_model_path + ".dataset";
+    std::cout << "Extracting features into: " << dataset_path << std::endl;
+    return buildDataset(training_data_path, dataset_path) ? dataset_path : std::string();
+}
+
+bool AIDetector::buildDataset(const std::string& training_data_path, const std::string& dataset_path,
+                              FeatureEncoding encoding, size_t samples_per_shard) {
+    std::vector<std::pair<std::string, float>> samples = listLabeledImages(training_data_path);
+    if (samples.empty()) {
+        std::cerr << "No images found under real/ or ai_generated/ in " << training_data_path << std::endl;
+        return false;
+    }
+    
+    // Shards are streamed in order, so the file order must not follow the class layout
+    std::shuffle(samples.begin(), samples.end(), std::mt19937(DATASET_SHUFFLE_SEED));
+    
+    // Extract a window of images in parallel, then append them in order
+    std::unique_ptr<FeatureDatasetWriter> writer;
+    const size_t window = thread_pool_->size() * 2;
+    size_t skipped = 0;
+    for (size_t start = 0; start < samples.size(); start += window) {
+        size_t end = std::min(samples.size(), start + window);
+        std::vector<std::future<Eigen::VectorXf>> pending;
+        for (size_t i = start; i < end; ++i) {
+            const std::string& path = samples[i].first;
+            pending.push_back(thread_pool_->submit([this, &path]() {
+                ScratchScope scope;
+                cv::Mat image = cv::imread(path);
+                return image.empty() ? Eigen::VectorXf() : feature_extractor_->extractFeatures(image);
+            }));
+        }
+        
+        for (size_t i = start; i < end; ++i) {
+            Eigen::VectorXf features = thread_pool_->wait(pending[i - start]);
+            if (features.size() == 0) {
+                std::cerr << "Skipping unreadable image: " << samples[i].first << std::endl;
+                ++skipped;
+                continue;
+            }
+            if (!writer) {
+                writer = std::make_unique<FeatureDatasetWriter>(dataset_path, features.size(), encoding,
+                                                                samples_per_shard);
+            }
+            if (!writer->add(features, samples[i].second)) {
+                return false;
+            }
+        }
+        
+        if (end / 1000 != start / 1000) {
+            std::cout << "Extracted " << end << " / " << samples.size() << " images" << std::endl;
+        }
+    }
+    
+    if (!writer || !writer->finish()) {
+        std::cerr << "Failed to write dataset: " << dataset_path << std::endl;
+        return false;
+    }
+    std::cout << "Dataset written: " << writer->sampleCount() << " samples ("
+              << skipped << " skipped), " << FeatureDataset::encodingName(encoding) << " features" << std::endl;
+    return true;
+}
+
+bool AIDetector::pruneModel(const std::string& output_model_path, const PruneOptions& options,
+                            const std::string& calibration_dir) {
+    if (!is_initialized_) {
+        std::cerr << "Detector not initialized. Call initialize() first." << std::endl;
+        return false;
+    }
+    
+    Eigen::MatrixXf calibration;
+    if (!calibration_dir.empty()) {
+        std::vector<Eigen::VectorXf> samples;
+        for (const auto& path : listImages(calibration_dir)) {
+            ScratchScope scope;
+            cv::Mat image = cv::imread(path);
+            if (image.empty()) {
+                std::cerr << "Skipping unreadable image: " << path << std::endl;
+                continue;
+            }
+            samples.push_back(feature_extractor_->extractFeatures(image));
+        }
+        std::cout << "Calibrating on " << samples.size() << " images" << std::endl;
+        
+        if (!samples.empty()) {
+            calibration.resize(samples[0].size(), samples.size());
+            for (size_t i = 0; i < samples.size(); ++i) {
+                calibration.col(i) = samples[i];
+            }
+        }
+    }
+    
+    neural_network_->prune(options, calibration);
+    if (ensemble_) {
+        ensemble_->refresh();
+    }
+    dropStaleCascade();
+    refreshNearDuplicateIndex();
+    return saveModel(output_model_path);
+}
+
 bool AIDetector::saveModel(const std::string& model_path) {
     return neural_network_->saveModel(model_path);
 }
 
+bool AIDetector::exportModelCpp(const std::string& header_path, const std::string& name_space) const {
+    if (ensemble_) {
+        std::cerr << "Only the primary model is exported; extra models are left out" << std::endl;
+    }
+    return neural_network_->exportCpp(header_path, name_space);
+}
+
 bool AIDetector::loadModel(const std::string& model_path) {
-    return neural_network_->loadModel(model_path);
+    if (!neural_network_->loadModel(model_path)) {
+        return false;
+    }
+    // The primary model's first layer is stacked into the ensemble
+    if (ensemble_) {
+        ensemble_->refresh();
+    }
+    dropStaleCascade();
+    refreshNearDuplicateIndex();
+    return true;
 } 
\ No newline at end of file
@@ -0,0 +1,467 @@
+#include "../include/batch_scanner.h"
+#include "../include/file_io.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+
+namespace {
+
+const char* RESULTS_HEADER = "path\ttype\tscore\tresult\n";
+
+// FNV-1a, finalized so the low bits (shard = hash % N) depend on every byte
+uint64_t pathHash(const std::string& path) {
+    uint64_t hash = 1469598103934665603ull;
+    for (char c : path) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+std::string lowerExtension(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+bool isImage(const std::string& extension) {
+    static const std::vector<std::string> extensions = {".jpg", ".jpeg", ".png", ".bmp", ".webp", ".tif", ".tiff"};
+    return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+}
+
+bool isVideo(const std::string& extension) {
+    static const std::vector<std::string> extensions = {".mp4", ".avi", ".mov", ".mkv", ".webm", ".m4v", ".ts"};
+    return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+}
+
+// Type and score columns of one result row
+bool parseRow(const std::string& line, std::string& type, float& score) {
+    size_t first = line.find('\t');
+    size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+    if (second == std::string::npos) {
+        return false;
+    }
+    type = line.substr(first + 1, second - first - 1);
+    try {
+        score = std::stof(line.substr(second + 1));
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool ShardSpec::parse(const std::string& text, ShardSpec& shard) {
+    int index = 0, count = 0;
+    char slash = 0, extra = 0;
+    if (std::sscanf(text.c_str(), "%d%c%d%c", &index, &slash, &count, &extra) != 3 || slash != '/' ||
+        count < 1 || index < 0 || index >= count) {
+        return false;
+    }
+    shard.index = index;
+    shard.count = count;
+    return true;
+}
+
+bool ShardSpec::owns(const std::string& relative_path) const {
+    return pathHash(relative_path) % static_cast<uint64_t>(count) == static_cast<uint64_t>(index);
+}
+
+std::string ShardSpec::name() const {
+    char name[48];
+    std::snprintf(name, sizeof(name), "shard-%04d-of-%04d", index, count);
+    return name;
+}
+
+void BatchSummary::add(const std::string& type, float score, const BatchOptions& options) {
+    (type == "video" ? videos : images)++;
+    if (score < 0.0f) {
+        errors++;
+        return;
+    }
+    if (score > options.likely_threshold) {
+        likely_ai++;
+    } else if (score > options.possibly_threshold) {
+        possibly_ai++;
+    } else {
+        real++;
+    }
+    score_sum += score;
+    histogram[std::min(9, static_cast<int>(score * 10.0f))]++;
+}
+
+void BatchSummary::print(std::ostream& out) const {
+    uint64_t scored = likely_ai + possibly_ai + real;
+    out << "Files: " << (images + videos) << " (" << images << " images, " << videos << " videos, "
+        << errors << " failed)\n";
+    out << "Likely AI-generated: " << likely_ai << "\n";
+    out << "Possibly AI-generated: " << possibly_ai << "\n";
+    out << "Likely real: " << real << "\n";
+    if (scored > 0) {
+        out << std::fixed << std::setprecision(4) << "Mean score: " << score_sum / scored << "\n";
+        out << std::defaultfloat;
+    }
+    out << "Score histogram:\n";
+    for (int bin = 0; bin < 10; ++bin) {
+        out << "  " << std::fixed << std::setprecision(1) << bin / 10.0 << "-" << (bin + 1) / 10.0
+            << std::defaultfloat << ": " << histogram[bin] << "\n";
+    }
+}
+
+BatchScanner::BatchScanner(AIDetector& detector, const BatchOptions& options)
+    : detector_(detector), options_(options) {
+    options_.chunk = std::max<size_t>(1, options_.chunk);
+}
+
+std::vector<std::string> BatchScanner::listShardFiles(const std::string& input_dir) const {
+    namespace fs = std::filesystem;
+    std::vector<std::string> files;
+    std::error_code error;
+    fs::recursive_directory_iterator it(input_dir, fs::directory_options::skip_permission_denied, error);
+    for (; !error && it != fs::recursive_directory_iterator(); it.increment(error)) {
+        if (!it->is_regular_file()) {
+            continue;
+        }
+        std::string extension = lowerExtension(it->path());
+        if (!isImage(extension) && !isVideo(extension)) {
+            continue;
+        }
+
+        // Relative and with forward slashes, so machines that mount the
+        // share at different places agree on the partition
+        std::string relative = it->path().lexically_relative(input_dir).generic_string();
+        if (relative.find_first_of("\t\n") != std::string::npos) {
+            std::cerr << "Skipping file with a tab or newline in its path: " << relative << std::endl;
+            continue;
+        }
+        if (options_.shard.owns(relative)) {
+            files.push_back(relative);
+        }
+    }
+    if (error) {
+        std::cerr << "Failed to list " << input_dir << ": " << error.message() << std::endl;
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+std::string BatchScanner::resultRow(const std::string& path, const std::string& type, float score) const {
+    const char* result = "error";
+    if (score > options_.likely_threshold) {
+        result = "likely_ai";
+    } else if (score > options_.possibly_threshold) {
+        result = "possibly_ai";
+    } else if (score >= 0.0f) {
+        result = "real";
+    }
+    std::ostringstream row;
+    row << path << "\t" << type << "\t" << std::setprecision(6) << score << "\t" << result << "\n";
+    return row.str();
+}
+
+bool BatchScanner::run(const std::string& input_dir, const std::string& output_dir) {
+    namespace fs = std::filesystem;
+    if (!fs::is_directory(input_dir)) {
+        std::cerr << "Input directory not found: " << input_dir << std::endl;
+        return false;
+    }
+    std::error_code error;
+    fs::create_directories(output_dir, error);
+    if (error) {
+        std::cerr << "Cannot create output directory: " << output_dir << std::endl;
+        return false;
+    }
+
+    // The manifest's input is compared as written, minus trailing separators
+    std::string input = fs::path(input_dir).lexically_normal().generic_string();
+    while (input.size() > 1 && input.back() == '/') {
+        input.pop_back();
+    }
+    const std::string stem = (fs::path(output_dir) / options_.shard.name()).string();
+    const std::string results_path = stem + ".tsv";
+    const std::string manifest_path = stem + ".manifest";
+    const std::string shard = std::to_string(options_.shard.index) + "/" + std::to_string(options_.shard.count);
+
+    Manifest manifest;
+    if (readManifest(manifest_path, manifest)) {
+        if (manifest.input != input || manifest.shard.index != options_.shard.index ||
+            manifest.shard.count != options_.shard.count || manifest.model != detector_.modelFingerprint()) {
+            std::cerr << "Manifest " << manifest_path << " belongs to another scan or model; "
+                      << "remove it to start the shard over" << std::endl;
+            return false;
+        }
+        if (manifest.complete) {
+            std::cout << "Shard " << shard << " already complete: " << manifest.files_done << " files" << std::endl;
+            return true;
+        }
+
+        // Rows past the committed size belong to a chunk that never finished
+        fs::resize_file(results_path, manifest.results_bytes, error);
+        if (error) {
+            std::cerr << "Cannot restore results file: " << results_path << std::endl;
+            return false;
+        }
+    } else {
+        manifest.input = input;
+        manifest.shard = options_.shard;
+        manifest.model = detector_.modelFingerprint();
+        std::ofstream results(results_path, std::ios::binary | std::ios::trunc);
+        results << RESULTS_HEADER;
+        if (!results) {
+            std::cerr << "Failed to write results: " << results_path << std::endl;
+            return false;
+        }
+        manifest.results_bytes = std::string(RESULTS_HEADER).size();
+        if (!writeManifest(manifest_path, manifest)) {
+            return false;
+        }
+    }
+
+    std::vector<std::string> files = listShardFiles(input_dir);
+    auto next = manifest.last_path.empty() ? files.begin()
+                                           : std::upper_bound(files.begin(), files.end(), manifest.last_path);
+    std::cout << "Shard " << shard << ": " << files.size() << " files, "
+              << (files.end() - next) << " to scan" << std::endl;
+
+    std::ofstream results(results_path, std::ios::binary | std::ios::app);
+    while (next != files.end()) {
+        auto chunk_end = next + std::min<ptrdiff_t>(options_.chunk, files.end() - next);
+
+        // Images of the chunk are scored in one batch, videos one at a time
+        std::vector<std::string> types;
+        std::vector<float> scores;
+        std::vector<std::string> images;
+        std::vector<size_t> image_positions;
+        for (auto it = next; it != chunk_end; ++it) {
+            std::string full = (fs::path(input_dir) / *it).string();
+            if (isVideo(lowerExtension(*it))) {
+                types.push_back("video");
+                scores.push_back(detector_.analyzeVideo(full).score);
+            } else {
+                types.push_back("image");
+                scores.push_back(-1.0f);
+                images.push_back(full);
+                image_positions.push_back(scores.size() - 1);
+            }
+        }
+        std::vector<float> image_scores = detector_.scoreImages(images);
+        for (size_t k = 0; k < image_positions.size(); ++k) {
+            scores[image_positions[k]] = image_scores[k];
+        }
+
+        std::string rows;
+        for (size_t k = 0; k < scores.size(); ++k) {
+            rows += resultRow(*(next + k), types[k], scores[k]);
+        }
+        results << rows;
+        results.flush();
+        if (!results) {
+            std::cerr << "Failed to write results: " << results_path << std::endl;
+            return false;
+        }
+
+        // Rows first, then the manifest that commits them
+        manifest.results_bytes += rows.size();
+        manifest.files_done += scores.size();
+        manifest.last_path = *(chunk_end - 1);
+        if (!writeManifest(manifest_path, manifest)) {
+            return false;
+        }
+        next = chunk_end;
+        std::cout << "Shard " << shard << ": " << manifest.files_done << " files done" << std::endl;
+    }
+
+    manifest.complete = true;
+    if (!writeManifest(manifest_path, manifest)) {
+        return false;
+    }
+    std::cout << "Shard " << shard << " complete: " << results_path << std::endl;
+    return true;
+}
+
+bool BatchScanner::readManifest(const std::string& path, Manifest& manifest) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    bool has_shard = false;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, equals);
+        std::string value = line.substr(equals + 1);
+        try {
+            if (key == "input") {
+                manifest.input = value;
+            } else if (key == "shard") {
+                has_shard = ShardSpec::parse(value, manifest.shard);
+            } else if (key == "model") {
+                manifest.model = std::stoull(value, nullptr, 16);
+            } else if (key == "files_done") {
+                manifest.files_done = std::stoull(value);
+            } else if (key == "results_bytes") {
+                manifest.results_bytes = std::stoull(value);
+            } else if (key == "last_path") {
+                manifest.last_path = value;
+            } else if (key == "complete") {
+                manifest.complete = value == "1";
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Ignoring damaged manifest: " << path << std::endl;
+            return false;
+        }
+    }
+    if (!has_shard) {
+        std::cerr << "Ignoring damaged manifest: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool BatchScanner::writeManifest(const std::string& path, const Manifest& manifest) {
+    std::ostringstream out;
+    out << "input=" << manifest.input << "\n";
+    out << "shard=" << manifest.shard.index << "/" << manifest.shard.count << "\n";
+    out << "model=" << std::hex << manifest.model << std::dec << "\n";
+    out << "files_done=" << manifest.files_done << "\n";
+    out << "results_bytes=" << manifest.results_bytes << "\n";
+    out << "last_path=" << manifest.last_path << "\n";
+    out << "complete=" << (manifest.complete ? 1 : 0) << "\n";
+    if (!writeAtomically(path, out.str())) {
+        std::cerr << "Failed to write manifest: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool BatchScanner::merge(const std::string& results_dir, const std::string& merged_path,
+                         const BatchOptions& options, BatchSummary& summary) {
+    namespace fs = std::filesystem;
+    static const std::regex shard_name(R"(shard-(\d+)-of-(\d+)\.tsv)");
+
+    std::vector<std::pair<ShardSpec, fs::path>> shards;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(results_dir, error)) {
+        std::smatch match;
+        std::string name = entry.path().filename().string();
+        if (std::regex_match(name, match, shard_name)) {
+            ShardSpec shard;
+            shard.index = std::stoi(match[1]);
+            shard.count = std::stoi(match[2]);
+            if (shard.count > 0 && shard.index < shard.count) {
+                shards.emplace_back(shard, entry.path());
+            }
+        }
+    }
+    if (error || shards.empty()) {
+        std::cerr << "No shard results found in " << results_dir << std::endl;
+        return false;
+    }
+    std::sort(shards.begin(), shards.end(), [](const auto& a, const auto& b) {
+        return a.first.index < b.first.index;
+    });
+
+    // All shards of one scan must be there, each once; "shard-1-of-4" and
+    // "shard-01-of-4" name the same shard
+    const int count = shards.front().first.count;
+    std::vector<bool> present(count, false);
+    for (const auto& shard : shards) {
+        if (shard.first.count != count) {
+            std::cerr << "Shard results of different scans in " << results_dir
+                      << " (" << count << " and " << shard.first.count << " shards)" << std::endl;
+            return false;
+        }
+        if (present[shard.first.index]) {
+            std::cerr << "Duplicate results for shard " << shard.first.index << "/" << count
+                      << " in " << results_dir << std::endl;
+            return false;
+        }
+        present[shard.first.index] = true;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (!present[i]) {
+            std::cerr << "Warning: shard " << i << "/" << count << " has no results" << std::endl;
+        }
+    }
+
+    // Every shard must come from the same input directory and model; each
+    // counts as far as its manifest committed
+    std::vector<std::pair<Manifest, fs::path>> committed;
+    for (const auto& shard : shards) {
+        fs::path manifest_path = shard.second;
+        manifest_path.replace_extension(".manifest");
+        Manifest manifest;
+        if (!readManifest(manifest_path.string(), manifest)) {
+            std::cerr << "Warning: skipping shard without a manifest: " << shard.second.string() << std::endl;
+            continue;
+        }
+        if (!committed.empty() && (manifest.input != committed.front().first.input ||
+                                   manifest.model != committed.front().first.model)) {
+            std::cerr << "Shard results of different scans in " << results_dir << " ("
+                      << committed.front().second.filename().string() << " and "
+                      << shard.second.filename().string() << " differ in input or model)" << std::endl;
+            return false;
+        }
+        committed.emplace_back(manifest, shard.second);
+    }
+
+    // Streamed through a temporary file; shards may not fit in memory
+    const std::string temp_path = merged_path + ".tmp";
+    std::ofstream merged(temp_path, std::ios::binary | std::ios::trunc);
+    if (!merged.is_open()) {
+        std::cerr << "Cannot write merged results: " << temp_path << std::endl;
+        return false;
+    }
+    merged << RESULTS_HEADER;
+    for (const auto& entry : committed) {
+        const Manifest& manifest = entry.first;
+        if (!manifest.complete) {
+            std::cerr << "Warning: shard " << manifest.shard.index << "/" << count << " is unfinished ("
+                      << manifest.files_done << " files so far)" << std::endl;
+        }
+
+        std::ifstream rows(entry.second, std::ios::binary);
+        std::string line;
+        uint64_t consumed = 0;
+        bool header = true;
+        while (std::getline(rows, line)) {
+            consumed += line.size() + 1;
+            if (consumed > manifest.results_bytes) {
+                break;
+            }
+            std::string type;
+            float score = -1.0f;
+            if (header || !parseRow(line, type, score)) {
+                header = false;
+                continue;
+            }
+            summary.add(type, score, options);
+            merged << line << "\n";
+        }
+    }
+
+    merged.close();
+    if (merged) {
+        fs::rename(temp_path, merged_path, error);
+    }
+    if (!merged || error) {
+        std::cerr << "Failed to write merged results: " << merged_path << std::endl;
+        return false;
+    }
+    return true;
+}
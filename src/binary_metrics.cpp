@@ -0,0 +1,130 @@
+#include "../include/binary_metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+float BinaryMetrics::auc(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels) {
+    // Mann-Whitney U: sum of the positives' ranks among all scores
+    std::vector<Eigen::Index> order(scores.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](Eigen::Index a, Eigen::Index b) { return scores(a) < scores(b); });
+    
+    double positive_rank_sum = 0.0;
+    double positives = 0.0;
+    for (size_t i = 0; i < order.size();) {
+        // Ties share the average of their ranks
+        size_t end = i;
+        while (end < order.size() && scores(order[end]) == scores(order[i])) {
+            ++end;
+        }
+        double rank = (i + 1 + end) / 2.0;
+        for (size_t k = i; k < end; ++k) {
+            if (labels(order[k]) > 0.5f) {
+                positive_rank_sum += rank;
+                positives += 1.0;
+            }
+        }
+        i = end;
+    }
+    
+    double negatives = static_cast<double>(order.size()) - positives;
+    if (positives == 0.0 || negatives == 0.0) {
+        return 0.5f;
+    }
+    return static_cast<float>((positive_rank_sum - positives * (positives + 1.0) / 2.0) / (positives * negatives));
+}
+
+float BinaryMetrics::logLoss(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels) {
+    if (scores.size() == 0) {
+        return 0.0f;
+    }
+    const float epsilon = 1e-7f;
+    Eigen::ArrayXf p = scores.array().max(epsilon).min(1.0f - epsilon);
+    Eigen::ArrayXf t = labels.array();
+    return -(t * p.log() + (1.0f - t) * (1.0f - p).log()).mean();
+}
+
+float BinaryMetrics::accuracy(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels, float threshold) {
+    if (scores.size() == 0) {
+        return 0.0f;
+    }
+    Eigen::Index correct = ((scores.array() > threshold) == (labels.array() > 0.5f)).count();
+    return static_cast<float>(correct) / scores.size();
+}
+
+ThresholdMetrics BinaryMetrics::atThreshold(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels,
+                                            float threshold) {
+    ThresholdMetrics result;
+    result.threshold = threshold;
+    if (scores.size() == 0) {
+        return result;
+    }
+    Eigen::Array<bool, Eigen::Dynamic, 1> flagged = scores.array() > threshold;
+    Eigen::Array<bool, Eigen::Dynamic, 1> positive = labels.array() > 0.5f;
+    Eigen::Index true_positives = (flagged && positive).count();
+    Eigen::Index flagged_count = flagged.count();
+    Eigen::Index positives = positive.count();
+    Eigen::Index negatives = scores.size() - positives;
+    
+    result.precision = flagged_count > 0 ? static_cast<float>(true_positives) / flagged_count : 0.0f;
+    result.recall = positives > 0 ? static_cast<float>(true_positives) / positives : 0.0f;
+    result.false_positive_rate = negatives > 0 ? static_cast<float>(flagged_count - true_positives) / negatives : 0.0f;
+    result.accuracy = accuracy(scores, labels, threshold);
+    return result;
+}
+
+std::vector<RocPoint> BinaryMetrics::roc(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels) {
+    std::vector<Eigen::Index> order(scores.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](Eigen::Index a, Eigen::Index b) { return scores(a) > scores(b); });
+    
+    Eigen::Index positives = (labels.array() > 0.5f).count();
+    Eigen::Index negatives = scores.size() - positives;
+    std::vector<RocPoint> curve;
+    curve.push_back({std::numeric_limits<float>::infinity(), 0.0f, 0.0f});
+    
+    double true_positives = 0.0;
+    double false_positives = 0.0;
+    for (size_t i = 0; i < order.size();) {
+        // Tied scores cross the threshold together
+        size_t end = i;
+        while (end < order.size() && scores(order[end]) == scores(order[i])) {
+            if (labels(order[end]) > 0.5f) {
+                true_positives += 1.0;
+            } else {
+                false_positives += 1.0;
+            }
+            ++end;
+        }
+        curve.push_back({scores(order[i]),
+                         positives > 0 ? static_cast<float>(true_positives / positives) : 0.0f,
+                         negatives > 0 ? static_cast<float>(false_positives / negatives) : 0.0f});
+        i = end;
+    }
+    return curve;
+}
+
+float BinaryMetrics::calibrationError(const Eigen::VectorXf& scores, const Eigen::VectorXf& labels, int bins) {
+    if (scores.size() == 0 || bins < 1) {
+        return 0.0f;
+    }
+    std::vector<double> score_sum(bins, 0.0);
+    std::vector<double> label_sum(bins, 0.0);
+    std::vector<Eigen::Index> counts(bins, 0);
+    for (Eigen::Index i = 0; i < scores.size(); ++i) {
+        int bin = std::min(bins - 1, std::max(0, static_cast<int>(scores(i) * bins)));
+        score_sum[bin] += scores(i);
+        label_sum[bin] += labels(i) > 0.5f ? 1.0 : 0.0;
+        ++counts[bin];
+    }
+    
+    double error = 0.0;
+    for (int bin = 0; bin < bins; ++bin) {
+        if (counts[bin] > 0) {
+            error += std::abs(score_sum[bin] - label_sum[bin]) / scores.size();
+        }
+    }
+    return static_cast<float>(error);
+}
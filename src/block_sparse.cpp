@@ -0,0 +1,173 @@
+#include "../include/block_sparse.h"
+#include <algorithm>
+#include <utility>
+
+BlockSparseMatrix BlockSparseMatrix::fromDense(const Eigen::MatrixXf& dense) {
+    BlockSparseMatrix matrix;
+    matrix.rows_ = dense.rows();
+    matrix.cols_ = dense.cols();
+    matrix.row_start_.push_back(0);
+    
+    for (Eigen::Index br = 0; br < matrix.blockRows(); ++br) {
+        Eigen::Index r0 = br * BLOCK_ROWS;
+        Eigen::Index height = std::min<Eigen::Index>(BLOCK_ROWS, matrix.rows_ - r0);
+        for (Eigen::Index bc = 0; bc < matrix.blockCols(); ++bc) {
+            Eigen::Index c0 = bc * BLOCK_COLS;
+            Eigen::Index width = std::min<Eigen::Index>(BLOCK_COLS, matrix.cols_ - c0);
+            auto source = dense.block(r0, c0, height, width);
+            if ((source.array() == 0.0f).all()) {
+                continue;
+            }
+            
+            // Partial edge blocks are zero-padded to the full block size
+            Block block = Block::Zero();
+            block.topLeftCorner(height, width) = source;
+            matrix.col_index_.push_back(static_cast<int32_t>(bc));
+            matrix.values_.insert(matrix.values_.end(), block.data(), block.data() + block.size());
+        }
+        matrix.row_start_.push_back(static_cast<int32_t>(matrix.col_index_.size()));
+    }
+    return matrix;
+}
+
+Eigen::MatrixXf BlockSparseMatrix::toDense() const {
+    Eigen::MatrixXf dense = Eigen::MatrixXf::Zero(rows_, cols_);
+    for (Eigen::Index br = 0; br < blockRows(); ++br) {
+        Eigen::Index r0 = br * BLOCK_ROWS;
+        Eigen::Index height = std::min<Eigen::Index>(BLOCK_ROWS, rows_ - r0);
+        for (int32_t k = row_start_[br]; k < row_start_[br + 1]; ++k) {
+            Eigen::Index c0 = static_cast<Eigen::Index>(col_index_[k]) * BLOCK_COLS;
+            Eigen::Index width = std::min<Eigen::Index>(BLOCK_COLS, cols_ - c0);
+            Eigen::Map<const Block> block(values_.data() + static_cast<size_t>(k) * Block::SizeAtCompileTime);
+            dense.block(r0, c0, height, width) = block.topLeftCorner(height, width);
+        }
+    }
+    return dense;
+}
+
+float BlockSparseMatrix::density() const {
+    Eigen::Index total = blockRows() * blockCols();
+    return total > 0 ? static_cast<float>(blockCount()) / total : 0.0f;
+}
+
+void BlockSparseMatrix::multiply(const Eigen::Ref<const Eigen::MatrixXf>& inputs, Eigen::Ref<Eigen::MatrixXf> out) const {
+    // Samples are processed in groups so every loaded block is used several times
+    constexpr int GROUP = 4;
+    using Sums = Eigen::Matrix<float, BLOCK_ROWS, GROUP>;
+    using Slices = Eigen::Matrix<float, BLOCK_COLS, GROUP>;
+    using Column = Eigen::Matrix<float, BLOCK_ROWS, 1>;
+    using Slice = Eigen::Matrix<float, BLOCK_COLS, 1>;
+    const float* values = values_.data();
+    const Eigen::Index stride = inputs.outerStride();
+    const Eigen::Index batch = inputs.cols();
+    
+    // A partial last column-block would read past the input rows; copy it zero-padded
+    auto slices = [&](int32_t k, Eigen::Index j, Eigen::Index count, Slices& padded) -> bool {
+        Eigen::Index c0 = static_cast<Eigen::Index>(col_index_[k]) * BLOCK_COLS;
+        if (c0 + BLOCK_COLS <= cols_) {
+            return false;
+        }
+        padded.setZero();
+        padded.topLeftCorner(cols_ - c0, count) = inputs.block(c0, j, cols_ - c0, count);
+        return true;
+    };
+    
+    for (Eigen::Index br = 0; br < blockRows(); ++br) {
+        Eigen::Index r0 = br * BLOCK_ROWS;
+        Eigen::Index height = std::min<Eigen::Index>(BLOCK_ROWS, rows_ - r0);
+        int32_t first = row_start_[br];
+        int32_t last = row_start_[br + 1];
+        
+        // The row-block's weights stay in L1 across the batch; output columns
+        // accumulate in registers over the stored blocks
+        Eigen::Index j = 0;
+        for (; j + GROUP <= batch; j += GROUP) {
+            Sums sum = Sums::Zero();
+            for (int32_t k = first; k < last; ++k) {
+                Eigen::Map<const Block> block(values + static_cast<size_t>(k) * Block::SizeAtCompileTime);
+                Slices padded;
+                if (slices(k, j, GROUP, padded)) {
+                    sum.noalias() += block.lazyProduct(padded);
+                    continue;
+                }
+                const float* x = inputs.data() + j * stride + col_index_[k] * BLOCK_COLS;
+                sum.noalias() += block.lazyProduct(
+                    Eigen::Map<const Slices, 0, Eigen::OuterStride<>>(x, Eigen::OuterStride<>(stride)));
+            }
+            out.block(r0, j, height, GROUP) = sum.topRows(height);
+        }
+        
+        for (; j < batch; ++j) {
+            Column sum = Column::Zero();
+            for (int32_t k = first; k < last; ++k) {
+                Eigen::Map<const Block> block(values + static_cast<size_t>(k) * Block::SizeAtCompileTime);
+                Slices padded;
+                if (slices(k, j, 1, padded)) {
+                    sum.noalias() += block.lazyProduct(padded.col(0));
+                    continue;
+                }
+                const float* x = inputs.data() + j * stride + col_index_[k] * BLOCK_COLS;
+                sum.noalias() += block.lazyProduct(Eigen::Map<const Slice>(x));
+            }
+            out.col(j).segment(r0, height) = sum.head(height);
+        }
+    }
+}
+
+void BlockSparseMatrix::write(std::ostream& stream) const {
+    int64_t rows = rows_;
+    int64_t cols = cols_;
+    int64_t blocks = static_cast<int64_t>(col_index_.size());
+    stream.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    stream.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
+    stream.write(reinterpret_cast<const char*>(&blocks), sizeof(blocks));
+    stream.write(reinterpret_cast<const char*>(row_start_.data()), row_start_.size() * sizeof(int32_t));
+    stream.write(reinterpret_cast<const char*>(col_index_.data()), col_index_.size() * sizeof(int32_t));
+    stream.write(reinterpret_cast<const char*>(values_.data()), values_.size() * sizeof(float));
+}
+
+bool BlockSparseMatrix::read(std::istream& stream) {
+    int64_t rows = 0;
+    int64_t cols = 0;
+    int64_t blocks = 0;
+    stream.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+    stream.read(reinterpret_cast<char*>(&cols), sizeof(cols));
+    stream.read(reinterpret_cast<char*>(&blocks), sizeof(blocks));
+    if (!stream || rows <= 0 || cols <= 0 || rows > MAX_DIMENSION || cols > MAX_DIMENSION || blocks < 0) {
+        return false;
+    }
+    
+    // Read into a separate matrix so a failed read leaves this one untouched
+    BlockSparseMatrix loaded;
+    loaded.rows_ = rows;
+    loaded.cols_ = cols;
+    if (blocks > loaded.blockRows() * loaded.blockCols()) {
+        return false;
+    }
+    loaded.row_start_.resize(loaded.blockRows() + 1);
+    loaded.col_index_.resize(blocks);
+    loaded.values_.resize(static_cast<size_t>(blocks) * Block::SizeAtCompileTime);
+    stream.read(reinterpret_cast<char*>(loaded.row_start_.data()), loaded.row_start_.size() * sizeof(int32_t));
+    stream.read(reinterpret_cast<char*>(loaded.col_index_.data()), loaded.col_index_.size() * sizeof(int32_t));
+    stream.read(reinterpret_cast<char*>(loaded.values_.data()), loaded.values_.size() * sizeof(float));
+    if (!stream) {
+        return false;
+    }
+    
+    // Reject indices that would address memory outside the matrix
+    if (loaded.row_start_.front() != 0 || loaded.row_start_.back() != blocks) {
+        return false;
+    }
+    for (size_t i = 1; i < loaded.row_start_.size(); ++i) {
+        if (loaded.row_start_[i] < loaded.row_start_[i - 1]) {
+            return false;
+        }
+    }
+    for (int32_t column : loaded.col_index_) {
+        if (column < 0 || column >= loaded.blockCols()) {
+            return false;
+        }
+    }
+    *this = std::move(loaded);
+    return true;
+}
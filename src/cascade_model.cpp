@@ -0,0 +1,245 @@
+#include "../include/cascade_model.h"
+#include "../include/binary_metrics.h"
+#include "../include/feature_extractor.h"
+#include "../include/file_io.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+namespace {
+
+// 1 if a score gets the label right at threshold, as BinaryMetrics::accuracy counts it
+int correct(float score, float label, float threshold) {
+    return (score > threshold) == (label > 0.5f) ? 1 : 0;
+}
+
+} // namespace
+
+void CascadeReport::print(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "Cascade band: stage 1 decides below " << band.low << " and above " << band.high << "\n";
+    out << std::setprecision(1) << "Early exits: " << (exit_fraction * 100.0f) << "% of " << samples
+        << " images\n";
+    out << std::setprecision(4) << "Accuracy: " << cascade_accuracy << " with the cascade, "
+        << full_accuracy << " with the full model alone\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+float CascadeCounts::exitFraction() const {
+    uint64_t total = early_exits + full_model;
+    return total > 0 ? static_cast<float>(early_exits) / total : 0.0f;
+}
+
+CascadeModel::CascadeModel() : model_fingerprint_(0) {}
+
+void CascadeModel::fit(const Eigen::MatrixXf& features, const Eigen::VectorXf& labels,
+                       const std::vector<Eigen::Index>& samples, const CascadeOptions& options) {
+    std::vector<int> layer_sizes = {static_cast<int>(features.rows())};
+    layer_sizes.insert(layer_sizes.end(), options.hidden_layers.begin(), options.hidden_layers.end());
+    layer_sizes.push_back(1);
+
+    if (options.training.seed) {
+        network_.setSeed(options.training.seed);
+    }
+    network_.initialize(layer_sizes);
+    network_.train(features, labels, samples, options.training);
+
+    // Nothing is decided early until a band is chosen
+    band_ = CascadeBand();
+    model_fingerprint_ = 0;
+}
+
+Eigen::VectorXf CascadeModel::predictBatch(const Eigen::MatrixXf& features) const {
+    return network_.predictBatch(features);
+}
+
+float CascadeModel::predict(const Eigen::VectorXf& features) const {
+    return network_.predictBatch(features)(0);
+}
+
+CascadeReport CascadeModel::measure(const CascadeBand& band, const Eigen::VectorXf& stage_scores,
+                                    const Eigen::VectorXf& full_scores, const Eigen::VectorXf& labels,
+                                    float threshold) {
+    CascadeReport report;
+    report.band = band;
+    report.samples = static_cast<size_t>(labels.size());
+    if (labels.size() == 0) {
+        return report;
+    }
+
+    Eigen::VectorXf cascade_scores = full_scores;
+    Eigen::Index exits = 0;
+    for (Eigen::Index i = 0; i < stage_scores.size(); ++i) {
+        if (band.decides(stage_scores(i))) {
+            cascade_scores(i) = stage_scores(i);
+            ++exits;
+        }
+    }
+    report.exit_fraction = static_cast<float>(exits) / labels.size();
+    report.full_accuracy = BinaryMetrics::accuracy(full_scores, labels, threshold);
+    report.cascade_accuracy = BinaryMetrics::accuracy(cascade_scores, labels, threshold);
+    return report;
+}
+
+CascadeReport CascadeModel::chooseBand(const Eigen::VectorXf& stage_scores, const Eigen::VectorXf& full_scores,
+                                       const Eigen::VectorXf& labels, float max_accuracy_loss, float threshold) {
+    const Eigen::Index n = labels.size();
+    if (n == 0) {
+        return measure(CascadeBand(), stage_scores, full_scores, labels, threshold);
+    }
+
+    // In stage-score order the exits of a band are a prefix (below low, all
+    // called real) and a suffix (above high, all called AI). gained[k] is the
+    // change in correct answers from letting stage 1 decide the first k.
+    std::vector<Eigen::Index> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&stage_scores](Eigen::Index a, Eigen::Index b) {
+        return stage_scores(a) < stage_scores(b);
+    });
+    std::vector<float> sorted(n);
+    std::vector<int> gained(n + 1, 0);
+    for (Eigen::Index k = 0; k < n; ++k) {
+        Eigen::Index i = order[k];
+        sorted[k] = stage_scores(i);
+        gained[k + 1] = gained[k] + correct(stage_scores(i), labels(i), threshold) -
+                        correct(full_scores(i), labels(i), threshold);
+    }
+
+    // Most exits within the allowed loss; among equals the fewest mistakes
+    const int allowed = static_cast<int>(std::floor(std::max(max_accuracy_loss, 0.0f) * n + 1e-4f));
+    const int steps = static_cast<int>(std::lround(1.0f / BAND_STEP));
+    const int threshold_step = std::min(std::max(static_cast<int>(std::lround(threshold / BAND_STEP)), 0), steps);
+    CascadeBand best;
+    Eigen::Index best_exits = 0;
+    int best_gain = 0;
+    for (int l = 0; l <= threshold_step; ++l) {
+        const float low = std::min(l * BAND_STEP, threshold);
+        const Eigen::Index below = std::lower_bound(sorted.begin(), sorted.end(), low) - sorted.begin();
+        for (int h = threshold_step; h <= steps; ++h) {
+            const float high = std::max(h * BAND_STEP, threshold);
+            const Eigen::Index above = std::upper_bound(sorted.begin(), sorted.end(), high) - sorted.begin();
+            const Eigen::Index exits = below + (n - above);
+            const int gain = gained[below] + gained[n] - gained[above];
+            if (gain < -allowed) {
+                continue;
+            }
+            if (exits > best_exits || (exits == best_exits && gain > best_gain)) {
+                best = {low, high};
+                best_exits = exits;
+                best_gain = gain;
+            }
+        }
+    }
+    return measure(best, stage_scores, full_scores, labels, threshold);
+}
+
+void CascadeModel::setBand(const CascadeBand& band, uint64_t model_fingerprint) {
+    band_ = band;
+    model_fingerprint_ = model_fingerprint;
+}
+
+uint64_t CascadeModel::fingerprint() const {
+    std::ostringstream out(std::ios::binary);
+    put(out, network_.fingerprint());
+    put(out, band_.low);
+    put(out, band_.high);
+    std::string data = out.str();
+    return fnv1a(data.data(), data.size());
+}
+
+bool CascadeModel::save(const std::string& path) const {
+    if (network_.layerCount() == 0) {
+        std::cerr << "Cascade stage 1 is not trained" << std::endl;
+        return false;
+    }
+
+    std::ostringstream out(std::ios::binary);
+    out.write(MAGIC, sizeof(MAGIC));
+    put(out, VERSION);
+    put(out, model_fingerprint_);
+    put(out, band_.low);
+    put(out, band_.high);
+
+    // Stage 1 is never pruned, so every layer is stored dense
+    put(out, static_cast<uint32_t>(network_.layerCount()));
+    put(out, static_cast<int32_t>(network_.inputSize()));
+    for (size_t i = 0; i < network_.layerCount(); ++i) {
+        put(out, static_cast<int32_t>(network_.layerWeights(i).rows()));
+    }
+    for (size_t i = 0; i < network_.layerCount(); ++i) {
+        const Eigen::MatrixXf& weights = network_.layerWeights(i);
+        const Eigen::VectorXf& biases = network_.layerBiases(i);
+        out.write(reinterpret_cast<const char*>(weights.data()), sizeof(float) * weights.size());
+        out.write(reinterpret_cast<const char*>(biases.data()), sizeof(float) * biases.size());
+    }
+
+    return writeSnapshot(path, out.str(), "cascade");
+}
+
+bool CascadeModel::load(const std::string& path) {
+    std::string data;
+    SnapshotStatus status = readSnapshot(path, data);
+    if (status == SnapshotStatus::Missing) {
+        std::cerr << "Cannot open cascade: " << path << std::endl;
+        return false;
+    }
+
+    std::istringstream in(data, std::ios::binary);
+    char magic[4];
+    uint32_t version = 0, layers = 0;
+    uint64_t model_fingerprint = 0;
+    CascadeBand band;
+    if (status != SnapshotStatus::Ok ||
+        !in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !get(in, version) || version != VERSION || !get(in, model_fingerprint) ||
+        !get(in, band.low) || !get(in, band.high) || !get(in, layers) ||
+        layers == 0 || layers > MAX_LAYERS) {
+        std::cerr << "Damaged cascade: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<int> layer_sizes(layers + 1);
+    for (auto& size : layer_sizes) {
+        int32_t value = 0;
+        if (!get(in, value) || value <= 0 || value > (1 << 16)) {
+            std::cerr << "Damaged cascade: " << path << std::endl;
+            return false;
+        }
+        size = value;
+    }
+    // Stage 1 scores cascade features and gives one score
+    if (layer_sizes.front() != FeatureExtractor::CASCADE_FEATURES || layer_sizes.back() != 1) {
+        std::cerr << "Cascade expects " << layer_sizes.front() << " features and gives "
+                  << layer_sizes.back() << " scores, not " << FeatureExtractor::CASCADE_FEATURES
+                  << " and 1: " << path << std::endl;
+        return false;
+    }
+    std::vector<std::vector<float>> weights(layers), biases(layers);
+    for (uint32_t i = 0; i < layers; ++i) {
+        weights[i].resize(static_cast<size_t>(layer_sizes[i + 1]) * layer_sizes[i]);
+        biases[i].resize(layer_sizes[i + 1]);
+        in.read(reinterpret_cast<char*>(weights[i].data()), sizeof(float) * weights[i].size());
+        in.read(reinterpret_cast<char*>(biases[i].data()), sizeof(float) * biases[i].size());
+    }
+    if (!in) {
+        std::cerr << "Damaged cascade: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<const float*> weight_data, bias_data;
+    for (uint32_t i = 0; i < layers; ++i) {
+        weight_data.push_back(weights[i].data());
+        bias_data.push_back(biases[i].data());
+    }
+    network_.loadParameters(layer_sizes, weight_data.data(), bias_data.data(), nullptr);
+    band_ = band;
+    model_fingerprint_ = model_fingerprint;
+    return true;
+}
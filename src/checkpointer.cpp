@@ -0,0 +1,174 @@
+#include "../include/checkpointer.h"
+#include "../include/file_io.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+Checkpointer::Checkpointer(const std::string& directory, int keep)
+    : directory_(directory), keep_(std::max(1, keep)),
+      has_staged_(false), writing_busy_(false), stopping_(false) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Cannot create checkpoint directory: " << directory << std::endl;
+    }
+    writer_ = std::thread([this]() { writerLoop(); });
+}
+
+Checkpointer::~Checkpointer() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    writer_.join();
+}
+
+void Checkpointer::submit(const std::function<void(TrainingCheckpoint&)>& fill) {
+    {
+        // Filling in place reuses the staged buffers when the shapes match
+        std::lock_guard<std::mutex> lock(mutex_);
+        fill(staged_);
+        has_staged_ = true;
+    }
+    wake_.notify_one();
+}
+
+void Checkpointer::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return !has_staged_ && !writing_busy_; });
+}
+
+void Checkpointer::writerLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stopping_ || has_staged_; });
+            if (!has_staged_) {
+                return;
+            }
+            std::swap(staged_, writing_);
+            has_staged_ = false;
+            writing_busy_ = true;
+        }
+
+        if (write(writing_)) {
+            removeOld();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            writing_busy_ = false;
+        }
+        idle_.notify_all();
+    }
+}
+
+bool Checkpointer::write(const TrainingCheckpoint& checkpoint) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "checkpoint-%012llu.ckpt", static_cast<unsigned long long>(checkpoint.step));
+    std::filesystem::path path = std::filesystem::path(directory_) / name;
+    return writeSnapshot(path.string(), serialize(checkpoint), "checkpoint");
+}
+
+void Checkpointer::removeOld() {
+    std::vector<std::string> checkpoints = listCheckpoints(directory_);
+    for (size_t i = static_cast<size_t>(keep_); i < checkpoints.size(); ++i) {
+        std::error_code error;
+        std::filesystem::remove(checkpoints[i], error);
+    }
+}
+
+std::vector<std::string> Checkpointer::listCheckpoints(const std::string& directory) {
+    // Zero-padded step numbers sort by name; newest first
+    std::vector<std::string> checkpoints;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() == ".ckpt") {
+            checkpoints.push_back(entry.path().string());
+        }
+    }
+    std::sort(checkpoints.rbegin(), checkpoints.rend());
+    return checkpoints;
+}
+
+bool Checkpointer::loadLatest(const std::string& directory, TrainingCheckpoint& checkpoint) {
+    for (const auto& path : listCheckpoints(directory)) {
+        std::string data;
+        if (readSnapshot(path, data) == SnapshotStatus::Ok && deserialize(data, checkpoint)) {
+            std::cout << "Resuming from checkpoint: " << path << std::endl;
+            return true;
+        }
+        std::cerr << "Skipping damaged checkpoint: " << path << std::endl;
+    }
+    return false;
+}
+
+std::string Checkpointer::serialize(const TrainingCheckpoint& checkpoint) {
+    std::ostringstream out(std::ios::binary);
+    out.write(MAGIC, sizeof(MAGIC));
+    put(out, VERSION);
+    put(out, checkpoint.learning_rate);
+    put(out, checkpoint.step);
+    put(out, static_cast<int32_t>(checkpoint.epoch));
+    put(out, checkpoint.batch);
+    put(out, checkpoint.batch_size);
+    putString(out, checkpoint.network_rng);
+    putString(out, checkpoint.reader_rng);
+
+    put(out, static_cast<uint64_t>(checkpoint.layer_sizes.size()));
+    for (int size : checkpoint.layer_sizes) {
+        put(out, static_cast<int32_t>(size));
+    }
+    for (size_t i = 0; i < checkpoint.weights.size(); ++i) {
+        out.write(reinterpret_cast<const char*>(checkpoint.weights[i].data()),
+                  checkpoint.weights[i].size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(checkpoint.biases[i].data()),
+                  checkpoint.biases[i].size() * sizeof(float));
+    }
+    return out.str();
+}
+
+bool Checkpointer::deserialize(const std::string& data, TrainingCheckpoint& checkpoint) {
+    std::istringstream in(data, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    uint32_t version = 0;
+    int32_t epoch = 0;
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !get(in, version) || version > VERSION) {
+        return false;
+    }
+    if (!get(in, checkpoint.learning_rate) || !get(in, checkpoint.step) || !get(in, epoch) ||
+        !get(in, checkpoint.batch) || !get(in, checkpoint.batch_size) ||
+        !getString(in, checkpoint.network_rng, MAX_RNG_STATE) || !getString(in, checkpoint.reader_rng, MAX_RNG_STATE)) {
+        return false;
+    }
+    checkpoint.epoch = epoch;
+
+    uint64_t layers = 0;
+    if (!get(in, layers) || layers < 2 || layers > 64) {
+        return false;
+    }
+    checkpoint.layer_sizes.resize(layers);
+    for (auto& size : checkpoint.layer_sizes) {
+        int32_t value = 0;
+        if (!get(in, value) || value <= 0) {
+            return false;
+        }
+        size = value;
+    }
+
+    checkpoint.weights.resize(layers - 1);
+    checkpoint.biases.resize(layers - 1);
+    for (size_t i = 0; i + 1 < layers; ++i) {
+        checkpoint.weights[i].resize(checkpoint.layer_sizes[i + 1], checkpoint.layer_sizes[i]);
+        checkpoint.biases[i].resize(checkpoint.layer_sizes[i + 1]);
+        in.read(reinterpret_cast<char*>(checkpoint.weights[i].data()), checkpoint.weights[i].size() * sizeof(float));
+        in.read(reinterpret_cast<char*>(checkpoint.biases[i].data()), checkpoint.biases[i].size() * sizeof(float));
+    }
+    return static_cast<bool>(in);
+}
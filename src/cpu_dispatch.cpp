@@ -0,0 +1,276 @@
+#include "../include/cpu_dispatch.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_DISPATCH_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPU_DISPATCH_X86 1
+#endif
+
+// One per kernels_<level>.cpp; nullptr when the compiler could not build the level
+const CpuKernels* scalarKernels();
+const CpuKernels* sse42Kernels();
+const CpuKernels* avx2Kernels();
+const CpuKernels* avx512Kernels();
+
+namespace {
+
+#ifdef CPU_DISPATCH_X86
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = static_cast<uint32_t>(values[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switches (XCR0)
+uint64_t enabledRegisterState() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t low, high;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+}
+#endif
+
+CpuLevel probeCpu() {
+#ifdef CPU_DISPATCH_X86
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    const uint32_t max_leaf = regs[0];
+    if (max_leaf < 1) {
+        return CpuLevel::Scalar;
+    }
+
+    cpuid(1, 0, regs);
+    const bool sse42 = regs[2] & (1u << 20);
+    const bool osxsave = regs[2] & (1u << 27);
+    const bool avx = regs[2] & (1u << 28);
+    CpuLevel level = sse42 ? CpuLevel::SSE42 : CpuLevel::Scalar;
+
+    // Wider levels also need the OS to save XMM/YMM (and for AVX-512 the
+    // opmask and ZMM) state
+    if (!sse42 || !osxsave || !avx || max_leaf < 7) {
+        return level;
+    }
+    const uint64_t xcr0 = enabledRegisterState();
+    if ((xcr0 & 0x6) != 0x6) {
+        return level;
+    }
+
+    cpuid(7, 0, regs);
+    const uint32_t features = regs[1];
+    if (features & (1u << 5)) {
+        level = CpuLevel::AVX2;
+    } else {
+        return level;
+    }
+    const uint32_t avx512 = (1u << 16) | (1u << 17) | (1u << 30) | (1u << 31);    // F, DQ, BW, VL
+    if ((features & avx512) == avx512 && (xcr0 & 0xE6) == 0xE6) {
+        level = CpuLevel::AVX512;
+    }
+    return level;
+#else
+    return CpuLevel::Scalar;
+#endif
+}
+
+// Kernels compiled for a level, whether or not the CPU has it
+const CpuKernels* builtKernels(CpuLevel level) {
+    switch (level) {
+        case CpuLevel::Scalar: return scalarKernels();
+        case CpuLevel::SSE42: return sse42Kernels();
+        case CpuLevel::AVX2: return avx2Kernels();
+        case CpuLevel::AVX512: return avx512Kernels();
+    }
+    return nullptr;
+}
+
+const CpuKernels& selectKernels() {
+    CpuLevel level = detectedCpuLevel();
+    CpuLevel limit;
+    const char* value = std::getenv("AI_DETECTOR_CPU");
+    if (value && parseCpuLevel(value, limit) && limit < level) {
+        level = limit;
+    }
+
+    // Highest built level at or below the target; scalar is always built
+    for (int candidate = static_cast<int>(level); candidate > 0; --candidate) {
+        if (const CpuKernels* kernels = builtKernels(static_cast<CpuLevel>(candidate))) {
+            return *kernels;
+        }
+    }
+    return *scalarKernels();
+}
+
+// Compare one kernel's output buffers; reports the first mismatch
+template <typename T>
+bool sameOutput(std::ostream& out, const char* level, const char* kernel, size_t size,
+                const std::vector<T>& reference, const std::vector<T>& result) {
+    if (std::memcmp(reference.data(), result.data(), reference.size() * sizeof(T)) == 0) {
+        return true;
+    }
+    out << level << ": " << kernel << " differs from scalar (size " << size << ")" << std::endl;
+    return false;
+}
+
+// Every kernel of one level against the scalar reference
+bool verifyLevel(std::ostream& out, const CpuKernels& reference, const CpuKernels& kernels) {
+    const char* name = cpuLevelName(kernels.level);
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_real_distribution<float> unit(-0.25f, 1.25f);
+    std::uniform_real_distribution<float> wide(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> weight(-1.0f, 1.0f);
+    bool ok = true;
+
+    // Sizes straddle every vector width and remainder
+    for (size_t size : {0, 1, 3, 7, 16, 63, 64, 65, 257, 1000, 4099}) {
+        std::vector<uint8_t> bytes(2 * size + 4);
+        for (auto& value : bytes) {
+            value = static_cast<uint8_t>(byte(rng));
+        }
+        std::vector<float> values(size);
+        for (auto& value : values) {
+            value = unit(rng);
+        }
+
+        std::vector<uint32_t> expected(256, 0), actual(256, 0);
+        reference.histogram_u8(bytes.data(), size, expected.data());
+        kernels.histogram_u8(bytes.data(), size, actual.data());
+        ok &= sameOutput(out, name, "histogram_u8", size, expected, actual);
+
+        std::fill(expected.begin(), expected.end(), 0);
+        std::fill(actual.begin(), actual.end(), 0);
+        reference.histogram_f32(values.data(), size, 64, expected.data());
+        kernels.histogram_f32(values.data(), size, 64, actual.data());
+        ok &= sameOutput(out, name, "histogram_f32", size, expected, actual);
+
+        std::vector<double> expected_moments(2, 0.0), actual_moments(2, 0.0);
+        reference.moments_f32(values.data(), size, &expected_moments[0], &expected_moments[1]);
+        kernels.moments_f32(values.data(), size, &actual_moments[0], &actual_moments[1]);
+        ok &= sameOutput(out, name, "moments_f32", size, expected_moments, actual_moments);
+
+        // Add a row of pixels 1..size (its neighbours span both byte rows of
+        // size + 2) and take the first half back out, as the incremental
+        // texture path does
+        const uint8_t* above = bytes.data();
+        const uint8_t* row = bytes.data() + size + 2;
+        std::vector<int32_t> expected_counts(4 * 256 * 256, 0), actual_counts(4 * 256 * 256, 0);
+        std::vector<double> expected_sq(4, 0.0), actual_sq(4, 0.0);
+        reference.glcm_row(above, row, 1, size + 1, 1, expected_counts.data(), expected_sq.data());
+        reference.glcm_row(above, row, 1, size / 2 + 1, -1, expected_counts.data(), expected_sq.data());
+        kernels.glcm_row(above, row, 1, size + 1, 1, actual_counts.data(), actual_sq.data());
+        kernels.glcm_row(above, row, 1, size / 2 + 1, -1, actual_counts.data(), actual_sq.data());
+        ok &= sameOutput(out, name, "glcm_row", size, expected_counts, actual_counts);
+        ok &= sameOutput(out, name, "glcm_row sum_sq", size, expected_sq, actual_sq);
+
+        std::vector<float> activations(size);
+        for (auto& value : activations) {
+            value = wide(rng);
+        }
+        std::vector<float> expected_values = activations, actual_values = activations;
+        reference.relu(expected_values.data(), size);
+        kernels.relu(actual_values.data(), size);
+        ok &= sameOutput(out, name, "relu", size, expected_values, actual_values);
+
+        expected_values = activations;
+        actual_values = activations;
+        reference.sigmoid(expected_values.data(), size);
+        kernels.sigmoid(actual_values.data(), size);
+        ok &= sameOutput(out, name, "sigmoid", size, expected_values, actual_values);
+
+        // A layer of size x (size % 37 + 1) inputs
+        const size_t cols = size % 37 + 1;
+        std::vector<float> weights(size * cols), x(cols);
+        for (auto& value : weights) {
+            value = weight(rng);
+        }
+        for (auto& value : x) {
+            value = weight(rng);
+        }
+        expected_values.assign(size, 0.0f);
+        actual_values.assign(size, 0.0f);
+        reference.gemv(weights.data(), size, cols, x.data(), expected_values.data());
+        kernels.gemv(weights.data(), size, cols, x.data(), actual_values.data());
+        ok &= sameOutput(out, name, "gemv", size, expected_values, actual_values);
+    }
+    return ok;
+}
+
+} // namespace
+
+CpuLevel detectedCpuLevel() {
+    static const CpuLevel level = probeCpu();
+    return level;
+}
+
+CpuLevel activeCpuLevel() {
+    return cpuKernels().level;
+}
+
+const CpuKernels& cpuKernels() {
+    static const CpuKernels& kernels = selectKernels();
+    return kernels;
+}
+
+const CpuKernels* kernelsFor(CpuLevel level) {
+    if (level > detectedCpuLevel()) {
+        return nullptr;
+    }
+    return builtKernels(level);
+}
+
+const char* cpuLevelName(CpuLevel level) {
+    switch (level) {
+        case CpuLevel::Scalar: return "scalar";
+        case CpuLevel::SSE42: return "sse4.2";
+        case CpuLevel::AVX2: return "avx2";
+        case CpuLevel::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+bool parseCpuLevel(const std::string& name, CpuLevel& level) {
+    for (CpuLevel candidate : {CpuLevel::Scalar, CpuLevel::SSE42, CpuLevel::AVX2, CpuLevel::AVX512}) {
+        if (name == cpuLevelName(candidate)) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool verifyKernels(std::ostream& out) {
+    const CpuKernels& reference = *scalarKernels();
+    out << "Detected: " << cpuLevelName(detectedCpuLevel())
+        << ", active: " << cpuLevelName(activeCpuLevel()) << std::endl;
+
+    bool ok = true;
+    for (CpuLevel level : {CpuLevel::SSE42, CpuLevel::AVX2, CpuLevel::AVX512}) {
+        const CpuKernels* kernels = kernelsFor(level);
+        if (!kernels) {
+            out << cpuLevelName(level) << ": "
+                << (level > detectedCpuLevel() ? "not supported by this CPU" : "not built")
+                << std::endl;
+            continue;
+        }
+        bool level_ok = verifyLevel(out, reference, *kernels);
+        out << cpuLevelName(level) << ": " << (level_ok ? "matches scalar" : "MISMATCH") << std::endl;
+        ok &= level_ok;
+    }
+    return ok;
+}
@@ -0,0 +1,519 @@
+#include "../include/feature_dataset.h"
+#include "../include/file_io.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        mapping_ = nullptr;
+        LARGE_INTEGER size;
+        if (file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+            return;
+        }
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_) {
+            data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+            size_ = data_ ? static_cast<size_t>(size.QuadPart) : 0;
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                // Shards are decoded front to back exactly once
+                madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+                data_ = static_cast<const unsigned char*>(mapped);
+                size_ = static_cast<size_t>(info.st_size);
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+#else
+        if (data_) {
+            munmap(const_cast<unsigned char*>(data_), size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const unsigned char* data_;
+    size_t size_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+};
+
+// Fixed fields at the start of a shard; the rest of the header is zero
+struct ShardHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t encoding;
+    uint32_t features;
+    uint64_t samples;
+};
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t bytesPerValue(FeatureEncoding encoding) {
+    switch (encoding) {
+        case FeatureEncoding::F16: return sizeof(Eigen::half);
+        case FeatureEncoding::I8: return sizeof(int8_t);
+        default: return sizeof(float);
+    }
+}
+
+} // namespace
+
+bool FeatureDataset::isDataset(const std::string& directory) {
+    return std::filesystem::is_regular_file(std::filesystem::path(directory) / MANIFEST_NAME);
+}
+
+bool FeatureDataset::open(const std::string& directory) {
+    std::ifstream manifest(std::filesystem::path(directory) / MANIFEST_NAME);
+    if (!manifest.is_open()) {
+        std::cerr << "Not a feature dataset: " << directory << std::endl;
+        return false;
+    }
+
+    directory_ = directory;
+    features_ = 0;
+    samples_ = 0;
+    shards_.clear();
+
+    std::string line;
+    int version = 0;
+    if (!std::getline(manifest, line) || std::sscanf(line.c_str(), "AIDF-DATASET %d", &version) != 1 ||
+        version < 1 || version > static_cast<int>(FORMAT_VERSION)) {
+        std::cerr << "Unsupported dataset manifest in " << directory << std::endl;
+        return false;
+    }
+
+    while (std::getline(manifest, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "features") {
+            fields >> features_;
+        } else if (key == "encoding") {
+            std::string name;
+            fields >> name;
+            if (!parseEncoding(name, encoding_)) {
+                std::cerr << "Unknown feature encoding: " << name << std::endl;
+                return false;
+            }
+        } else if (key == "shard") {
+            ShardInfo info;
+            std::string name;
+            fields >> name >> info.samples;
+            info.path = (std::filesystem::path(directory) / name).string();
+            info.first_sample = samples_;
+            samples_ += info.samples;
+            shards_.push_back(info);
+        }
+    }
+
+    if (features_ == 0) {
+        std::cerr << "Dataset manifest has no feature count: " << directory << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FeatureDataset::loadShard(size_t index, FeatureShard& shard) const {
+    const ShardInfo& info = shards_[index];
+    MappedFile file(info.path);
+    if (!file.data() || file.size() < HEADER_SIZE) {
+        std::cerr << "Cannot map shard: " << info.path << std::endl;
+        return false;
+    }
+
+    ShardHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SHARD_MAGIC, sizeof(SHARD_MAGIC)) != 0 || header.version > FORMAT_VERSION ||
+        header.encoding != static_cast<uint32_t>(encoding_) || header.features != features_ ||
+        header.samples != info.samples) {
+        std::cerr << "Shard does not match its manifest: " << info.path << std::endl;
+        return false;
+    }
+
+    const Eigen::Index rows = static_cast<Eigen::Index>(features_);
+    const Eigen::Index cols = static_cast<Eigen::Index>(info.samples);
+    size_t offset = HEADER_SIZE;
+    size_t labels_offset = offset;
+    offset += info.samples * sizeof(float);
+    size_t quantization_offset = offset;
+    if (encoding_ == FeatureEncoding::I8) {
+        offset += 2 * features_ * sizeof(float);
+    }
+    size_t data_offset = alignUp(offset, DATA_ALIGNMENT);
+    if (file.size() < data_offset + features_ * info.samples * bytesPerValue(encoding_)) {
+        std::cerr << "Truncated shard: " << info.path << std::endl;
+        return false;
+    }
+
+    const unsigned char* data = file.data() + data_offset;
+    shard.labels.resize(cols);
+    std::memcpy(shard.labels.data(), file.data() + labels_offset, info.samples * sizeof(float));
+
+    switch (encoding_) {
+        case FeatureEncoding::F32:
+            shard.features = Eigen::Map<const Eigen::MatrixXf>(reinterpret_cast<const float*>(data), rows, cols);
+            break;
+        case FeatureEncoding::F16:
+            shard.features = Eigen::Map<const Eigen::Matrix<Eigen::half, Eigen::Dynamic, Eigen::Dynamic>>(
+                reinterpret_cast<const Eigen::half*>(data), rows, cols).cast<float>();
+            break;
+        case FeatureEncoding::I8: {
+            Eigen::VectorXf scale(rows);
+            Eigen::VectorXf minimum(rows);
+            std::memcpy(scale.data(), file.data() + quantization_offset, features_ * sizeof(float));
+            std::memcpy(minimum.data(), file.data() + quantization_offset + features_ * sizeof(float),
+                        features_ * sizeof(float));
+            auto codes = Eigen::Map<const Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic>>(
+                reinterpret_cast<const int8_t*>(data), rows, cols).cast<float>().array() + 128.0f;
+            shard.features = ((codes.colwise() * scale.array()).colwise() + minimum.array()).matrix();
+            break;
+        }
+    }
+    return true;
+}
+
+bool FeatureDataset::loadAll(FeatureShard& all) const {
+    all.features.resize(features_, samples_);
+    all.labels.resize(samples_);
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        FeatureShard shard;
+        if (!loadShard(i, shard)) {
+            return false;
+        }
+        all.features.middleCols(shards_[i].first_sample, shards_[i].samples) = shard.features;
+        all.labels.segment(shards_[i].first_sample, shards_[i].samples) = shard.labels;
+    }
+    return true;
+}
+
+bool FeatureDataset::parseEncoding(const std::string& name, FeatureEncoding& encoding) {
+    if (name == "f32") {
+        encoding = FeatureEncoding::F32;
+    } else if (name == "f16") {
+        encoding = FeatureEncoding::F16;
+    } else if (name == "i8") {
+        encoding = FeatureEncoding::I8;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* FeatureDataset::encodingName(FeatureEncoding encoding) {
+    switch (encoding) {
+        case FeatureEncoding::F16: return "f16";
+        case FeatureEncoding::I8: return "i8";
+        default: return "f32";
+    }
+}
+
+FeatureDatasetWriter::FeatureDatasetWriter(const std::string& directory, size_t features,
+                                           FeatureEncoding encoding, size_t samples_per_shard)
+    : samples_per_shard_(std::max<size_t>(1, samples_per_shard)),
+      buffer_(features, std::max<size_t>(1, samples_per_shard)),
+      labels_(std::max<size_t>(1, samples_per_shard)),
+      pending_(0), failed_(false) {
+    dataset_.directory_ = directory;
+    dataset_.features_ = features;
+    dataset_.encoding_ = encoding;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Cannot create dataset directory: " << directory << std::endl;
+        failed_ = true;
+        return;
+    }
+
+    // A rebuild overwrites shards in place; the old manifest must not stay readable meanwhile
+    std::filesystem::remove(std::filesystem::path(directory) / FeatureDataset::MANIFEST_NAME, error);
+    if (error) {
+        std::cerr << "Cannot remove old dataset manifest in: " << directory << std::endl;
+        failed_ = true;
+    }
+}
+
+bool FeatureDatasetWriter::add(const Eigen::VectorXf& features, float label) {
+    if (failed_ || features.size() != buffer_.rows()) {
+        return false;
+    }
+    buffer_.col(pending_) = features;
+    labels_(pending_) = label;
+    if (++pending_ == samples_per_shard_) {
+        return writeShard();
+    }
+    return true;
+}
+
+bool FeatureDatasetWriter::writeShard() {
+    char name[32];
+    std::snprintf(name, sizeof(name), "shard-%05zu.aidf", dataset_.shards_.size());
+    std::filesystem::path path = std::filesystem::path(dataset_.directory_) / name;
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Cannot write shard: " << path.string() << std::endl;
+        failed_ = true;
+        return false;
+    }
+
+    const size_t features = dataset_.features_;
+    const Eigen::Index count = static_cast<Eigen::Index>(pending_);
+    auto samples = buffer_.leftCols(count);
+
+    ShardHeader header = {};
+    std::memcpy(header.magic, FeatureDataset::SHARD_MAGIC, sizeof(header.magic));
+    header.version = FeatureDataset::FORMAT_VERSION;
+    header.encoding = static_cast<uint32_t>(dataset_.encoding_);
+    header.features = static_cast<uint32_t>(features);
+    header.samples = pending_;
+    std::vector<char> head(FeatureDataset::HEADER_SIZE, 0);
+    std::memcpy(head.data(), &header, sizeof(header));
+    file.write(head.data(), head.size());
+    file.write(reinterpret_cast<const char*>(labels_.data()), pending_ * sizeof(float));
+    size_t offset = FeatureDataset::HEADER_SIZE + pending_ * sizeof(float);
+
+    // Per-feature affine quantization: the shard's range of each feature maps onto 256 codes
+    Eigen::VectorXf minimum;
+    Eigen::VectorXf scale;
+    if (dataset_.encoding_ == FeatureEncoding::I8) {
+        minimum = samples.rowwise().minCoeff();
+        scale = (samples.rowwise().maxCoeff() - minimum) / 255.0f;
+        scale = (scale.array() > 0.0f).select(scale, 1.0f);
+        file.write(reinterpret_cast<const char*>(scale.data()), features * sizeof(float));
+        file.write(reinterpret_cast<const char*>(minimum.data()), features * sizeof(float));
+        offset += 2 * features * sizeof(float);
+    }
+
+    std::vector<char> padding(alignUp(offset, FeatureDataset::DATA_ALIGNMENT) - offset, 0);
+    file.write(padding.data(), padding.size());
+
+    switch (dataset_.encoding_) {
+        case FeatureEncoding::F32:
+            file.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(float));
+            break;
+        case FeatureEncoding::F16: {
+            Eigen::Matrix<Eigen::half, Eigen::Dynamic, Eigen::Dynamic> values = samples.cast<Eigen::half>();
+            file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(Eigen::half));
+            break;
+        }
+        case FeatureEncoding::I8: {
+            Eigen::MatrixXf levels = ((samples.array().colwise() - minimum.array()).colwise() / scale.array()).round();
+            Eigen::Matrix<int8_t, Eigen::Dynamic, Eigen::Dynamic> codes =
+                (levels.array().max(0.0f).min(255.0f) - 128.0f).cast<int8_t>();
+            file.write(reinterpret_cast<const char*>(codes.data()), codes.size());
+            break;
+        }
+    }
+
+    if (!file) {
+        std::cerr << "Failed writing shard: " << path.string() << std::endl;
+        failed_ = true;
+        return false;
+    }
+
+    dataset_.shards_.push_back({path.string(), pending_, dataset_.samples_});
+    dataset_.samples_ += pending_;
+    pending_ = 0;
+    return true;
+}
+
+bool FeatureDatasetWriter::finish() {
+    if (pending_ > 0 && !writeShard()) {
+        return false;
+    }
+    if (failed_) {
+        return false;
+    }
+
+    // Manifest last and atomically, so a dataset only becomes readable once complete
+    std::filesystem::path path = std::filesystem::path(dataset_.directory_) / FeatureDataset::MANIFEST_NAME;
+    std::ostringstream manifest;
+    manifest << "AIDF-DATASET " << FeatureDataset::FORMAT_VERSION << "\n";
+    manifest << "features " << dataset_.features_ << "\n";
+    manifest << "encoding " << FeatureDataset::encodingName(dataset_.encoding_) << "\n";
+    manifest << "samples " << dataset_.samples_ << "\n";
+    for (const auto& shard : dataset_.shards_) {
+        manifest << "shard " << std::filesystem::path(shard.path).filename().string() << " " << shard.samples << "\n";
+    }
+    if (!writeAtomically(path.string(), manifest.str())) {
+        std::cerr << "Cannot write dataset manifest: " << path.string() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+DatasetReader::DatasetReader(const FeatureDataset& dataset, size_t shuffle_buffer, uint32_t seed)
+    : dataset_(dataset), rng_(seed ? seed : std::random_device{}()), next_shard_(0), cursor_(0), failed_(false), filled_(0) {
+    size_t capacity = std::max<size_t>(1, std::min(shuffle_buffer, dataset.sampleCount()));
+    buffer_.resize(dataset.featureCount(), capacity);
+    buffer_labels_.resize(capacity);
+}
+
+DatasetReader::~DatasetReader() {
+    if (pending_.valid()) {
+        pending_.wait();
+    }
+}
+
+void DatasetReader::startEpoch() {
+    if (pending_.valid()) {
+        pending_.wait();
+        pending_ = std::future<bool>();
+    }
+
+    order_.resize(dataset_.shardCount());
+    std::iota(order_.begin(), order_.end(), 0);
+    std::shuffle(order_.begin(), order_.end(), rng_);
+    next_shard_ = 0;
+    current_ = FeatureShard();
+    cursor_ = 0;
+    filled_ = 0;
+    prefetch();
+}
+
+std::string DatasetReader::rngState() const {
+    std::ostringstream state;
+    state << rng_;
+    return state.str();
+}
+
+bool DatasetReader::setRngState(const std::string& state) {
+    std::istringstream in(state);
+    std::mt19937 rng;
+    if (!(in >> rng)) {
+        return false;
+    }
+    rng_ = rng;
+    return true;
+}
+
+void DatasetReader::prefetch() {
+    if (next_shard_ >= order_.size()) {
+        return;
+    }
+    size_t index = order_[next_shard_++];
+    const FeatureDataset* dataset = &dataset_;
+    pending_ = std::async(std::launch::async, [dataset, index, &shard = prefetched_]() {
+        return dataset->loadShard(index, shard);
+    });
+}
+
+bool DatasetReader::advanceShard() {
+    // Take the prefetched shard and start decoding the one after it; a shard
+    // that fails to load stops the epoch rather than training on the rest
+    while (pending_.valid()) {
+        if (!pending_.get()) {
+            failed_ = true;
+            return false;
+        }
+        current_ = std::move(prefetched_);
+        cursor_ = 0;
+        prefetch();
+        if (current_.labels.size() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DatasetReader::nextSample(Eigen::Ref<Eigen::VectorXf> features, float& label) {
+    if (cursor_ >= static_cast<size_t>(current_.labels.size()) && !advanceShard()) {
+        return false;
+    }
+    features = current_.features.col(cursor_);
+    label = current_.labels(cursor_);
+    ++cursor_;
+    return true;
+}
+
+size_t DatasetReader::nextBatch(size_t batch_size, Eigen::MatrixXf& inputs, Eigen::VectorXf& targets) {
+    const size_t capacity = static_cast<size_t>(buffer_.cols());
+    while (filled_ < capacity && nextSample(buffer_.col(filled_), buffer_labels_(filled_))) {
+        ++filled_;
+    }
+    if (failed_) {
+        return 0;
+    }
+
+    if (inputs.rows() != buffer_.rows() || inputs.cols() != static_cast<Eigen::Index>(batch_size)) {
+        inputs.resize(buffer_.rows(), batch_size);
+        targets.resize(batch_size);
+    }
+
+    size_t count = 0;
+    while (count < batch_size && filled_ > 0) {
+        size_t slot = std::uniform_int_distribution<size_t>(0, filled_ - 1)(rng_);
+        inputs.col(count) = buffer_.col(slot);
+        targets(count) = buffer_labels_(slot);
+        ++count;
+
+        // Refill the slot from the stream; once it is drained, close the gap instead
+        if (!nextSample(buffer_.col(slot), buffer_labels_(slot))) {
+            --filled_;
+            buffer_.col(slot) = buffer_.col(filled_);
+            buffer_labels_(slot) = buffer_labels_(filled_);
+        }
+    }
+
+    if (count < batch_size) {
+        inputs.conservativeResize(Eigen::NoChange, count);
+        targets.conservativeResize(count);
+    }
+    return count;
+}
@@ -1,20 +1,110 @@
 #include "../include/feature_extractor.h"
+#include "../include/cpu_dispatch.h"
+#include "../include/profiler.h"
+#include "../include/scratch_arena.h"
 #include <opencv2/imgproc.hpp>
 #include <opencv2/core/eigen.hpp>
 #include <cmath>
 #include <algorithm>
+#include <chrono>
+#include <functional>
 
-FeatureExtractor::FeatureExtractor() = default;
+namespace {
+
+// Mean and standard deviation of a single-channel image, as cv::meanStdDev;
+// float images go through the dispatched moments kernel
+void channelMoments(const cv::Mat& image, double& mean, double& stddev) {
+    if (image.depth() != CV_32F || image.channels() != 1) {
+        cv::Scalar m, s;
+        cv::meanStdDev(image, m, s);
+        mean = m[0];
+        stddev = s[0];
+        return;
+    }
+    
+    double sum = 0.0, sum_sq = 0.0;
+    for (int y = 0; y < image.rows; ++y) {
+        cpuKernels().moments_f32(image.ptr<float>(y), image.cols, &sum, &sum_sq);
+    }
+    const double pixels = static_cast<double>(image.total());
+    mean = pixels > 0.0 ? sum / pixels : 0.0;
+    stddev = pixels > 0.0 ? std::sqrt(std::max(sum_sq / pixels - mean * mean, 0.0)) : 0.0;
+}
+
+} // namespace
+
+FeatureExtractor::FeatureExtractor() : thread_pool_(nullptr) {
+    // Starting estimates at INPUT_SIZE; measured costs replace them quickly
+    const float initial_cost_ms[FAMILY_COUNT] = {1.0f, 2.0f, 3.0f, 3.0f, 1.0f, 8.0f};
+    for (int family = 0; family < FAMILY_COUNT; ++family) {
+        family_cost_ms_[family] = initial_cost_ms[family];
+    }
+}
 
 Eigen::VectorXf FeatureExtractor::extractFeatures(const cv::Mat& image) {
+    // All intermediate images are scratch; only the feature vector survives
+    ScratchScope scope;
+    return extractFamilies(preprocessImage(image), nullptr);
+}
+
+Eigen::VectorXf FeatureExtractor::extractCascadeFeatures(const cv::Mat& image) {
+    ScratchScope scope;
     cv::Mat processed = preprocessImage(image);
-    
+    Eigen::VectorXf features(CASCADE_FEATURES);
+    features.head(STATISTICAL_FEATURES) = extractStatisticalFeatures(processed);
+    features.tail(COLOR_FEATURES) = extractColorFeatures(processed);
+    return features;
+}
+
+Eigen::VectorXf FeatureExtractor::completeFeatures(const cv::Mat& image, const Eigen::VectorXf& cascade_features) {
+    ScratchScope scope;
+    return extractFamilies(preprocessImage(image), &cascade_features);
+}
+
+Eigen::MatrixXf FeatureExtractor::cascadeFeatures(const Eigen::MatrixXf& features) {
+    Eigen::MatrixXf cascade(CASCADE_FEATURES, features.cols());
+    cascade << features.topRows(STATISTICAL_FEATURES), features.bottomRows(COLOR_FEATURES);
+    return cascade;
+}
+
+Eigen::VectorXf FeatureExtractor::extractFamilies(const cv::Mat& processed, const Eigen::VectorXf* cascade_features) {
     // Combine all feature types
-    Eigen::VectorXf statistical = extractStatisticalFeatures(processed);
-    Eigen::VectorXf frequency = extractFrequencyFeatures(processed);
-    Eigen::VectorXf texture = extractTextureFeatures(processed);
-    Eigen::VectorXf noise = extractNoiseFeatures(processed);
-    Eigen::VectorXf color = extractColorFeatures(processed);
+    Eigen::VectorXf statistical, frequency, texture, noise, color;
+    if (cascade_features) {
+        statistical = cascade_features->head(STATISTICAL_FEATURES);
+        color = cascade_features->tail(COLOR_FEATURES);
+    }
+    if (thread_pool_ && thread_pool_->size() > 1) {
+        // Families are independent: four run as tasks, the cheapest one here
+        using Family = Eigen::VectorXf (FeatureExtractor::*)(const cv::Mat&);
+        auto spawn = [this, &processed](Family family) {
+            return thread_pool_->submit([this, &processed, family]() {
+                ScratchScope task_scope;
+                return (this->*family)(processed);
+            });
+        };
+        auto frequency_task = spawn(&FeatureExtractor::extractFrequencyFeatures);
+        auto texture_task = spawn(&FeatureExtractor::extractTextureFeatures);
+        auto noise_task = spawn(&FeatureExtractor::extractNoiseFeatures);
+        if (!cascade_features) {
+            auto color_task = spawn(&FeatureExtractor::extractColorFeatures);
+            statistical = extractStatisticalFeatures(processed);
+            color = thread_pool_->wait(color_task);
+        }
+        frequency = thread_pool_->wait(frequency_task);
+        texture = thread_pool_->wait(texture_task);
+        noise = thread_pool_->wait(noise_task);
+    } else {
+        if (!cascade_features) {
+            statistical = extractStatisticalFeatures(processed);
+        }
+        frequency = extractFrequencyFeatures(processed);
+        texture = extractTextureFeatures(processed);
+        noise = extractNoiseFeatures(processed);
+        if (!cascade_features) {
+            color = extractColorFeatures(processed);
+        }
+    }
     
     // Concatenate all features
     Eigen::VectorXf combined(FEATURE_SIZE);
@@ -42,7 +132,351 @@ Eigen::VectorXf FeatureExtractor::extractFeatures(const cv::Mat& image) {
     return combined;
 }
 
+Eigen::VectorXf FeatureExtractor::extractFeatures(const cv::Mat& image, const Deadline& deadline,
+                                                  const Eigen::VectorXf& defaults, QualityReport& report,
+                                                  const Eigen::VectorXf* cascade_features) {
+    if (!deadline.limited()) {
+        return cascade_features ? completeFeatures(image, *cascade_features) : extractFeatures(image);
+    }
+    
+    ScratchScope scope;
+    cv::Mat processed = preprocessImage(image);
+    
+    // Plan against the time left, cheapest and most telling families first.
+    // Costs are charged as if the families ran one after another, which
+    // leaves headroom when they run in parallel.
+    double budget = deadline.remainingMs();
+    auto fits = [this, &budget](Family family) {
+        double cost = family_cost_ms_[family].load(std::memory_order_relaxed);
+        if (cost > budget) {
+            return false;
+        }
+        budget -= cost;
+        return true;
+    };
+    if (!cascade_features) {
+        budget -= family_cost_ms_[STATISTICAL].load(std::memory_order_relaxed) +
+                  family_cost_ms_[COLOR].load(std::memory_order_relaxed);
+    }
+    bool run_noise = fits(NOISE);
+    Family frequency_family = fits(FREQUENCY) ? FREQUENCY : (fits(FREQUENCY_REDUCED) ? FREQUENCY_REDUCED : FAMILY_COUNT);
+    bool run_texture = fits(TEXTURE);
+    
+    // Run the planned families, timing each to refine its estimate
+    struct Job {
+        Family family;
+        int offset;
+        std::function<Eigen::VectorXf()> extract;
+        Eigen::VectorXf features;
+    };
+    std::vector<Job> jobs;
+    if (!cascade_features) {
+        jobs.push_back({STATISTICAL, 0, [this, &processed]() { return extractStatisticalFeatures(processed); }, {}});
+        jobs.push_back({COLOR, 448, [this, &processed]() { return extractColorFeatures(processed); }, {}});
+    }
+    if (run_noise) {
+        jobs.push_back({NOISE, 320, [this, &processed]() { return extractNoiseFeatures(processed); }, {}});
+    }
+    if (frequency_family != FAMILY_COUNT) {
+        int fft_size = frequency_family == FREQUENCY ? FFT_SIZE : FFT_SIZE / 2;
+        jobs.push_back({frequency_family, 64, [this, &processed, fft_size]() {
+            return frequencyFeatures(processed, fft_size);
+        }, {}});
+    }
+    if (run_texture) {
+        jobs.push_back({TEXTURE, 192, [this, &processed]() { return extractTextureFeatures(processed); }, {}});
+    }
+    
+    auto run = [this](Job& job) {
+        auto start = std::chrono::steady_clock::now();
+        job.features = job.extract();
+        float cost = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        float estimate = family_cost_ms_[job.family].load(std::memory_order_relaxed);
+        family_cost_ms_[job.family].store(estimate + COST_SMOOTHING * (cost - estimate), std::memory_order_relaxed);
+    };
+    if (thread_pool_ && thread_pool_->size() > 1 && !jobs.empty()) {
+        std::vector<std::future<void>> pending;
+        for (size_t i = 1; i < jobs.size(); ++i) {
+            pending.push_back(thread_pool_->submit([&run, &job = jobs[i]]() {
+                ScratchScope task_scope;
+                run(job);
+            }));
+        }
+        run(jobs[0]);
+        for (auto& future : pending) {
+            thread_pool_->wait(future);
+        }
+    } else {
+        for (auto& job : jobs) {
+            run(job);
+        }
+    }
+    
+    // Skipped families keep the trained defaults
+    Eigen::VectorXf combined = defaults.size() == FEATURE_SIZE ? defaults : Eigen::VectorXf::Zero(FEATURE_SIZE);
+    if (cascade_features) {
+        combined.head(STATISTICAL_FEATURES) = cascade_features->head(STATISTICAL_FEATURES);
+        combined.tail(COLOR_FEATURES) = cascade_features->tail(COLOR_FEATURES);
+    }
+    for (const auto& job : jobs) {
+        combined.segment(job.offset, job.features.size()) = job.features;
+    }
+    if (!run_noise) {
+        report.add(DegradedStage::NoiseSkipped);
+    }
+    if (frequency_family == FREQUENCY_REDUCED) {
+        report.add(DegradedStage::FrequencyReduced);
+    } else if (frequency_family == FAMILY_COUNT) {
+        report.add(DegradedStage::FrequencySkipped);
+    }
+    if (!run_texture) {
+        report.add(DegradedStage::TextureSkipped);
+    }
+    return combined;
+}
+
+Eigen::VectorXf FeatureExtractor::extractFeaturesIncremental(const cv::Mat& image, IncrementalFeatureState& state) {
+    cv::Mat processed = preprocessImage(image);
+    ScopedTimer timer(ProfileStage::IncrementalFeatures);
+    if (processed.channels() != 3) {
+        cv::cvtColor(processed, processed, cv::COLOR_GRAY2BGR);
+    }
+    cv::Mat gray;
+    cv::cvtColor(processed, gray, cv::COLOR_BGR2GRAY);
+    
+    const int grid = INPUT_SIZE / BLOCK_SIZE;
+    const int block_count = grid * grid;
+    auto blockRect = [](int b, int grid_size, int block_size) {
+        return cv::Rect((b % grid_size) * block_size, (b / grid_size) * block_size, block_size, block_size);
+    };
+    auto dilate = [](const std::vector<bool>& mask, int grid_size) {
+        std::vector<bool> dilated(mask.size(), false);
+        for (int b = 0; b < static_cast<int>(mask.size()); ++b) {
+            if (!mask[b]) {
+                continue;
+            }
+            int bx = b % grid_size;
+            int by = b / grid_size;
+            for (int y = std::max(by - 1, 0); y <= std::min(by + 1, grid_size - 1); ++y) {
+                for (int x = std::max(bx - 1, 0); x <= std::min(bx + 1, grid_size - 1); ++x) {
+                    dilated[y * grid_size + x] = true;
+                }
+            }
+        }
+        return dilated;
+    };
+    
+    // Cheap blockwise diff against the image the accumulators were built from
+    const bool first = !state.initialized_;
+    std::vector<bool> changed(block_count, true);
+    int changed_blocks = block_count;
+    if (!first) {
+        changed_blocks = 0;
+        for (int b = 0; b < block_count; ++b) {
+            cv::Rect block = blockRect(b, grid, BLOCK_SIZE);
+            double delta = cv::norm(gray(block), state.gray_(block), cv::NORM_L1) / block.area();
+            changed[b] = delta > CHANGE_THRESHOLD;
+            changed_blocks += changed[b] ? 1 : 0;
+        }
+    }
+    state.last_changed_blocks_ = changed_blocks;
+    if (changed_blocks == 0) {
+        return state.features_;
+    }
+    
+    if (first) {
+        IncrementalFeatureState::BlockAccumulator empty;
+        empty.histogram.assign(IncrementalFeatureState::BlockAccumulator::HISTOGRAM_SLOTS * HISTOGRAM_BINS, 0);
+        state.blocks_.assign(block_count, empty);
+        state.gray_ = gray.clone();
+        state.changed_since_fft_.assign(block_count, false);
+    }
+    
+    // Blurred residuals and the Laplacian reach into neighboring blocks, so
+    // the blocks around a change are rebuilt as well
+    std::vector<bool> rebuild = dilate(changed, grid);
+    for (int b = 0; b < block_count; ++b) {
+        if (rebuild[b]) {
+            cv::Rect block = blockRect(b, grid, BLOCK_SIZE);
+            accumulateBlock(processed, gray, block, state.blocks_[b]);
+            gray(block).copyTo(state.gray_(block));
+        }
+    }
+    
+    // GLCM counts: retract the pairs of the affected texture blocks, update
+    // their pixels, then add the pairs back
+    cv::Mat texture = textureImage(gray);
+    if (first) {
+        state.texture_gray_ = texture.clone();
+        state.glcm_counts_.assign(4 * GLCM_LEVELS * GLCM_LEVELS, 0);
+        std::fill(std::begin(state.glcm_sum_sq_), std::end(state.glcm_sum_sq_), 0.0);
+        accumulateGLCM(texture, cv::Rect(0, 0, texture.cols, texture.rows), 1,
+                       state.glcm_counts_, state.glcm_sum_sq_);
+    } else {
+        const int texture_grid = TEXTURE_SIZE / TEXTURE_BLOCK_SIZE;
+        const double scale = static_cast<double>(TEXTURE_SIZE) / INPUT_SIZE;
+        std::vector<bool> texture_changed(texture_grid * texture_grid, false);
+        for (int b = 0; b < block_count; ++b) {
+            if (!changed[b]) {
+                continue;
+            }
+            // Map the block into texture space, widened by the resize footprint
+            cv::Rect block = blockRect(b, grid, BLOCK_SIZE);
+            int x0 = std::max(static_cast<int>(std::floor(block.x * scale)) - 2, 0);
+            int y0 = std::max(static_cast<int>(std::floor(block.y * scale)) - 2, 0);
+            int x1 = std::min(static_cast<int>(std::ceil(block.br().x * scale)) + 2, TEXTURE_SIZE);
+            int y1 = std::min(static_cast<int>(std::ceil(block.br().y * scale)) + 2, TEXTURE_SIZE);
+            for (int ty = y0 / TEXTURE_BLOCK_SIZE; ty <= (y1 - 1) / TEXTURE_BLOCK_SIZE; ++ty) {
+                for (int tx = x0 / TEXTURE_BLOCK_SIZE; tx <= (x1 - 1) / TEXTURE_BLOCK_SIZE; ++tx) {
+                    texture_changed[ty * texture_grid + tx] = true;
+                }
+            }
+        }
+        
+        // A pair is counted at its first pixel, whose neighbor may lie one block away
+        std::vector<bool> texture_pairs = dilate(texture_changed, texture_grid);
+        for (int b = 0; b < texture_grid * texture_grid; ++b) {
+            if (texture_pairs[b]) {
+                accumulateGLCM(state.texture_gray_, blockRect(b, texture_grid, TEXTURE_BLOCK_SIZE), -1,
+                               state.glcm_counts_, state.glcm_sum_sq_);
+            }
+        }
+        for (int b = 0; b < texture_grid * texture_grid; ++b) {
+            if (texture_changed[b]) {
+                cv::Rect block = blockRect(b, texture_grid, TEXTURE_BLOCK_SIZE);
+                texture(block).copyTo(state.texture_gray_(block));
+            }
+        }
+        for (int b = 0; b < texture_grid * texture_grid; ++b) {
+            if (texture_pairs[b]) {
+                accumulateGLCM(state.texture_gray_, blockRect(b, texture_grid, TEXTURE_BLOCK_SIZE), 1,
+                               state.glcm_counts_, state.glcm_sum_sq_);
+            }
+        }
+    }
+    
+    // The FFT is global; refresh it once enough of the frame changed since the last one
+    int changed_since_fft = 0;
+    for (int b = 0; b < block_count; ++b) {
+        if (changed[b]) {
+            state.changed_since_fft_[b] = true;
+        }
+        changed_since_fft += state.changed_since_fft_[b] ? 1 : 0;
+    }
+    if (first || changed_since_fft >= FFT_REFRESH_FRACTION * block_count) {
+        state.frequency_ = extractFrequencyFeatures(gray);
+        std::fill(state.changed_since_fft_.begin(), state.changed_since_fft_.end(), false);
+    }
+    
+    state.initialized_ = true;
+    state.features_ = assembleIncrementalFeatures(state);
+    return state.features_;
+}
+
+void FeatureExtractor::accumulateBlock(const cv::Mat& processed, const cv::Mat& gray, const cv::Rect& block,
+                                       IncrementalFeatureState::BlockAccumulator& acc) {
+    using Accumulator = IncrementalFeatureState::BlockAccumulator;
+    std::fill(std::begin(acc.sum), std::end(acc.sum), 0.0);
+    std::fill(std::begin(acc.sum_sq), std::end(acc.sum_sq), 0.0);
+    std::fill(acc.histogram.begin(), acc.histogram.end(), 0);
+    
+    // Filtering a ROI reads the surrounding pixels of the parent image, so the
+    // block's residuals match those of a full-frame pass
+    cv::Mat blurred, laplacian;
+    cv::GaussianBlur(gray(block), blurred, cv::Size(5, 5), 0);
+    cv::Laplacian(gray(block), laplacian, CV_32F);
+    
+    float values[Accumulator::SLOTS];
+    for (int y = 0; y < block.height; ++y) {
+        const float* gray_row = gray.ptr<float>(block.y + y) + block.x;
+        const cv::Vec3f* color_row = processed.ptr<cv::Vec3f>(block.y + y) + block.x;
+        const float* blurred_row = blurred.ptr<float>(y);
+        const float* laplacian_row = laplacian.ptr<float>(y);
+        
+        for (int x = 0; x < block.width; ++x) {
+            values[0] = gray_row[x];
+            values[1] = color_row[x][0];
+            values[2] = color_row[x][1];
+            values[3] = color_row[x][2];
+            values[4] = std::abs(gray_row[x] - blurred_row[x]);
+            values[5] = laplacian_row[x];
+            
+            for (int s = 0; s < Accumulator::SLOTS; ++s) {
+                acc.sum[s] += values[s];
+                acc.sum_sq[s] += static_cast<double>(values[s]) * values[s];
+            }
+            for (int s = 0; s < Accumulator::HISTOGRAM_SLOTS; ++s) {
+                acc.histogram[s * HISTOGRAM_BINS + histogramBin(values[s])]++;
+            }
+        }
+    }
+}
+
+Eigen::VectorXf FeatureExtractor::assembleIncrementalFeatures(IncrementalFeatureState& state) {
+    using Accumulator = IncrementalFeatureState::BlockAccumulator;
+    double sum[Accumulator::SLOTS] = {};
+    double sum_sq[Accumulator::SLOTS] = {};
+    std::vector<double> histogram(Accumulator::HISTOGRAM_SLOTS * HISTOGRAM_BINS, 0.0);
+    for (const auto& block : state.blocks_) {
+        for (int s = 0; s < Accumulator::SLOTS; ++s) {
+            sum[s] += block.sum[s];
+            sum_sq[s] += block.sum_sq[s];
+        }
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            histogram[i] += block.histogram[i];
+        }
+    }
+    
+    // Same layout and values as extractFeatures, up to summation order
+    const double pixels = static_cast<double>(INPUT_SIZE) * INPUT_SIZE;
+    auto mean = [&](int s) { return sum[s] / pixels; };
+    auto stddev = [&](int s) { return std::sqrt(std::max(sum_sq[s] / pixels - mean(s) * mean(s), 0.0)); };
+    auto bin = [&](int s, int i) { return static_cast<float>(histogram[s * HISTOGRAM_BINS + i] / pixels); };
+    
+    Eigen::VectorXf combined = Eigen::VectorXf::Zero(FEATURE_SIZE);
+    
+    // Statistical features (64 features)
+    combined(0) = mean(0) / 255.0f;
+    combined(1) = stddev(0) / 255.0f;
+    for (int i = 0; i < 62; ++i) {
+        combined(i + 2) = bin(0, i);
+    }
+    
+    // Frequency features (128 features)
+    combined.segment(64, 128) = state.frequency_;
+    
+    // Texture features (128 features)
+    std::vector<float> glcm = glcmStatistics(state.glcm_sum_sq_, state.texture_gray_.size());
+    for (size_t i = 0; i < glcm.size(); ++i) {
+        combined(192 + i) = glcm[i];
+    }
+    
+    // Noise features (128 features)
+    combined(320) = mean(4) / 255.0f;
+    combined(321) = stddev(4) / 255.0f;
+    for (int i = 0; i < 32; ++i) {
+        combined(322 + i) = bin(4, i);
+    }
+    combined(354) = mean(5);
+    combined(355) = stddev(5);
+    
+    // Color features (64 features)
+    for (int c = 0; c < 3; ++c) {
+        for (int i = 0; i < 16; ++i) {
+            combined(448 + c * 16 + i) = bin(1 + c, i);
+        }
+        combined(496 + c) = mean(1 + c) / 255.0f;
+        combined(499 + c) = stddev(1 + c) / 255.0f;
+    }
+    combined(502) = (mean(2) + 1) / (mean(1) + 1); // G/B ratio
+    combined(503) = (mean(3) + 1) / (mean(1) + 1); // R/B ratio
+    combined(504) = (mean(3) + 1) / (mean(2) + 1); // R/G ratio
+    
+    return combined;
+}
+
 Eigen::VectorXf FeatureExtractor::extractStatisticalFeatures(const cv::Mat& image) {
+    ScopedTimer timer(ProfileStage::StatisticalFeatures);
     cv::Mat gray;
     if (image.channels() == 3) {
         cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
@@ -53,11 +487,11 @@ Eigen::VectorXf FeatureExtractor::extractStatisticalFeatures(const cv::Mat& imag
     Eigen::VectorXf features(64);
     
     // Basic statistics
-    cv::Scalar mean, stddev;
-    cv::meanStdDev(gray, mean, stddev);
+    double mean, stddev;
+    channelMoments(gray, mean, stddev);
     
-    features(0) = mean[0] / 255.0f;
-    features(1) = stddev[0] / 255.0f;
+    features(0) = mean / 255.0f;
+    features(1) = stddev / 255.0f;
     
     // Histogram features
     std::vector<float> hist = calculateHistogram(gray);
@@ -69,16 +503,21 @@ Eigen::VectorXf FeatureExtractor::extractStatisticalFeatures(const cv::Mat& imag
 }
 
 Eigen::VectorXf FeatureExtractor::extractFrequencyFeatures(const cv::Mat& image) {
+    return frequencyFeatures(image, FFT_SIZE);
+}
+
+Eigen::VectorXf FeatureExtractor::frequencyFeatures(const cv::Mat& image, int fft_size) {
+    ScopedTimer timer(ProfileStage::FrequencyFeatures);
     cv::Mat gray;
     if (image.channels() == 3) {
-        cv::cvtColor(image, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
     } else {
         gray = image.clone();
     }
     
     // Resize to power of 2 for FFT
     cv::Mat resized;
-    cv::resize(gray, resized, cv::Size(256, 256));
+    cv::resize(gray, resized, cv::Size(fft_size, fft_size));
     
     // Convert to float
     cv::Mat float_img;
@@ -89,28 +528,39 @@ Eigen::VectorXf FeatureExtractor::extractFrequencyFeatures(const cv::Mat& image)
     cv::dft(float_img, complex_img, cv::DFT_COMPLEX_OUTPUT);
     
     // Calculate magnitude spectrum
+    std::vector<cv::Mat> planes;
+    cv::split(complex_img, planes);
     cv::Mat magnitude;
-    cv::magnitude(complex_img.reshape(2), cv::Mat::zeros(256, 256, CV_32F), magnitude);
+    cv::magnitude(planes[0], planes[1], magnitude);
     
-    // Log scale
+    // Log scale. Magnitudes grow with the pixel count, so a smaller
+    // transform is scaled up to stay comparable with the full-size one.
+    const int scale = FFT_SIZE / fft_size;
+    if (scale > 1) {
+        magnitude *= static_cast<double>(scale * scale);
+    }
     magnitude += cv::Scalar::all(1);
     cv::log(magnitude, magnitude);
     
-    // Extract features from magnitude spectrum
+    // Extract features from magnitude spectrum; regions are given at
+    // FFT_SIZE and scaled down to the transform size
     Eigen::VectorXf features(128);
+    auto region = [scale](int x, int y, int width, int height) {
+        return cv::Rect(x / scale, y / scale, width / scale, height / scale);
+    };
     
     // Low frequency features (center region)
-    cv::Rect center_region(96, 96, 64, 64);
+    cv::Rect center_region = region(96, 96, 64, 64);
     cv::Mat center_mag = magnitude(center_region);
     cv::Scalar center_mean = cv::mean(center_mag);
     features(0) = center_mean[0];
     
     // High frequency features (corners)
     std::vector<cv::Rect> corner_regions = {
-        cv::Rect(0, 0, 32, 32),
-        cv::Rect(224, 0, 32, 32),
-        cv::Rect(0, 224, 32, 32),
-        cv::Rect(224, 224, 32, 32)
+        region(0, 0, 32, 32),
+        region(224, 0, 32, 32),
+        region(0, 224, 32, 32),
+        region(224, 224, 32, 32)
     };
     
     for (int i = 0; i < 4; ++i) {
@@ -121,28 +571,25 @@ Eigen::VectorXf FeatureExtractor::extractFrequencyFeatures(const cv::Mat& image)
     
     // Frequency bands
     for (int i = 0; i < 123; ++i) {
-        int x = (i * 7) % 256;
-        int y = (i * 11) % 256;
-        features(i + 5) = magnitude.at<float>(y, x);
+        int x = (i * 7) % FFT_SIZE;
+        int y = (i * 11) % FFT_SIZE;
+        features(i + 5) = magnitude.at<float>(y / scale, x / scale);
     }
     
     return features;
 }
 
 Eigen::VectorXf FeatureExtractor::extractTextureFeatures(const cv::Mat& image) {
+    ScopedTimer timer(ProfileStage::TextureFeatures);
     cv::Mat gray;
     if (image.channels() == 3) {
-        cv::cvtColor(image, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
     } else {
         gray = image.clone();
     }
     
-    // Resize for GLCM calculation
-    cv::Mat resized;
-    cv::resize(gray, resized, cv::Size(128, 128));
-    
-    // Calculate GLCM features
-    std::vector<float> glcm_features = calculateGLCM(resized);
+    // Calculate GLCM features on the quantized, resized image
+    std::vector<float> glcm_features = calculateGLCM(textureImage(gray));
     
     Eigen::VectorXf features(128);
     for (int i = 0; i < std::min(128, (int)glcm_features.size()); ++i) {
@@ -158,9 +605,10 @@ Eigen::VectorXf FeatureExtractor::extractTextureFeatures(const cv::Mat& image) {
 }
 
 Eigen::VectorXf FeatureExtractor::extractNoiseFeatures(const cv::Mat& image) {
+    ScopedTimer timer(ProfileStage::NoiseFeatures);
     cv::Mat gray;
     if (image.channels() == 3) {
-        cv::cvtColor(image, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
     } else {
         gray = image.clone();
     }
@@ -181,6 +629,7 @@ Eigen::VectorXf FeatureExtractor::extractNoiseFeatures(const cv::Mat& image) {
 }
 
 Eigen::VectorXf FeatureExtractor::extractColorFeatures(const cv::Mat& image) {
+    ScopedTimer timer(ProfileStage::ColorFeatures);
     if (image.channels() != 3) {
         // Convert grayscale to BGR
         cv::Mat color_img;
@@ -190,12 +639,6 @@ Eigen::VectorXf FeatureExtractor::extractColorFeatures(const cv::Mat& image) {
     
     Eigen::VectorXf features(64);
     
-    // Convert to different color spaces
-    cv::Mat hsv, lab, yuv;
-    cv::cvtColor(image, hsv, cv::COLOR_BGR2HSV);
-    cv::cvtColor(image, lab, cv::COLOR_BGR2Lab);
-    cv::cvtColor(image, yuv, cv::COLOR_BGR2YUV);
-    
     // Extract histograms for each channel
     std::vector<cv::Mat> channels;
     cv::split(image, channels);
@@ -208,8 +651,10 @@ Eigen::VectorXf FeatureExtractor::extractColorFeatures(const cv::Mat& image) {
     }
     
     // Color statistics
-    cv::Scalar mean, stddev;
-    cv::meanStdDev(image, mean, stddev);
+    double mean[3], stddev[3];
+    for (int c = 0; c < 3; ++c) {
+        channelMoments(channels[c], mean[c], stddev[c]);
+    }
     
     features(48) = mean[0] / 255.0f; // B
     features(49) = mean[1] / 255.0f; // G
@@ -232,6 +677,7 @@ Eigen::VectorXf FeatureExtractor::extractColorFeatures(const cv::Mat& image) {
 }
 
 cv::Mat FeatureExtractor::preprocessImage(const cv::Mat& image) {
+    ScopedTimer timer(ProfileStage::Preprocess);
     cv::Mat processed = image.clone();
     
     // Resize to standard size
@@ -243,14 +689,32 @@ cv::Mat FeatureExtractor::preprocessImage(const cv::Mat& image) {
     return processed;
 }
 
+int FeatureExtractor::histogramBin(float value) {
+    // Values are normalized intensities in [0, 1]
+    int bin = static_cast<int>(value * (HISTOGRAM_BINS - 1));
+    return std::min(std::max(bin, 0), HISTOGRAM_BINS - 1);
+}
+
 std::vector<float> FeatureExtractor::calculateHistogram(const cv::Mat& image) {
     std::vector<float> histogram(HISTOGRAM_BINS, 0.0f);
+    const CpuKernels& kernels = cpuKernels();
     
-    for (int y = 0; y < image.rows; ++y) {
-        for (int x = 0; x < image.cols; ++x) {
-            float pixel_value = image.at<uchar>(y, x);
-            int bin = static_cast<int>((pixel_value / 255.0f) * (HISTOGRAM_BINS - 1));
-            histogram[bin]++;
+    if (image.depth() == CV_8U) {
+        // Count each byte value, then fold the 256 values into the bins
+        uint32_t counts[256] = {};
+        for (int y = 0; y < image.rows; ++y) {
+            kernels.histogram_u8(image.ptr<uchar>(y), image.cols, counts);
+        }
+        for (int value = 0; value < 256; ++value) {
+            histogram[histogramBin(value / 255.0f)] += counts[value];
+        }
+    } else {
+        uint32_t counts[HISTOGRAM_BINS] = {};
+        for (int y = 0; y < image.rows; ++y) {
+            kernels.histogram_f32(image.ptr<float>(y), image.cols, HISTOGRAM_BINS, counts);
+        }
+        for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+            histogram[bin] = static_cast<float>(counts[bin]);
         }
     }
     
@@ -264,47 +728,64 @@ std::vector<float> FeatureExtractor::calculateHistogram(const cv::Mat& image) {
 }
 
 std::vector<float> FeatureExtractor::calculateGLCM(const cv::Mat& image) {
-    // Simplified GLCM calculation
+    // Simplified GLCM calculation for 4 directions
+    std::vector<int> counts(4 * GLCM_LEVELS * GLCM_LEVELS, 0);
+    double sum_sq[4] = {};
+    accumulateGLCM(image, cv::Rect(0, 0, image.cols, image.rows), 1, counts, sum_sq);
+    return glcmStatistics(sum_sq, image.size());
+}
+
+void FeatureExtractor::accumulateGLCM(const cv::Mat& image, const cv::Rect& region, int sign,
+                                      std::vector<int>& counts, double* sum_sq) {
+    // Pairs are attributed to their first pixel; borders have no full
+    // neighborhood. Neighbors are at (0, 1), (-1, 1), (-1, 0) and (-1, -1)
+    // for 0, 45, 90 and 135 degrees.
+    int y_begin = std::max(region.y, 1);
+    int y_end = std::min(region.y + region.height, image.rows - 1);
+    int x_begin = std::max(region.x, 1);
+    int x_end = std::min(region.x + region.width, image.cols - 1);
+    
+    if (x_begin >= x_end) {
+        return;
+    }
+    
+    const CpuKernels& kernels = cpuKernels();
+    for (int y = y_begin; y < y_end; ++y) {
+        kernels.glcm_row(image.ptr<uchar>(y - 1), image.ptr<uchar>(y), x_begin, x_end,
+                         sign, counts.data(), sum_sq);
+    }
+}
+
+std::vector<float> FeatureExtractor::glcmStatistics(const double* sum_sq, const cv::Size& size) {
+    // Mean and standard deviation of each normalized GLCM, from the pair
+    // count and the sum of squared counts
     std::vector<float> features;
+    double pairs = std::max(size.width - 2, 0) * static_cast<double>(std::max(size.height - 2, 0));
+    double cells = static_cast<double>(GLCM_LEVELS) * GLCM_LEVELS;
     
-    // Calculate GLCM for different directions
     for (int angle = 0; angle < 4; ++angle) {
-        cv::Mat glcm = cv::Mat::zeros(256, 256, CV_32F);
-        
-        for (int y = 1; y < image.rows - 1; ++y) {
-            for (int x = 1; x < image.cols - 1; ++x) {
-                int i = image.at<uchar>(y, x);
-                
-                int j;
-                switch (angle) {
-                    case 0: j = image.at<uchar>(y, x + 1); break; // 0 degrees
-                    case 1: j = image.at<uchar>(y - 1, x + 1); break; // 45 degrees
-                    case 2: j = image.at<uchar>(y - 1, x); break; // 90 degrees
-                    case 3: j = image.at<uchar>(y - 1, x - 1); break; // 135 degrees
-                }
-                
-                glcm.at<float>(i, j)++;
-            }
-        }
-        
-        // Normalize GLCM
-        float sum = cv::sum(glcm)[0];
-        if (sum > 0) {
-            glcm /= sum;
+        if (pairs == 0.0) {
+            features.push_back(0.0f);
+            features.push_back(0.0f);
+            continue;
         }
-        
-        // Extract GLCM features
-        cv::Scalar mean = cv::mean(glcm);
-        cv::Mat mean_mat, stddev_mat;
-        cv::meanStdDev(glcm, mean_mat, stddev_mat);
-        
-        features.push_back(mean[0]);
-        features.push_back(stddev_mat.at<double>(0, 0));
+        double mean = 1.0 / cells;
+        double mean_sq = sum_sq[angle] / (pairs * pairs * cells);
+        features.push_back(static_cast<float>(mean));
+        features.push_back(static_cast<float>(std::sqrt(std::max(mean_sq - mean * mean, 0.0))));
     }
     
     return features;
 }
 
+cv::Mat FeatureExtractor::textureImage(const cv::Mat& gray) {
+    // GLCM works on 8-bit gray levels at a reduced size
+    cv::Mat resized, quantized;
+    cv::resize(gray, resized, cv::Size(TEXTURE_SIZE, TEXTURE_SIZE));
+    resized.convertTo(quantized, CV_8U, gray.depth() == CV_8U ? 1.0 : 255.0);
+    return quantized;
+}
+
 std::vector<float> FeatureExtractor::calculateNoiseMetrics(const cv::Mat& image) {
     std::vector<float> metrics;
     
@@ -317,11 +798,11 @@ std::vector<float> FeatureExtractor::calculateNoiseMetrics(const cv::Mat& image)
     cv::absdiff(image, blurred, noise);
     
     // Noise statistics
-    cv::Scalar mean, stddev;
-    cv::meanStdDev(noise, mean, stddev);
+    double mean, stddev;
+    channelMoments(noise, mean, stddev);
     
-    metrics.push_back(mean[0] / 255.0f);
-    metrics.push_back(stddev[0] / 255.0f);
+    metrics.push_back(mean / 255.0f);
+    metrics.push_back(stddev / 255.0f);
     
     // Noise distribution
     std::vector<float> noise_hist = calculateHistogram(noise);
@@ -332,11 +813,11 @@ std::vector<float> FeatureExtractor::calculateNoiseMetrics(const cv::Mat& image)
     // Laplacian variance (edge detection)
     cv::Mat laplacian;
     cv::Laplacian(image, laplacian, CV_32F);
-    cv::Scalar lap_mean, lap_stddev;
-    cv::meanStdDev(laplacian, lap_mean, lap_stddev);
+    double lap_mean, lap_stddev;
+    channelMoments(laplacian, lap_mean, lap_stddev);
     
-    metrics.push_back(lap_mean[0]);
-    metrics.push_back(lap_stddev[0]);
+    metrics.push_back(lap_mean);
+    metrics.push_back(lap_stddev);
     
     // Fill remaining metrics
     while (metrics.size() < 128) {
@@ -0,0 +1,83 @@
+#include "../include/file_io.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+bool writeAtomically(const std::string& path, const std::string& content) {
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << content;
+        if (!file.good()) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    return !error;
+}
+
+bool writeSnapshot(const std::string& path, const std::string& payload, const std::string& what) {
+    std::filesystem::path temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(payload.data(), payload.size());
+        put(file, fnv1a(payload.data(), payload.size()));
+        if (!file) {
+            std::cerr << "Failed to write " << what << ": " << temporary.string() << std::endl;
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::cerr << "Failed to publish " << what << ": " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+SnapshotStatus readSnapshot(const std::string& path, std::string& payload) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return SnapshotStatus::Missing;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    uint64_t stored = 0;
+    if (data.size() <= sizeof(stored)) {
+        return SnapshotStatus::Damaged;
+    }
+    std::memcpy(&stored, data.data() + data.size() - sizeof(stored), sizeof(stored));
+    data.resize(data.size() - sizeof(stored));
+    if (stored != fnv1a(data.data(), data.size())) {
+        return SnapshotStatus::Damaged;
+    }
+    payload = std::move(data);
+    return SnapshotStatus::Ok;
+}
+
+uint64_t fnv1a(const char* data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void putString(std::ostream& out, const std::string& value) {
+    put(out, static_cast<uint64_t>(value.size()));
+    out.write(value.data(), value.size());
+}
+
+bool getString(std::istream& in, std::string& value, uint64_t max_size) {
+    uint64_t size = 0;
+    if (!get(in, size) || size > max_size) {
+        return false;
+    }
+    value.resize(size);
+    return static_cast<bool>(in.read(&value[0], size));
+}
@@ -0,0 +1,179 @@
+#include "../include/frame_reader.h"
+#include <iostream>
+#include <sstream>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+FrameReader::FrameReader()
+    : file_(nullptr), owns_file_(false), format_(StreamFormat::Y4M),
+      width_(0), height_(0), monochrome_(false), bytes_read_(0) {}
+
+FrameReader::~FrameReader() {
+    close();
+}
+
+bool FrameReader::parseFormat(const std::string& name, StreamFormat& format) {
+    if (name == "y4m") {
+        format = StreamFormat::Y4M;
+    } else if (name == "bgr") {
+        format = StreamFormat::BGR;
+    } else if (name == "i420") {
+        format = StreamFormat::I420;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool FrameReader::open(const std::string& source, StreamFormat format, int width, int height) {
+    close();
+
+    if (source == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        file_ = stdin;
+        owns_file_ = false;
+    } else {
+        file_ = std::fopen(source.c_str(), "rb");
+        owns_file_ = true;
+    }
+
+    if (!file_) {
+        std::cerr << "Failed to open stream: " << source << std::endl;
+        return false;
+    }
+
+    format_ = format;
+    width_ = width;
+    height_ = height;
+    monochrome_ = false;
+    bytes_read_ = 0;
+
+    if (format_ == StreamFormat::Y4M) {
+        return readY4MHeader();
+    }
+
+    if (width_ <= 0 || height_ <= 0) {
+        std::cerr << "Raw stream formats need --width and --height" << std::endl;
+        return false;
+    }
+    if (format_ == StreamFormat::I420 && (width_ % 2 != 0 || height_ % 2 != 0)) {
+        std::cerr << "I420 frames need even dimensions" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void FrameReader::close() {
+    if (file_ && owns_file_) {
+        std::fclose(file_);
+    }
+    file_ = nullptr;
+    owns_file_ = false;
+}
+
+bool FrameReader::readFrame(cv::Mat& frame) {
+    if (!file_) {
+        return false;
+    }
+
+    switch (format_) {
+        case StreamFormat::BGR: {
+            frame.create(height_, width_, CV_8UC3);
+            return readExact(frame.data, frame.total() * frame.elemSize());
+        }
+        case StreamFormat::I420: {
+            buffer_.resize(static_cast<size_t>(width_) * height_ * 3 / 2);
+            if (!readExact(buffer_.data(), buffer_.size())) {
+                return false;
+            }
+            cv::Mat yuv(height_ * 3 / 2, width_, CV_8UC1, buffer_.data());
+            cv::cvtColor(yuv, frame, cv::COLOR_YUV2BGR_I420);
+            return true;
+        }
+        case StreamFormat::Y4M: {
+            if (!skipY4MFrameHeader()) {
+                return false;
+            }
+            size_t luma = static_cast<size_t>(width_) * height_;
+            buffer_.resize(monochrome_ ? luma : luma * 3 / 2);
+            if (!readExact(buffer_.data(), buffer_.size())) {
+                return false;
+            }
+            if (monochrome_) {
+                cv::Mat gray(height_, width_, CV_8UC1, buffer_.data());
+                cv::cvtColor(gray, frame, cv::COLOR_GRAY2BGR);
+            } else {
+                cv::Mat yuv(height_ * 3 / 2, width_, CV_8UC1, buffer_.data());
+                cv::cvtColor(yuv, frame, cv::COLOR_YUV2BGR_I420);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameReader::readY4MHeader() {
+    // "YUV4MPEG2 W<width> H<height> [F.. I.. A.. C<colorspace> X..]\n"
+    std::string header;
+    int c;
+    while ((c = std::fgetc(file_)) != EOF && c != '\n') {
+        header.push_back(static_cast<char>(c));
+    }
+    bytes_read_ += header.size() + 1;
+
+    std::istringstream tokens(header);
+    std::string token;
+    tokens >> token;
+    if (token != "YUV4MPEG2") {
+        std::cerr << "Not a YUV4MPEG2 stream" << std::endl;
+        return false;
+    }
+
+    while (tokens >> token) {
+        switch (token[0]) {
+            case 'W': width_ = std::stoi(token.substr(1)); break;
+            case 'H': height_ = std::stoi(token.substr(1)); break;
+            case 'C':
+                if (token.rfind("C420", 0) == 0) {
+                    monochrome_ = false;
+                } else if (token == "Cmono") {
+                    monochrome_ = true;
+                } else {
+                    std::cerr << "Unsupported Y4M colorspace: " << token.substr(1) << std::endl;
+                    return false;
+                }
+                break;
+            default: break;
+        }
+    }
+
+    if (width_ <= 0 || height_ <= 0 || width_ % 2 != 0 || height_ % 2 != 0) {
+        std::cerr << "Invalid Y4M dimensions" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FrameReader::skipY4MFrameHeader() {
+    // "FRAME[ params]\n"
+    char tag[5];
+    if (!readExact(tag, sizeof(tag)) || std::string(tag, sizeof(tag)) != "FRAME") {
+        return false;
+    }
+    int c;
+    while ((c = std::fgetc(file_)) != EOF && c != '\n') {
+        ++bytes_read_;
+    }
+    ++bytes_read_;
+    return c == '\n';
+}
+
+bool FrameReader::readExact(void* buffer, size_t size) {
+    size_t read = std::fread(buffer, 1, size, file_);
+    bytes_read_ += read;
+    return read == size;
+}
@@ -0,0 +1,160 @@
+#include "../include/hyperparameter_sweep.h"
+#include "../include/binary_metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+std::string SweepConfig::describe() const {
+    std::ostringstream text;
+    for (size_t i = 0; i < hidden_layers.size(); ++i) {
+        text << (i ? "-" : "") << hidden_layers[i];
+    }
+    text << " lr " << learning_rate;
+    return text.str();
+}
+
+HyperparameterSweep::HyperparameterSweep(const Eigen::MatrixXf& features, const Eigen::VectorXf& labels,
+                                         ThreadPool& pool)
+    : features_(features), labels_(labels), pool_(pool) {}
+
+std::vector<SweepResult> HyperparameterSweep::run(const SweepOptions& options) {
+    const Eigen::Index samples = features_.cols();
+    const int folds = std::max(1, options.folds);
+    uint32_t base_seed = options.training.seed ? options.training.seed : std::random_device{}();
+    
+    // One fixed permutation shared by all configurations, so they see the same folds
+    std::vector<Eigen::Index> permutation(samples);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::shuffle(permutation.begin(), permutation.end(), std::mt19937(base_seed));
+    
+    std::vector<std::vector<Eigen::Index>> train_sets(folds);
+    std::vector<std::vector<Eigen::Index>> validation_sets(folds);
+    Eigen::Index holdout_start = samples - static_cast<Eigen::Index>(options.holdout * samples);
+    for (Eigen::Index position = 0; position < samples; ++position) {
+        Eigen::Index sample = permutation[position];
+        for (int fold = 0; fold < folds; ++fold) {
+            bool validation = folds > 1 ? position % folds == fold : position >= holdout_start;
+            (validation ? validation_sets[fold] : train_sets[fold]).push_back(sample);
+        }
+    }
+    
+    // Every configuration x fold is an independent run
+    std::vector<std::future<RunMetrics>> pending;
+    for (size_t c = 0; c < options.configs.size(); ++c) {
+        for (int fold = 0; fold < folds; ++fold) {
+            uint32_t seed = base_seed + static_cast<uint32_t>(c * folds + fold + 1) * 0x9E3779B9u;
+            const SweepConfig& config = options.configs[c];
+            pending.push_back(pool_.submit([this, &config, &train_sets, &validation_sets, &options, fold, seed]() {
+                return trainRun(config, train_sets[fold], validation_sets[fold], options.training, seed);
+            }));
+        }
+    }
+    
+    std::vector<SweepResult> results;
+    for (size_t c = 0; c < options.configs.size(); ++c) {
+        SweepResult result;
+        result.config = options.configs[c];
+        for (int fold = 0; fold < folds; ++fold) {
+            RunMetrics metrics = pool_.wait(pending[c * folds + fold]);
+            result.fold_auc.push_back(metrics.auc);
+            result.auc += metrics.auc / folds;
+            result.loss += metrics.loss / folds;
+            result.accuracy += metrics.accuracy / folds;
+        }
+        for (float auc : result.fold_auc) {
+            result.auc_stddev += (auc - result.auc) * (auc - result.auc) / folds;
+        }
+        result.auc_stddev = std::sqrt(result.auc_stddev);
+        results.push_back(result);
+    }
+    
+    std::stable_sort(results.begin(), results.end(), [](const SweepResult& a, const SweepResult& b) {
+        return a.auc != b.auc ? a.auc > b.auc : a.loss < b.loss;
+    });
+    return results;
+}
+
+std::unique_ptr<NeuralNetwork> HyperparameterSweep::createNetwork(const SweepConfig& config, uint32_t seed) const {
+    std::vector<int> layer_sizes = {static_cast<int>(features_.rows())};
+    layer_sizes.insert(layer_sizes.end(), config.hidden_layers.begin(), config.hidden_layers.end());
+    layer_sizes.push_back(1);
+    
+    auto network = std::make_unique<NeuralNetwork>();
+    network->setSeed(seed);
+    network->initialize(layer_sizes);
+    return network;
+}
+
+HyperparameterSweep::RunMetrics HyperparameterSweep::trainRun(const SweepConfig& config,
+                                                              const std::vector<Eigen::Index>& train,
+                                                              const std::vector<Eigen::Index>& validation,
+                                                              const TrainingOptions& training,
+                                                              uint32_t seed) const {
+    TrainingOptions options = training;
+    options.learning_rate = config.learning_rate;
+    std::unique_ptr<NeuralNetwork> network = createNetwork(config, seed);
+    network->train(features_, labels_, train, options);
+    
+    Eigen::MatrixXf inputs = features_(Eigen::all, validation);
+    Eigen::VectorXf labels = labels_(validation);
+    Eigen::VectorXf scores = network->predictBatch(inputs);
+    return {BinaryMetrics::auc(scores, labels), BinaryMetrics::logLoss(scores, labels),
+            BinaryMetrics::accuracy(scores, labels)};
+}
+
+std::unique_ptr<NeuralNetwork> HyperparameterSweep::trainFinal(const SweepConfig& config,
+                                                               const TrainingOptions& training) const {
+    TrainingOptions options = training;
+    options.learning_rate = config.learning_rate;
+    std::unique_ptr<NeuralNetwork> network = createNetwork(config, training.seed ? training.seed : std::random_device{}());
+    
+    std::vector<Eigen::Index> samples(features_.cols());
+    std::iota(samples.begin(), samples.end(), 0);
+    network->train(features_, labels_, samples, options);
+    return network;
+}
+
+bool HyperparameterSweep::parseLayers(const std::string& text, std::vector<std::vector<int>>& layers) {
+    layers.clear();
+    std::istringstream configs(text);
+    std::string config;
+    while (std::getline(configs, config, ';')) {
+        std::vector<int> sizes;
+        std::istringstream values(config);
+        std::string value;
+        while (std::getline(values, value, ',')) {
+            try {
+                int size = std::stoi(value);
+                if (size <= 0) {
+                    return false;
+                }
+                sizes.push_back(size);
+            } catch (const std::exception&) {
+                return false;
+            }
+        }
+        layers.push_back(sizes);
+    }
+    return !layers.empty();
+}
+
+void HyperparameterSweep::printTable(const std::vector<SweepResult>& results, std::ostream& out) {
+    // The caller's formatting is restored afterwards
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::left << std::setw(6) << "rank" << std::setw(28) << "configuration"
+        << std::right << std::setw(10) << "AUC" << std::setw(10) << "+/-"
+        << std::setw(10) << "loss" << std::setw(10) << "accuracy" << "\n";
+    out << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& result = results[i];
+        out << std::left << std::setw(6) << (i + 1) << std::setw(28) << result.config.describe()
+            << std::right << std::setw(10) << result.auc << std::setw(10) << result.auc_stddev
+            << std::setw(10) << result.loss << std::setw(10) << result.accuracy << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
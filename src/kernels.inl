@@ -0,0 +1,180 @@
+// Kernel bodies shared by every kernels_<level>.cpp. Each of those files
+// includes this one inside its own namespace and is compiled with its own
+// instruction set flags, so the code here must stay portable C++ that the
+// compiler can vectorize: no intrinsics, and no calls to inline functions or
+// templates from headers (std::min, std::max, ...). A header inline would be
+// instantiated in every variant and the linker could keep the AVX-512 copy
+// for all of them. Everything is static for the same reason.
+//
+// Floating-point kernels are compiled with contraction off and never
+// reassociate a sum, so every variant rounds exactly like the scalar one.
+// They are also compiled without trapping math, which lets selects be
+// vectorized; nothing here relies on floating-point exceptions.
+
+static void histogramU8(const uint8_t* data, size_t size, uint32_t* counts) {
+    // Four partial histograms, so runs of equal bytes do not serialize on
+    // one counter's store-to-load latency
+    uint32_t partial[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        ++partial[0][data[i]];
+        ++partial[1][data[i + 1]];
+        ++partial[2][data[i + 2]];
+        ++partial[3][data[i + 3]];
+    }
+    for (; i < size; ++i) {
+        ++partial[0][data[i]];
+    }
+    for (int v = 0; v < 256; ++v) {
+        counts[v] += partial[0][v] + partial[1][v] + partial[2][v] + partial[3][v];
+    }
+}
+
+static void histogramF32(const float* data, size_t size, int bins, uint32_t* counts) {
+    // Bin indices are computed a block at a time, which vectorizes; only the
+    // increments are scalar
+    const float scale = static_cast<float>(bins - 1);
+    const int last = bins - 1;
+    int index[64];
+    for (size_t begin = 0; begin < size; begin += 64) {
+        const size_t block = size - begin < 64 ? size - begin : 64;
+        for (size_t i = 0; i < block; ++i) {
+            int bin = static_cast<int>(data[begin + i] * scale);
+            bin = bin < 0 ? 0 : bin;
+            index[i] = bin > last ? last : bin;
+        }
+        for (size_t i = 0; i < block; ++i) {
+            ++counts[index[i]];
+        }
+    }
+}
+
+static void momentsF32(const float* data, size_t size, double* sum, double* sum_sq) {
+    // Eight partial sums combined in a fixed order: the vector width decides
+    // how many of them advance at once, never how the total is rounded
+    double partial[8] = {}, partial_sq[8] = {};
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        for (int k = 0; k < 8; ++k) {
+            const double value = data[i + k];
+            partial[k] += value;
+            partial_sq[k] += value * value;
+        }
+    }
+    for (; i < size; ++i) {
+        const double value = data[i];
+        partial[0] += value;
+        partial_sq[0] += value * value;
+    }
+    double total = 0.0, total_sq = 0.0;
+    for (int k = 0; k < 8; ++k) {
+        total += partial[k];
+        total_sq += partial_sq[k];
+    }
+    *sum += total;
+    *sum_sq += total_sq;
+}
+
+static void glcmRow(const uint8_t* above, const uint8_t* row, size_t begin, size_t end,
+                    int sign, int32_t* counts, double* sum_sq) {
+    // (c + s)^2 - c^2 = 2sc + 1 for s = +-1; summed exactly in integers and
+    // added once per row
+    const size_t levels = 256;
+    int64_t delta[4] = {};
+    for (size_t x = begin; x < end; ++x) {
+        const size_t i = row[x];
+        const size_t neighbors[4] = {row[x + 1], above[x + 1], above[x], above[x - 1]};
+        for (int angle = 0; angle < 4; ++angle) {
+            int32_t& count = counts[(angle * levels + i) * levels + neighbors[angle]];
+            delta[angle] += 2 * static_cast<int64_t>(sign) * count + 1;
+            count += sign;
+        }
+    }
+    for (int angle = 0; angle < 4; ++angle) {
+        sum_sq[angle] += static_cast<double>(delta[angle]);
+    }
+}
+
+static void relu(float* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = data[i] > 0.0f ? data[i] : 0.0f;
+    }
+}
+
+// exp(x) from the Cephes single-precision polynomial, within 2 ulp of the
+// true value. Branch-free so the sigmoid loop vectorizes without a libm call.
+static inline float expPolynomial(float x) {
+    x = x < -87.3f ? -87.3f : x;
+    x = x > 88.3f ? 88.3f : x;
+
+    // x = n ln2 + r with |r| <= ln2 / 2; ln2 is split so n ln2 stays exact.
+    // n = floor(t) by truncating t + 128, which is positive after the clamp
+    const float t = x * 1.44269504088896341f + 0.5f;
+    const int n = static_cast<int>(t + 128.0f) - 128;
+    const float fn = static_cast<float>(n);
+    float r = x - fn * 0.693359375f;
+    r = r - fn * -2.12194440e-4f;
+
+    float y = 1.9875691500e-4f;
+    y = y * r + 1.3981999507e-3f;
+    y = y * r + 8.3334519073e-3f;
+    y = y * r + 4.1665795894e-2f;
+    y = y * r + 1.6666665459e-1f;
+    y = y * r + 5.0000001201e-1f;
+    y = y * (r * r) + r + 1.0f;
+
+    // 2^n straight into the exponent field; n is within [-126, 127] here
+    const int32_t bits = (n + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return y * scale;
+}
+
+static void sigmoid(float* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = 1.0f / (1.0f + expPolynomial(-data[i]));
+    }
+}
+
+static void gemv(const float* weights, size_t rows, size_t cols, const float* x, float* y) {
+    for (size_t r = 0; r < rows; ++r) {
+        y[r] = 0.0f;
+    }
+
+    // Four columns per sweep over y; each y[r] still adds its terms in
+    // column order, so the result does not depend on the vector width
+    size_t c = 0;
+    for (; c + 4 <= cols; c += 4) {
+        const float* w0 = weights + c * rows;
+        const float* w1 = w0 + rows;
+        const float* w2 = w1 + rows;
+        const float* w3 = w2 + rows;
+        const float x0 = x[c], x1 = x[c + 1], x2 = x[c + 2], x3 = x[c + 3];
+        for (size_t r = 0; r < rows; ++r) {
+            float sum = y[r] + w0[r] * x0;
+            sum = sum + w1[r] * x1;
+            sum = sum + w2[r] * x2;
+            y[r] = sum + w3[r] * x3;
+        }
+    }
+    for (; c < cols; ++c) {
+        const float* w = weights + c * rows;
+        const float xc = x[c];
+        for (size_t r = 0; r < rows; ++r) {
+            y[r] = y[r] + w[r] * xc;
+        }
+    }
+}
+
+static CpuKernels makeKernels(CpuLevel level) {
+    CpuKernels kernels;
+    kernels.level = level;
+    kernels.histogram_u8 = histogramU8;
+    kernels.histogram_f32 = histogramF32;
+    kernels.moments_f32 = momentsF32;
+    kernels.glcm_row = glcmRow;
+    kernels.relu = relu;
+    kernels.sigmoid = sigmoid;
+    kernels.gemv = gemv;
+    return kernels;
+}
@@ -0,0 +1,23 @@
+// AVX2 build of the kernels in kernels.inl (-mavx2, /arch:AVX2). Only called
+// once cpuid has confirmed AVX2 and OS support for the YMM state.
+#include "../include/cpu_dispatch.h"
+#include <cstring>
+
+#if defined(__AVX2__)
+
+namespace kernels_avx2 {
+#include "kernels.inl"
+} // namespace kernels_avx2
+
+const CpuKernels* avx2Kernels() {
+    static const CpuKernels kernels = kernels_avx2::makeKernels(CpuLevel::AVX2);
+    return &kernels;
+}
+
+#else
+
+const CpuKernels* avx2Kernels() {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,23 @@
+// AVX-512 build of the kernels in kernels.inl (F, BW, DQ and VL;
+// /arch:AVX512 on MSVC). Only called once cpuid and XCR0 confirm all of them.
+#include "../include/cpu_dispatch.h"
+#include <cstring>
+
+#if defined(__AVX512F__)
+
+namespace kernels_avx512 {
+#include "kernels.inl"
+} // namespace kernels_avx512
+
+const CpuKernels* avx512Kernels() {
+    static const CpuKernels kernels = kernels_avx512::makeKernels(CpuLevel::AVX512);
+    return &kernels;
+}
+
+#else
+
+const CpuKernels* avx512Kernels() {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,13 @@
+// Scalar reference build of the kernels in kernels.inl. CMake compiles this
+// file with vectorization off; every other level is checked against it.
+#include "../include/cpu_dispatch.h"
+#include <cstring>
+
+namespace kernels_scalar {
+#include "kernels.inl"
+} // namespace kernels_scalar
+
+const CpuKernels* scalarKernels() {
+    static const CpuKernels kernels = kernels_scalar::makeKernels(CpuLevel::Scalar);
+    return &kernels;
+}
@@ -0,0 +1,23 @@
+// SSE 4.2 build of the kernels in kernels.inl (-msse4.2). Compilers that
+// cannot target it leave the level out.
+#include "../include/cpu_dispatch.h"
+#include <cstring>
+
+#if defined(__SSE4_2__)
+
+namespace kernels_sse42 {
+#include "kernels.inl"
+} // namespace kernels_sse42
+
+const CpuKernels* sse42Kernels() {
+    static const CpuKernels kernels = kernels_sse42::makeKernels(CpuLevel::SSE42);
+    return &kernels;
+}
+
+#else
+
+const CpuKernels* sse42Kernels() {
+    return nullptr;
+}
+
+#endif
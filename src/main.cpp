@@ -1,64 +1,420 @@
 #include "../include/ai_detector.h"
+#include "../include/batch_scanner.h"
+#include "../include/binary_metrics.h"
+#include "../include/cpu_dispatch.h"
+#include "../include/profiler.h"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <string>
 #include <filesystem>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+// Command-line arguments split into positional arguments and "--name value" options
+struct CommandLine {
+    std::vector<std::string> args;
+    std::map<std::string, std::string> options;
+    
+    bool has(const std::string& name) const { return options.count(name) > 0; }
+    std::string get(const std::string& name, const std::string& fallback = "") const {
+        auto it = options.find(name);
+        return it != options.end() ? it->second : fallback;
+    }
+    int getInt(const std::string& name, int fallback) const {
+        return has(name) ? std::stoi(get(name)) : fallback;
+    }
+    // "on"/"off" switches
+    bool getSwitch(const std::string& name, bool fallback) const {
+        if (!has(name)) {
+            return fallback;
+        }
+        std::string value = get(name);
+        return value == "on" || value == "1" || value == "true";
+    }
+};
+
+CommandLine parseCommandLine(int argc, char* argv[]) {
+    CommandLine cl;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) == 0 && arg.size() > 2) {
+            std::string name = arg.substr(2);
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for option --" + name);
+            }
+            cl.options[name] = argv[++i];
+        } else {
+            cl.args.push_back(arg);
+        }
+    }
+    return cl;
+}
+
+// Verdict thresholds on the detection confidence
+constexpr float LIKELY_AI_THRESHOLD = 0.7f;
+constexpr float POSSIBLY_AI_THRESHOLD = 0.3f;
 
 void printUsage() {
     std::cout << "AI Content Detector\n";
     std::cout << "Usage:\n";
     std::cout << "  ai_detector detect-image <image_path> [model_path]\n";
     std::cout << "  ai_detector detect-video <video_path> [model_path]\n";
-    std::cout << "  ai_detector train <training_data_path> <output_model_path>\n";
+    std::cout << "  ai_detector detect-stream <source|-> [model_path] [stream options]\n";
+    std::cout << "  ai_detector train <training_data_path|dataset_dir> <output_model_path>\n";
+    std::cout << "                    [--epochs <n>] [--batch-size <n>] [--learning-rate <f>]\n";
+    std::cout << "                    [--shuffle-buffer <n>] [--seed <n>]\n";
+    std::cout << "                    [--checkpoint-every <n>] [--checkpoint-dir <dir>] [--resume on]\n";
+    std::cout << "                    [--cascade <file>] [cascade options]\n";
+    std::cout << "  ai_detector sweep <training_data_path|dataset_dir> <best_model_path>\n";
+    std::cout << "                    [--layers <a,b,..;c,..>] [--learning-rates <f,..>]\n";
+    std::cout << "                    [--folds <k>] [--holdout <f>] [training options]\n";
+    std::cout << "  ai_detector build-dataset <training_data_path> <dataset_dir>\n";
+    std::cout << "                    [--encoding f32|f16|i8] [--shard-size <n>]\n";
+    std::cout << "  ai_detector evaluate <labeled_dir> <model_path> [--thresholds <f,..>]\n";
+    std::cout << "                    [--roc <csv>] [ensemble options] [cascade options]\n";
+    std::cout << "  ai_detector prune <model_path> <output_model_path> [--sparsity <f>]\n";
+    std::cout << "                    [--calibration <image_dir>] [--dead-neurons on|off]\n";
+    std::cout << "  ai_detector batch <input_dir> <output_dir> [model_path] [--shard <i/N>]\n";
+    std::cout << "                    [--chunk <n>] [video options]\n";
+    std::cout << "  ai_detector merge <output_dir> <merged_tsv>\n";
+    std::cout << "  ai_detector export-cpp <model_path> <output_header> [--namespace <name>]\n";
+    std::cout << "  ai_detector verify-kernels\n";
     std::cout << "  ai_detector help\n\n";
+    std::cout << "Video options:\n";
+    std::cout << "  --segments <n>  Decode and analyze the video in n parallel segments\n";
+    std::cout << "  --motion <tier> Optical flow: full, pyramid, sparse or block (default: full)\n";
+    std::cout << "  --adaptive <n>  Sample coarse-to-fine and stop early once the verdict is\n";
+    std::cout << "                  clear, deciding on no fewer than n frames\n";
+    std::cout << "  --shots <n>     Detect shot boundaries in a cheap pre-pass and analyze\n";
+    std::cout << "                  at most n representative frames per shot (not with --adaptive)\n";
+    std::cout << "  --max-frames <n> Frame cap for adaptive and shot sampling (default: 30)\n";
+    std::cout << "  --incremental on  Recompute frame features only for image blocks that\n";
+    std::cout << "                  changed since the previous frame\n";
+    std::cout << "  --segment-cache <dir> Keep per-segment features and analyzer samples in dir;\n";
+    std::cout << "                  later runs decode only segments that are not cached yet\n";
+    std::cout << "                  (not with --adaptive, --shots or --deadline-ms)\n";
+    std::cout << "  --cache-stride <n> Source frames between cached samples (default: 15)\n";
+    std::cout << "  --cache-segment <n> Samples per cached segment (default: 8)\n\n";
+    std::cout << "Near-duplicate options (detect-image):\n";
+    std::cout << "  --dedup-distance <b> Reuse the score of a previously scored image whose\n";
+    std::cout << "                  perceptual hashes differ by at most b bits (default: 6)\n";
+    std::cout << "  --dedup-index <file> Near-duplicate index snapshot, loaded before and saved\n";
+    std::cout << "                  after the run; enables the index\n";
+    std::cout << "  --dedup-capacity <n> Images kept in the index (default: 100000)\n\n";
+    std::cout << "Deadline option (detect-image, detect-video):\n";
+    std::cout << "  --deadline-ms <t> Finish within t ms: skip or downgrade the costliest stages\n";
+    std::cout << "                  (GLCM, full-size FFT, optical flow, frame count) as time\n";
+    std::cout << "                  runs out and print which ones ran degraded\n\n";
+    std::cout << "Ensemble options (detect-image, detect-video, evaluate):\n";
+    std::cout << "  --models <a,b>  Score with these models next to the primary one, sharing\n";
+    std::cout << "                  one feature extraction\n";
+    std::cout << "  --weights <w,..> Weight per extra model (default: 1); 0 = shadow model,\n";
+    std::cout << "                  reported but not part of the verdict\n";
+    std::cout << "  --combine <how> Combined score: mean (weighted), max or min (default: mean)\n\n";
+    std::cout << "Cascade options (detect-image, evaluate, batch; train fits one):\n";
+    std::cout << "  --cascade <file> Stage-1 model on the statistical and color features; images\n";
+    std::cout << "                  it scores outside its band skip the other feature families\n";
+    std::cout << "                  and the full model (train: where the fitted cascade goes)\n";
+    std::cout << "  --max-accuracy-loss <f> Accuracy the early exits may cost against the full\n";
+    std::cout << "                  model when the band is chosen (default: 0.005); evaluate\n";
+    std::cout << "                  re-chooses the band on the labeled set and saves it\n";
+    std::cout << "  --cascade-layers <a,b> Hidden layers of the stage-1 model (default: 32)\n";
+    std::cout << "  --cascade-holdout <f> Training samples kept back to choose the band\n";
+    std::cout << "                  (default: 0.2)\n\n";
+    std::cout << "General options (any command):\n";
+    std::cout << "  --threads <n>   Worker threads for all parallel work (default:\n";
+    std::cout << "                  AI_DETECTOR_THREADS, else one per hardware thread)\n";
+    std::cout << "  --profile on    Print per-stage latency percentiles when done\n";
+    std::cout << "  --metrics <file> Write metrics in Prometheus text format\n";
+    std::cout << "                  (refreshed with every rolling score in detect-stream)\n";
+    std::cout << "  --trace <file>  Write a Chrome trace-event JSON of every timed stage\n\n";
     std::cout << "Commands:\n";
     std::cout << "  detect-image  - Detect AI-generated content in an image\n";
     std::cout << "  detect-video  - Detect AI-generated content in a video\n";
+    std::cout << "  detect-stream - Score raw frames from stdin or a FIFO over a sliding window\n";
     std::cout << "  train         - Train the model with labeled data\n";
+    std::cout << "  sweep         - Cross-validate many network shapes and learning rates in\n";
+    std::cout << "                  parallel on one shared feature set, save the best\n";
+    std::cout << "  build-dataset - Extract training features once into a sharded dataset\n";
+    std::cout << "  evaluate      - Score a labeled set in parallel and report AUC, precision and\n";
+    std::cout << "                  recall, calibration error, throughput and stage latencies\n";
+    std::cout << "  prune         - Zero the weakest weight blocks (default: 70%), remove dead\n";
+    std::cout << "                  neurons and save a model that runs on sparse kernels\n";
+    std::cout << "  batch         - Scan every image and video under a directory tree, one\n";
+    std::cout << "                  shard per process, resuming where an interrupted run stopped\n";
+    std::cout << "  merge         - Concatenate the shard results of a batch scan and print\n";
+    std::cout << "                  aggregate statistics\n";
+    std::cout << "  export-cpp    - Write a model as a self-contained C++ header to compile into\n";
+    std::cout << "                  a binary (default namespace: ai_detector_model)\n";
+    std::cout << "  verify-kernels - Check every SIMD kernel build this CPU supports against the\n";
+    std::cout << "                  scalar reference (AI_DETECTOR_CPU=scalar|sse4.2|avx2|avx512\n";
+    std::cout << "                  caps the level used for everything else)\n";
     std::cout << "  help          - Show this help message\n\n";
+    std::cout << "Batch options:\n";
+    std::cout << "  --shard <i/N>   Scan only the files whose relative path hashes to shard i\n";
+    std::cout << "                  of N (default: 0/1); run one process per shard\n";
+    std::cout << "  --chunk <n>     Files scored between manifest updates (default: 256)\n\n";
+    std::cout << "Stream options:\n";
+    std::cout << "  --format <fmt>  y4m (default), bgr or i420\n";
+    std::cout << "  --width <w> --height <h>  Frame size for bgr and i420\n";
+    std::cout << "  --window <n>    Frames in the sliding window (default: 30)\n";
+    std::cout << "  --every <k>     Emit a rolling score every k analyzed frames (default: 15)\n";
+    std::cout << "  --budget-ms <t> Drop frames that waited longer than t ms (default: 250)\n";
+    std::cout << "  --motion <tier> Optical flow tier, as for detect-video\n";
+    std::cout << "  --incremental on  Reuse unchanged image blocks, as for detect-video\n\n";
     std::cout << "Examples:\n";
     std::cout << "  ai_detector detect-image sample.jpg\n";
     std::cout << "  ai_detector detect-video sample.mp4\n";
     std::cout << "  ai_detector detect-image sample.jpg model.bin\n";
+    std::cout << "  ai_detector detect-image sample.jpg prod.bin --models candidate.bin --weights 0\n";
+    std::cout << "  ffmpeg -i rtsp://cam -f yuv4mpegpipe - | ai_detector detect-stream -\n";
     std::cout << "  ai_detector train training_data/ model.bin\n";
+    std::cout << "  ai_detector build-dataset training_data/ features/ --encoding i8\n";
+    std::cout << "  ai_detector train features/ model.bin --epochs 50\n";
+    std::cout << "  ai_detector train features/ model.bin --epochs 50 --resume on\n";
+    std::cout << "  ai_detector evaluate holdout/ model.bin --roc roc.csv\n";
+    std::cout << "  ai_detector train features/ model.bin --cascade model.cascade\n";
+    std::cout << "  ai_detector evaluate holdout/ model.bin --cascade model.cascade --max-accuracy-loss 0.01\n";
+}
+
+// Worker threads for the detector's pool; 0 defers to AI_DETECTOR_THREADS
+size_t threadOption(const CommandLine& cl) {
+    return static_cast<size_t>(std::max(0, cl.getInt("threads", 0)));
 }
 
-void detectImage(const std::string& image_path, const std::string& model_path = "") {
-    AIDetector detector;
+// Per-request time budget, starting now; no limit without --deadline-ms
+Deadline deadlineOption(const CommandLine& cl) {
+    return Deadline(cl.has("deadline-ms") ? std::stod(cl.get("deadline-ms")) : 0.0);
+}
+
+// Enable the profiler if any of its outputs was requested
+void startProfiling(const CommandLine& cl) {
+    if (cl.getSwitch("profile", false) || cl.has("metrics") || cl.has("trace")) {
+        Profiler::enable(cl.has("trace"));
+    }
+}
+
+// Print and write the requested profiler outputs
+void finishProfiling(const CommandLine& cl) {
+    if (!Profiler::enabled()) {
+        return;
+    }
+    if (cl.getSwitch("profile", false)) {
+        Profiler::printSummary(std::cout);
+    }
+    if (cl.has("metrics") && !Profiler::writePrometheus(cl.get("metrics"))) {
+        std::cerr << "Failed to write metrics: " << cl.get("metrics") << std::endl;
+    }
+    if (cl.has("trace") && !Profiler::writeChromeTrace(cl.get("trace"))) {
+        std::cerr << "Failed to write trace: " << cl.get("trace") << std::endl;
+    }
+}
+
+// Apply --motion if given; false if the tier name is unknown
+bool applyMotionOption(AIDetector& detector, const CommandLine& cl) {
+    if (!cl.has("motion")) {
+        return true;
+    }
+    MotionQuality quality;
+    if (!MotionEngine::parseQuality(cl.get("motion"), quality)) {
+        std::cerr << "Unknown motion tier: " << cl.get("motion") << std::endl;
+        return false;
+    }
+    detector.setMotionQuality(quality);
+    return true;
+}
+
+// Split a comma-separated option value
+std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t end = value.find(',', start);
+        if (end == std::string::npos) {
+            end = value.size();
+        }
+        if (end > start) {
+            items.push_back(value.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+// Apply --models, --weights and --combine; false on a bad value or model
+bool applyEnsembleOptions(AIDetector& detector, const CommandLine& cl) {
+    if (cl.has("combine")) {
+        EnsembleCombine combine;
+        if (!ModelEnsemble::parseCombine(cl.get("combine"), combine)) {
+            std::cerr << "Unknown combine mode: " << cl.get("combine") << std::endl;
+            return false;
+        }
+        detector.setEnsembleCombine(combine);
+    }
+    
+    std::vector<std::string> models = splitList(cl.get("models"));
+    std::vector<std::string> weights = splitList(cl.get("weights"));
+    if (weights.size() > models.size()) {
+        std::cerr << "More --weights than --models given" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < models.size(); ++i) {
+        float weight = i < weights.size() ? std::stof(weights[i]) : 1.0f;
+        if (!detector.addModel(models[i], weight)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Enable the near-duplicate index if --dedup-distance or --dedup-index is
+// given, loading the --dedup-index snapshot when it exists
+void applyDuplicateOptions(AIDetector& detector, const CommandLine& cl) {
+    if (!cl.has("dedup-distance") && !cl.has("dedup-index")) {
+        return;
+    }
+    NearDuplicateOptions options;
+    options.max_distance = cl.getInt("dedup-distance", options.max_distance);
+    options.capacity = static_cast<size_t>(std::max(1, cl.getInt("dedup-capacity", static_cast<int>(options.capacity))));
+    detector.enableNearDuplicateIndex(options);
+    
+    std::string snapshot = cl.get("dedup-index");
+    if (!snapshot.empty() && std::filesystem::exists(snapshot)) {
+        detector.loadNearDuplicateIndex(snapshot);
+    }
+}
+
+// Load the --cascade file, if one was named; false if it cannot be used
+bool applyCascadeOption(AIDetector& detector, const CommandLine& cl) {
+    if (!cl.has("cascade")) {
+        return true;
+    }
+    if (!detector.loadCascade(cl.get("cascade"))) {
+        std::cerr << "Failed to load cascade: " << cl.get("cascade") << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Print the share of images the cascade's first stage decided
+void printCascadeExits(const AIDetector& detector, const CommandLine& cl) {
+    CascadeCounts counts = detector.cascadeCounts();
+    if (!cl.has("cascade") || counts.early_exits + counts.full_model == 0) {
+        return;
+    }
+    std::cout << "Cascade early exits: " << std::fixed << std::setprecision(1)
+              << (counts.exitFraction() * 100.0f) << "% of " << (counts.early_exits + counts.full_model)
+              << " images" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+// Write the --dedup-index snapshot, if one was named
+void saveDuplicateIndex(const AIDetector& detector, const CommandLine& cl) {
+    if (cl.has("dedup-index") && !detector.saveNearDuplicateIndex(cl.get("dedup-index"))) {
+        std::cerr << "Failed to save near-duplicate index: " << cl.get("dedup-index") << std::endl;
+    }
+}
+
+void detectImage(const std::string& image_path, const std::string& model_path, const CommandLine& cl) {
+    AIDetector detector(threadOption(cl));
     
     if (!detector.initialize(model_path)) {
         std::cerr << "Failed to initialize detector" << std::endl;
         return;
     }
+    if (!applyEnsembleOptions(detector, cl) || !applyCascadeOption(detector, cl)) {
+        return;
+    }
+    applyDuplicateOptions(detector, cl);
     
     std::cout << "Analyzing image: " << image_path << std::endl;
-    float confidence = detector.detectImage(image_path);
+    QualityReport quality;
+    ModelScores scores = detector.scoreImageModels(image_path, deadlineOption(cl), quality);
+    float confidence = scores.combined;
     
     if (confidence < 0) {
         std::cerr << "Failed to analyze image" << std::endl;
         return;
     }
     
+    if (scores.scores.size() > 1) {
+        for (size_t i = 0; i < scores.scores.size(); ++i) {
+            std::cout << "Model " << scores.names[i] << ": " << (scores.scores[i] * 100) << "%" << std::endl;
+        }
+    }
     std::cout << "AI Detection Confidence: " << (confidence * 100) << "%" << std::endl;
+    if (scores.early_exit) {
+        std::cout << "Decided by the cascade's first stage" << std::endl;
+    }
+    if (scores.duplicate_distance >= 0) {
+        std::cout << "Near-duplicate of a previously scored image (" << scores.duplicate_distance
+                  << " bits apart); cached score" << std::endl;
+    }
+    if (cl.has("deadline-ms")) {
+        std::cout << "Quality: " << quality.describe() << std::endl;
+    }
+    saveDuplicateIndex(detector, cl);
     
-    if (confidence > 0.7f) {
+    if (confidence > LIKELY_AI_THRESHOLD) {
         std::cout << "Result: Likely AI-generated content" << std::endl;
-    } else if (confidence > 0.3f) {
+    } else if (confidence > POSSIBLY_AI_THRESHOLD) {
         std::cout << "Result: Possibly AI-generated content" << std::endl;
     } else {
         std::cout << "Result: Likely real content" << std::endl;
     }
 }
 
-void detectVideo(const std::string& video_path, const std::string& model_path = "") {
-    AIDetector detector;
+void detectVideo(const std::string& video_path, const std::string& model_path, const CommandLine& cl) {
+    AIDetector detector(threadOption(cl));
     
     if (!detector.initialize(model_path)) {
         std::cerr << "Failed to initialize detector" << std::endl;
         return;
     }
     
+    if (!applyEnsembleOptions(detector, cl)) {
+        return;
+    }
+    
+    detector.setVideoSegments(cl.getInt("segments", 1));
+    detector.setIncrementalFeatures(cl.getSwitch("incremental", false));
+    
+    if (!applyMotionOption(detector, cl)) {
+        return;
+    }
+    
+    if (cl.has("adaptive")) {
+        AdaptiveSampling adaptive;
+        adaptive.enabled = true;
+        adaptive.min_frames = cl.getInt("adaptive", adaptive.min_frames);
+        adaptive.max_frames = cl.getInt("max-frames", adaptive.max_frames);
+        detector.setAdaptiveSampling(adaptive);
+    }
+    
+    if (cl.has("shots")) {
+        ShotSampling shots;
+        shots.enabled = true;
+        shots.frames_per_shot = cl.getInt("shots", shots.frames_per_shot);
+        shots.max_frames = cl.getInt("max-frames", shots.max_frames);
+        detector.setShotSampling(shots);
+    }
+    
+    if (cl.has("segment-cache")) {
+        SegmentCaching caching;
+        caching.enabled = true;
+        caching.directory = cl.get("segment-cache");
+        caching.frame_stride = cl.getInt("cache-stride", caching.frame_stride);
+        caching.segment_samples = cl.getInt("cache-segment", caching.segment_samples);
+        detector.setSegmentCaching(caching);
+    }
+    
     std::cout << "Analyzing video: " << video_path << std::endl;
-    float confidence = detector.detectVideo(video_path);
+    VideoAnalysis analysis = detector.analyzeVideo(video_path, deadlineOption(cl));
+    float confidence = analysis.score;
     
     if (confidence < 0) {
         std::cerr << "Failed to analyze video" << std::endl;
@@ -66,90 +422,586 @@ void detectVideo(const std::string& video_path, const std::string& model_path =
     }
     
     std::cout << "AI Detection Confidence: " << (confidence * 100) << "%" << std::endl;
+    std::cout << "Frames analyzed: " << analysis.frames_used
+              << (analysis.stopped_early ? " (stopped early)" : "") << std::endl;
+    if (analysis.shots > 0) {
+        std::cout << "Shots detected: " << analysis.shots << std::endl;
+    }
+    if (analysis.segments > 0) {
+        std::cout << "Segments reused from cache: " << analysis.segments_reused
+                  << " of " << analysis.segments << std::endl;
+    }
+    if (cl.has("deadline-ms")) {
+        std::cout << "Quality: " << analysis.quality.describe() << std::endl;
+    }
     
-    if (confidence > 0.7f) {
+    if (confidence > LIKELY_AI_THRESHOLD) {
         std::cout << "Result: Likely AI-generated content" << std::endl;
-    } else if (confidence > 0.3f) {
+    } else if (confidence > POSSIBLY_AI_THRESHOLD) {
         std::cout << "Result: Possibly AI-generated content" << std::endl;
     } else {
         std::cout << "Result: Likely real content" << std::endl;
     }
 }
 
-void trainModel(const std::string& training_data_path, const std::string& output_model_path) {
-    AIDetector detector;
+void detectStream(const std::string& source, const std::string& model_path, const CommandLine& cl) {
+    StreamFormat format = StreamFormat::Y4M;
+    if (cl.has("format") && !FrameReader::parseFormat(cl.get("format"), format)) {
+        std::cerr << "Unknown stream format: " << cl.get("format") << std::endl;
+        return;
+    }
+    
+    AIDetector detector(threadOption(cl));
+    
+    if (!detector.initialize(model_path)) {
+        std::cerr << "Failed to initialize detector" << std::endl;
+        return;
+    }
+    
+    if (!applyMotionOption(detector, cl)) {
+        return;
+    }
+    
+    FrameReader reader;
+    if (!reader.open(source, format, cl.getInt("width", 0), cl.getInt("height", 0))) {
+        std::cerr << "Failed to open stream" << std::endl;
+        return;
+    }
+    
+    StreamOptions options;
+    options.window = cl.getInt("window", options.window);
+    options.emit_every = cl.getInt("every", options.emit_every);
+    options.latency_budget_ms = cl.getInt("budget-ms", options.latency_budget_ms);
+    options.incremental_features = cl.getSwitch("incremental", options.incremental_features);
+    
+    std::cout << "Analyzing stream: " << (source == "-" ? "stdin" : source)
+              << " (" << reader.width() << "x" << reader.height() << ")" << std::endl;
+    
+    // Long-running: refresh the metrics file with every rolling score
+    std::string metrics_path = cl.get("metrics");
+    detector.detectStream(reader, options, [&metrics_path](const StreamScore& result) {
+        std::cout << "frame " << result.frame_number
+                  << " score " << (result.score * 100) << "%"
+                  << " window " << result.window_frames
+                  << " analyzed " << result.analyzed
+                  << " dropped " << result.dropped
+                  << " latency " << result.latency_ms << "ms" << std::endl;
+        if (!metrics_path.empty()) {
+            Profiler::writePrometheus(metrics_path);
+        }
+    });
+}
+
+// Training options shared by train and sweep
+TrainingOptions trainingOptions(const CommandLine& cl) {
+    TrainingOptions options;
+    options.epochs = cl.getInt("epochs", options.epochs);
+    options.batch_size = static_cast<size_t>(std::max(1, cl.getInt("batch-size", static_cast<int>(options.batch_size))));
+    options.learning_rate = cl.has("learning-rate") ? std::stof(cl.get("learning-rate")) : options.learning_rate;
+    options.shuffle_buffer = static_cast<size_t>(std::max(1, cl.getInt("shuffle-buffer", static_cast<int>(options.shuffle_buffer))));
+    options.seed = static_cast<uint32_t>(cl.getInt("seed", 0));
+    return options;
+}
+
+// Cascade fitting options for train; false on a bad value
+bool cascadeOptions(const CommandLine& cl, CascadeOptions& options) {
+    options.output_path = cl.get("cascade");
+    options.training = trainingOptions(cl);
+    options.holdout = cl.has("cascade-holdout") ? std::stof(cl.get("cascade-holdout")) : options.holdout;
+    options.max_accuracy_loss = cl.has("max-accuracy-loss") ? std::stof(cl.get("max-accuracy-loss"))
+                                                            : options.max_accuracy_loss;
+    if (cl.has("cascade-layers")) {
+        std::vector<std::vector<int>> layers;
+        if (!HyperparameterSweep::parseLayers(cl.get("cascade-layers"), layers) || layers.size() != 1) {
+            std::cerr << "Invalid --cascade-layers: " << cl.get("cascade-layers") << std::endl;
+            return false;
+        }
+        options.hidden_layers = layers[0];
+    }
+    return true;
+}
+
+bool trainModel(const std::string& training_data_path, const std::string& output_model_path, const CommandLine& cl) {
+    AIDetector detector(threadOption(cl));
     
     std::cout << "Training model with data from: " << training_data_path << std::endl;
     std::cout << "Output model will be saved to: " << output_model_path << std::endl;
     
-    if (!detector.train(training_data_path, output_model_path)) {
+    TrainingOptions options = trainingOptions(cl);
+    options.checkpoint_dir = cl.get("checkpoint-dir", output_model_path + ".checkpoints");
+    options.checkpoint_every = static_cast<size_t>(std::max(0, cl.getInt("checkpoint-every", static_cast<int>(options.checkpoint_every))));
+    options.resume = cl.getSwitch("resume", false);
+    
+    CascadeOptions cascade;
+    if (cl.has("cascade") && !cascadeOptions(cl, cascade)) {
+        return false;
+    }
+    
+    if (!detector.train(training_data_path, output_model_path, options, cl.has("cascade") ? &cascade : nullptr)) {
         std::cerr << "Failed to train model" << std::endl;
-        return;
+        return false;
     }
     
     std::cout << "Training completed successfully!" << std::endl;
     std::cout << "Model saved to: " << output_model_path << std::endl;
+    if (cl.has("cascade")) {
+        std::cout << "Cascade saved to: " << cascade.output_path << std::endl;
+    }
+    return true;
+}
+
+bool sweepModels(const std::string& training_data_path, const std::string& output_model_path, const CommandLine& cl) {
+    SweepOptions options;
+    options.training = trainingOptions(cl);
+    options.folds = cl.getInt("folds", options.folds);
+    options.holdout = cl.has("holdout") ? std::stof(cl.get("holdout")) : options.holdout;
+    
+    std::vector<std::vector<int>> layers;
+    if (!HyperparameterSweep::parseLayers(cl.get("layers", "256,128,64"), layers)) {
+        std::cerr << "Invalid --layers: " << cl.get("layers") << std::endl;
+        return false;
+    }
+    for (const auto& hidden : layers) {
+        for (const auto& rate : splitList(cl.get("learning-rates", "0.01"))) {
+            SweepConfig config;
+            config.hidden_layers = hidden;
+            config.learning_rate = std::stof(rate);
+            options.configs.push_back(config);
+        }
+    }
+    
+    AIDetector detector(threadOption(cl));
+    if (!detector.sweep(training_data_path, output_model_path, options)) {
+        std::cerr << "Sweep failed" << std::endl;
+        return false;
+    }
+    std::cout << "Best model saved to: " << output_model_path << std::endl;
+    return true;
+}
+
+bool buildDataset(const std::string& training_data_path, const std::string& dataset_path, const CommandLine& cl) {
+    FeatureEncoding encoding = FeatureEncoding::F16;
+    if (cl.has("encoding") && !FeatureDataset::parseEncoding(cl.get("encoding"), encoding)) {
+        std::cerr << "Unknown feature encoding: " << cl.get("encoding") << std::endl;
+        return false;
+    }
+    
+    AIDetector detector(threadOption(cl));
+    size_t shard_size = static_cast<size_t>(std::max(1, cl.getInt("shard-size", 16384)));
+    if (!detector.buildDataset(training_data_path, dataset_path, encoding, shard_size)) {
+        std::cerr << "Failed to build dataset" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool evaluateModel(const std::string& labeled_dir, const std::string& model_path, const CommandLine& cl) {
+    AIDetector detector(threadOption(cl));
+    
+    if (!detector.initialize(model_path)) {
+        std::cerr << "Failed to initialize detector" << std::endl;
+        return false;
+    }
+    if (!applyEnsembleOptions(detector, cl) || !applyCascadeOption(detector, cl)) {
+        return false;
+    }
+    
+    // Choosing the band scores every image with both stages, before the timed run
+    if (cl.has("cascade") && cl.has("max-accuracy-loss")) {
+        CascadeReport report;
+        std::cout << "Choosing the cascade band on: " << labeled_dir << std::endl;
+        if (!detector.tuneCascade(labeled_dir, std::stof(cl.get("max-accuracy-loss")), report) ||
+            !detector.saveCascade(cl.get("cascade"))) {
+            std::cerr << "Failed to tune cascade" << std::endl;
+            return false;
+        }
+        report.print(std::cout);
+        std::cout << "Cascade saved to: " << cl.get("cascade") << std::endl;
+    }
+    
+    std::vector<float> thresholds;
+    for (const auto& value : splitList(cl.get("thresholds"))) {
+        thresholds.push_back(std::stof(value));
+    }
+    if (thresholds.empty()) {
+        thresholds = {POSSIBLY_AI_THRESHOLD, LIKELY_AI_THRESHOLD};
+    }
+    
+    // Stage latencies are part of the report
+    if (!Profiler::enabled()) {
+        Profiler::enable();
+    }
+    
+    std::cout << "Evaluating on: " << labeled_dir << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    Eigen::VectorXf scores;
+    Eigen::VectorXf labels;
+    if (!detector.scoreLabeledImages(labeled_dir, scores, labels)) {
+        std::cerr << "Evaluation failed" << std::endl;
+        return false;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    Eigen::Index positives = (labels.array() > 0.5f).count();
+    std::cout << "Images: " << scores.size() << " (" << positives << " AI-generated, "
+              << (scores.size() - positives) << " real)" << std::endl;
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "AUC: " << BinaryMetrics::auc(scores, labels) << std::endl;
+    std::cout << "Log loss: " << BinaryMetrics::logLoss(scores, labels) << std::endl;
+    std::cout << "Calibration error (ECE, 10 bins): " << BinaryMetrics::calibrationError(scores, labels) << std::endl;
+    
+    std::cout << std::setw(10) << "threshold" << std::setw(11) << "precision" << std::setw(10) << "recall"
+              << std::setw(10) << "FPR" << std::setw(10) << "accuracy" << "\n";
+    for (float threshold : thresholds) {
+        ThresholdMetrics metrics = BinaryMetrics::atThreshold(scores, labels, threshold);
+        std::cout << std::setw(10) << metrics.threshold << std::setw(11) << metrics.precision
+                  << std::setw(10) << metrics.recall << std::setw(10) << metrics.false_positive_rate
+                  << std::setw(10) << metrics.accuracy << "\n";
+    }
+    std::cout << std::setprecision(1) << "Throughput: " << (scores.size() / seconds) << " images/sec ("
+              << std::setprecision(2) << seconds << " s on " << detector.threadCount() << " threads)" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+    printCascadeExits(detector, cl);
+    
+    if (cl.has("roc")) {
+        std::ofstream roc(cl.get("roc"));
+        roc << "threshold,true_positive_rate,false_positive_rate\n";
+        for (const RocPoint& point : BinaryMetrics::roc(scores, labels)) {
+            roc << point.threshold << "," << point.true_positive_rate << "," << point.false_positive_rate << "\n";
+        }
+        if (!roc) {
+            std::cerr << "Failed to write ROC curve: " << cl.get("roc") << std::endl;
+            return false;
+        }
+    }
+    
+    // --profile prints the same table when the command finishes
+    if (!cl.getSwitch("profile", false)) {
+        Profiler::printSummary(std::cout);
+    }
+    return true;
+}
+
+bool batchScan(const std::string& input_dir, const std::string& output_dir, const std::string& model_path,
+               const CommandLine& cl) {
+    BatchOptions options;
+    if (cl.has("shard") && !ShardSpec::parse(cl.get("shard"), options.shard)) {
+        std::cerr << "Invalid --shard, expected i/N: " << cl.get("shard") << std::endl;
+        return false;
+    }
+    options.chunk = static_cast<size_t>(std::max(1, cl.getInt("chunk", static_cast<int>(options.chunk))));
+    options.possibly_threshold = POSSIBLY_AI_THRESHOLD;
+    options.likely_threshold = LIKELY_AI_THRESHOLD;
+    
+    AIDetector detector(threadOption(cl));
+    if (!detector.initialize(model_path)) {
+        std::cerr << "Failed to initialize detector" << std::endl;
+        return false;
+    }
+    if (!applyEnsembleOptions(detector, cl) || !applyCascadeOption(detector, cl) ||
+        !applyMotionOption(detector, cl)) {
+        return false;
+    }
+    detector.setVideoSegments(cl.getInt("segments", 1));
+    
+    BatchScanner scanner(detector, options);
+    bool scanned = scanner.run(input_dir, output_dir);
+    if (!scanned) {
+        std::cerr << "Batch scan failed" << std::endl;
+    }
+    printCascadeExits(detector, cl);
+    return scanned;
+}
+
+bool mergeResults(const std::string& results_dir, const std::string& merged_path) {
+    BatchOptions options;
+    options.possibly_threshold = POSSIBLY_AI_THRESHOLD;
+    options.likely_threshold = LIKELY_AI_THRESHOLD;
+    
+    BatchSummary summary;
+    if (!BatchScanner::merge(results_dir, merged_path, options, summary)) {
+        std::cerr << "Merge failed" << std::endl;
+        return false;
+    }
+    std::cout << "Merged results: " << merged_path << std::endl;
+    summary.print(std::cout);
+    return true;
+}
+
+bool exportModel(const std::string& model_path, const std::string& header_path, const CommandLine& cl) {
+    AIDetector detector(threadOption(cl));
+    
+    if (!detector.initialize(model_path)) {
+        std::cerr << "Failed to initialize detector" << std::endl;
+        return false;
+    }
+    
+    if (!detector.exportModelCpp(header_path, cl.get("namespace", "ai_detector_model"))) {
+        std::cerr << "Failed to export model" << std::endl;
+        return false;
+    }
+    
+    std::cout << "Model exported to: " << header_path << std::endl;
+    return true;
+}
+
+bool pruneModel(const std::string& model_path, const std::string& output_model_path, const CommandLine& cl) {
+    AIDetector detector(threadOption(cl));
+    
+    if (!detector.initialize(model_path)) {
+        std::cerr << "Failed to initialize detector" << std::endl;
+        return false;
+    }
+    
+    PruneOptions options;
+    options.sparsity = cl.has("sparsity") ? std::stof(cl.get("sparsity")) : options.sparsity;
+    options.remove_dead_neurons = cl.getSwitch("dead-neurons", options.remove_dead_neurons);
+    
+    if (!detector.pruneModel(output_model_path, options, cl.get("calibration"))) {
+        std::cerr << "Failed to prune model" << std::endl;
+        return false;
+    }
+    
+    std::cout << "Pruned model saved to: " << output_model_path << std::endl;
+    return true;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
+    CommandLine cl;
+    try {
+        cl = parseCommandLine(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    if (cl.args.empty()) {
         printUsage();
         return 1;
     }
     
-    std::string command = argv[1];
+    // Rejected before any command runs, so a typo fails the run
+    MotionQuality motion_quality;
+    if (cl.has("motion") && !MotionEngine::parseQuality(cl.get("motion"), motion_quality)) {
+        std::cerr << "Error: Unknown motion tier: " << cl.get("motion") << std::endl;
+        return 1;
+    }
+    
+    std::string command = cl.args[0];
+    int arg_count = static_cast<int>(cl.args.size()) + 1;
+    startProfiling(cl);
     
     try {
         if (command == "detect-image") {
-            if (argc < 3) {
+            if (arg_count < 3) {
                 std::cerr << "Error: Image path required" << std::endl;
                 printUsage();
                 return 1;
             }
             
-            std::string image_path = argv[2];
-            std::string model_path = (argc > 3) ? argv[3] : "";
+            std::string image_path = cl.args[1];
+            std::string model_path = (arg_count > 3) ? cl.args[2] : "";
             
             if (!std::filesystem::exists(image_path)) {
                 std::cerr << "Error: Image file not found: " << image_path << std::endl;
                 return 1;
             }
             
-            detectImage(image_path, model_path);
+            detectImage(image_path, model_path, cl);
             
         } else if (command == "detect-video") {
-            if (argc < 3) {
+            if (arg_count < 3) {
                 std::cerr << "Error: Video path required" << std::endl;
                 printUsage();
                 return 1;
             }
             
-            std::string video_path = argv[2];
-            std::string model_path = (argc > 3) ? argv[3] : "";
+            std::string video_path = cl.args[1];
+            std::string model_path = (arg_count > 3) ? cl.args[2] : "";
             
             if (!std::filesystem::exists(video_path)) {
                 std::cerr << "Error: Video file not found: " << video_path << std::endl;
                 return 1;
             }
             
-            detectVideo(video_path, model_path);
+            if (cl.has("adaptive") && cl.has("shots")) {
+                std::cerr << "Error: --adaptive and --shots cannot be combined" << std::endl;
+                return 1;
+            }
+            
+            detectVideo(video_path, model_path, cl);
+            
+        } else if (command == "detect-stream") {
+            if (arg_count < 3) {
+                std::cerr << "Error: Stream source required (use - for stdin)" << std::endl;
+                printUsage();
+                return 1;
+            }
+            
+            std::string source = cl.args[1];
+            std::string model_path = (arg_count > 3) ? cl.args[2] : "";
+            
+            detectStream(source, model_path, cl);
             
         } else if (command == "train") {
-            if (argc < 4) {
+            if (arg_count < 4) {
+                std::cerr << "Error: Training data path and output model path required" << std::endl;
+                printUsage();
+                return 1;
+            }
+            
+            std::string training_data_path = cl.args[1];
+            std::string output_model_path = cl.args[2];
+            
+            if (!std::filesystem::exists(training_data_path)) {
+                std::cerr << "Error: Training data path not found: " << training_data_path << std::endl;
+                return 1;
+            }
+            
+            if (!trainModel(training_data_path, output_model_path, cl)) {
+                return 1;
+            }
+            
+        } else if (command == "sweep") {
+            if (arg_count < 4) {
                 std::cerr << "Error: Training data path and output model path required" << std::endl;
                 printUsage();
                 return 1;
             }
             
-            std::string training_data_path = argv[2];
-            std::string output_model_path = argv[3];
+            std::string training_data_path = cl.args[1];
+            std::string output_model_path = cl.args[2];
             
             if (!std::filesystem::exists(training_data_path)) {
                 std::cerr << "Error: Training data path not found: " << training_data_path << std::endl;
                 return 1;
             }
             
-            trainModel(training_data_path, output_model_path);
+            if (!sweepModels(training_data_path, output_model_path, cl)) {
+                return 1;
+            }
+            
+        } else if (command == "evaluate") {
+            if (arg_count < 4) {
+                std::cerr << "Error: Labeled data path and model path required" << std::endl;
+                printUsage();
+                return 1;
+            }
+            
+            std::string labeled_dir = cl.args[1];
+            std::string model_path = cl.args[2];
+            
+            if (!std::filesystem::exists(labeled_dir)) {
+                std::cerr << "Error: Labeled data path not found: " << labeled_dir << std::endl;
+                return 1;
+            }
+            
+            if (!evaluateModel(labeled_dir, model_path, cl)) {
+                return 1;
+            }
+            
+        } else if (command == "build-dataset") {
+            if (arg_count < 4) {
+                std::cerr << "Error: Training data path and dataset directory required" << std::endl;
+                printUsage();
+                return 1;
+            }
+            
+            std::string training_data_path = cl.args[1];
+            std::string dataset_path = cl.args[2];
+            
+            if (!std::filesystem::exists(training_data_path)) {
+                std::cerr << "Error: Training data path not found: " << training_data_path << std::endl;
+                return 1;
+            }
+            
+            if (!buildDataset(training_data_path, dataset_path, cl)) {
+                return 1;
+            }
+            
+        } else if (command == "prune") {
+            if (arg_count < 4) {
+                std::cerr << "Error: Model path and output model path required" << std::endl;
+                printUsage();
+                return 1;
+            }
+            
+            std::string model_path = cl.args[1];
+            std::string output_model_path = cl.args[2];
+            
+            if (!std::filesystem::exists(model_path)) {
+                std::cerr << "Error: Model file not found: " << model_path << std::endl;
+                return 1;
+            }
+            
+            if (!pruneModel(model_path, output_model_path, cl)) {
+                return 1;
+            }
+            
+        } else if (command == "batch") {
+            if (arg_count < 4) {
+                std::cerr << "Error: Input directory and output directory required" << std::endl;
+                printUsage();
+                return 1;
+            }
+            
+            std::string input_dir = cl.args[1];
+            std::string output_dir = cl.args[2];
+            std::string model_path = (arg_count > 4) ? cl.args[3] : "";
+            
+            if (!std::filesystem::is_directory(input_dir)) {
+                std::cerr << "Error: Input directory not found: " << input_dir << std::endl;
+                return 1;
+            }
+            
+            if (!batchScan(input_dir, output_dir, model_path, cl)) {
+                return 1;
+            }
+            
+        } else if (command == "merge") {
+            if (arg_count < 4) {
+                std::cerr << "Error: Batch output directory and merged file path required" << std::endl;
+                printUsage();
+                return 1;
+            }
+            
+            std::string results_dir = cl.args[1];
+            std::string merged_path = cl.args[2];
+            
+            if (!std::filesystem::is_directory(results_dir)) {
+                std::cerr << "Error: Batch output directory not found: " << results_dir << std::endl;
+                return 1;
+            }
+            
+            if (!mergeResults(results_dir, merged_path)) {
+                return 1;
+            }
+            
+        } else if (command == "export-cpp") {
+            if (arg_count < 4) {
+                std::cerr << "Error: Model path and output header path required" << std::endl;
+                printUsage();
+                return 1;
+            }
+            
+            std::string model_path = cl.args[1];
+            std::string header_path = cl.args[2];
+            
+            if (!std::filesystem::exists(model_path)) {
+                std::cerr << "Error: Model file not found: " << model_path << std::endl;
+                return 1;
+            }
+            
+            if (!exportModel(model_path, header_path, cl)) {
+                return 1;
+            }
+            
+        } else if (command == "verify-kernels") {
+            if (!verifyKernels(std::cout)) {
+                std::cerr << "Error: SIMD kernels disagree with the scalar reference" << std::endl;
+                return 1;
+            }
             
         } else if (command == "help") {
             printUsage();
@@ -165,5 +1017,6 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    finishProfiling(cl);
     return 0;
 } 
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "../include/model_ensemble.h"
+#include "../include/profiler.h"
+#include "../include/scratch_arena.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+ModelEnsemble::ModelEnsemble() : combine_(EnsembleCombine::Mean), thread_pool_(nullptr) {}
+
+bool ModelEnsemble::addModel(const std::string& path, float weight) {
+    auto network = std::make_unique<NeuralNetwork>();
+    if (!network->loadModel(path) || network->layerCount() == 0) {
+        std::cerr << "Failed to load model: " << path << std::endl;
+        return false;
+    }
+    network->setThreadPool(thread_pool_);
+    
+    if (!addNetwork(network.get(), std::filesystem::path(path).stem().string(), weight)) {
+        return false;
+    }
+    members_.back().owned = std::move(network);
+    return true;
+}
+
+bool ModelEnsemble::addNetwork(const NeuralNetwork* network, const std::string& name, float weight) {
+    if (!network || network->layerCount() == 0) {
+        std::cerr << "Model " << name << " is not initialized" << std::endl;
+        return false;
+    }
+    if (!members_.empty() && network->inputSize() != inputSize()) {
+        std::cerr << "Model " << name << " expects " << network->inputSize()
+                  << " features, the ensemble uses " << inputSize() << std::endl;
+        return false;
+    }
+    
+    members_.push_back({nullptr, network, name, std::max(0.0f, weight), 0});
+    refresh();
+    return true;
+}
+
+void ModelEnsemble::refresh() {
+    Eigen::Index rows = 0;
+    for (auto& member : members_) {
+        member.first_row = rows;
+        rows += member.network->layerWeights(0).rows();
+    }
+    
+    stacked_weights_.resize(rows, inputSize());
+    stacked_biases_.resize(rows);
+    for (const auto& member : members_) {
+        const Eigen::MatrixXf& weights = member.network->layerWeights(0);
+        stacked_weights_.middleRows(member.first_row, weights.rows()) = weights;
+        stacked_biases_.segment(member.first_row, weights.rows()) = member.network->layerBiases(0);
+    }
+}
+
+bool ModelEnsemble::parseCombine(const std::string& name, EnsembleCombine& combine) {
+    if (name == "mean") {
+        combine = EnsembleCombine::Mean;
+    } else if (name == "max") {
+        combine = EnsembleCombine::Max;
+    } else if (name == "min") {
+        combine = EnsembleCombine::Min;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Eigen::MatrixXf ModelEnsemble::predictBatch(const Eigen::MatrixXf& inputs) const {
+    ScopedTimer timer(ProfileStage::Forward);
+    if (members_.empty()) {
+        throw std::runtime_error("Ensemble has no models");
+    }
+    
+    const Eigen::Index batch = inputs.cols();
+    size_t tasks = 1;
+    if (thread_pool_) {
+        tasks = std::min(thread_pool_->size(), static_cast<size_t>(batch / MIN_COLUMNS_PER_TASK));
+    }
+    if (tasks <= 1) {
+        return predictColumns(inputs);
+    }
+    
+    // Same column split as NeuralNetwork::predictBatch
+    Eigen::MatrixXf scores(members_.size(), batch);
+    std::vector<std::future<void>> pending;
+    for (size_t t = 0; t < tasks; ++t) {
+        Eigen::Index begin = batch * t / tasks;
+        Eigen::Index count = batch * (t + 1) / tasks - begin;
+        pending.push_back(thread_pool_->submit([this, &inputs, &scores, begin, count]() {
+            scores.middleCols(begin, count) = predictColumns(inputs.middleCols(begin, count));
+        }));
+    }
+    for (auto& future : pending) {
+        thread_pool_->wait(future);
+    }
+    return scores;
+}
+
+Eigen::MatrixXf ModelEnsemble::predictColumns(const Eigen::Ref<const Eigen::MatrixXf>& inputs) const {
+    // One GEMM evaluates the first layer of every member
+    ScratchScope scope;
+    const Eigen::Index batch = inputs.cols();
+    Eigen::Map<Eigen::MatrixXf> first(ScratchArena::local().floats(stacked_weights_.rows() * batch),
+                                      stacked_weights_.rows(), batch);
+    first.noalias() = stacked_weights_ * inputs;
+    first.colwise() += stacked_biases_;
+    
+    Eigen::MatrixXf scores(members_.size(), batch);
+    for (size_t m = 0; m < members_.size(); ++m) {
+        const Member& member = members_[m];
+        Eigen::Index rows = member.network->layerWeights(0).rows();
+        scores.row(m) = member.network->predictFromLayer(0, first.middleRows(member.first_row, rows)).transpose();
+    }
+    return scores;
+}
+
+Eigen::VectorXf ModelEnsemble::combine(const Eigen::MatrixXf& scores) const {
+    Eigen::VectorXf combined(scores.cols());
+    for (Eigen::Index c = 0; c < scores.cols(); ++c) {
+        float total_weight = 0.0f;
+        float sum = 0.0f;
+        float best = combine_ == EnsembleCombine::Min ? 1.0f : 0.0f;
+        for (size_t m = 0; m < members_.size(); ++m) {
+            float weight = members_[m].weight;
+            if (weight <= 0.0f) {
+                continue;
+            }
+            float score = scores(m, c);
+            total_weight += weight;
+            sum += weight * score;
+            best = combine_ == EnsembleCombine::Min ? std::min(best, score) : std::max(best, score);
+        }
+        
+        if (total_weight <= 0.0f) {
+            combined(c) = 0.5f; // Only shadow models: neutral score
+        } else {
+            combined(c) = combine_ == EnsembleCombine::Mean ? sum / total_weight : best;
+        }
+    }
+    return combined;
+}
+
+uint64_t ModelEnsemble::fingerprint() const {
+    uint64_t hash = 1469598103934665603ull ^ static_cast<uint64_t>(combine_);
+    for (const auto& member : members_) {
+        uint32_t weight_bits;
+        std::memcpy(&weight_bits, &member.weight, sizeof(weight_bits));
+        hash = (hash ^ member.network->fingerprint()) * 1099511628211ull;
+        hash = (hash ^ weight_bits) * 1099511628211ull;
+    }
+    return hash;
+}
+
+ModelScores ModelEnsemble::score(const Eigen::VectorXf& features) const {
+    ModelScores result;
+    Eigen::MatrixXf scores = predictBatch(features);
+    for (size_t m = 0; m < members_.size(); ++m) {
+        result.names.push_back(members_[m].name);
+        result.scores.push_back(scores(m, 0));
+    }
+    result.combined = combine(scores)(0);
+    return result;
+}
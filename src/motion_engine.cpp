@@ -0,0 +1,200 @@
+#include "../include/motion_engine.h"
+#include "../include/profiler.h"
+#include "../include/scratch_arena.h"
+#include <cmath>
+#include <limits>
+#include <cstdlib>
+#include <algorithm>
+
+namespace {
+
+// Running sum/sum-of-squares accumulator for flow magnitudes
+struct MagnitudeAccumulator {
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    size_t count = 0;
+
+    void add(double magnitude) {
+        sum += magnitude;
+        sum_sq += magnitude * magnitude;
+        ++count;
+    }
+
+    double mean() const { return count > 0 ? sum / count : 0.0; }
+    double stddev() const {
+        if (count == 0) {
+            return 0.0;
+        }
+        double m = mean();
+        return std::sqrt(std::max(0.0, sum_sq / count - m * m));
+    }
+};
+
+} // namespace
+
+MotionEngine::MotionEngine(MotionQuality quality) : quality_(quality) {}
+
+bool MotionEngine::parseQuality(const std::string& name, MotionQuality& quality) {
+    if (name == "full") {
+        quality = MotionQuality::Full;
+    } else if (name == "pyramid") {
+        quality = MotionQuality::Pyramid;
+    } else if (name == "sparse") {
+        quality = MotionQuality::Sparse;
+    } else if (name == "block") {
+        quality = MotionQuality::Block;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+cv::Mat MotionEngine::prepareFrame(const cv::Mat& frame) const {
+    cv::Mat gray;
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+    } else {
+        gray = frame;
+    }
+
+    // Dense and block tiers work on a downscaled level; LK builds its own pyramid
+    int levels = 0;
+    if (quality_ == MotionQuality::Pyramid) {
+        levels = PYRAMID_LEVELS;
+    } else if (quality_ == MotionQuality::Block) {
+        levels = 1;
+    }
+    for (int i = 0; i < levels; ++i) {
+        cv::pyrDown(gray, gray);
+    }
+
+    return gray;
+}
+
+FlowStats MotionEngine::calculateFlowStats(const cv::Mat& prev, const cv::Mat& next) const {
+    ScopedTimer timer(ProfileStage::OpticalFlow);
+    ScratchScope scope;
+    switch (quality_) {
+        case MotionQuality::Pyramid:
+            return denseFlowStats(prev, next);
+        case MotionQuality::Sparse:
+            return sparseFlowStats(prev, next);
+        case MotionQuality::Block:
+            return blockFlowStats(prev, next);
+        case MotionQuality::Full:
+        default:
+            return denseFlowStats(prev, next);
+    }
+}
+
+float MotionEngine::calculateUniformity(const cv::Mat& prev, const cv::Mat& next) const {
+    return uniformity(calculateFlowStats(prev, next));
+}
+
+float MotionEngine::uniformity(const FlowStats& stats) {
+    // AI-generated videos often have more uniform motion patterns
+    double variation = stats.stddev / (stats.mean + 1e-6);
+    return 1.0f - static_cast<float>(std::min(variation, 1.0));
+}
+
+FlowStats MotionEngine::denseFlowStats(const cv::Mat& prev, const cv::Mat& next) const {
+    // Fewer pyramid levels are needed once the input is already downscaled
+    int levels = (quality_ == MotionQuality::Pyramid) ? 1 : 3;
+    int window = (quality_ == MotionQuality::Pyramid) ? 9 : 15;
+
+    cv::Mat flow;
+    cv::calcOpticalFlowFarneback(prev, next, flow, 0.5, levels, window, 3, 5, 1.2, 0);
+
+    return flowMagnitudeStats(flow);
+}
+
+FlowStats MotionEngine::sparseFlowStats(const cv::Mat& prev, const cv::Mat& next) const {
+    std::vector<cv::Point2f> points;
+    for (int y = GRID_STEP / 2; y < prev.rows; y += GRID_STEP) {
+        for (int x = GRID_STEP / 2; x < prev.cols; x += GRID_STEP) {
+            points.emplace_back(static_cast<float>(x), static_cast<float>(y));
+        }
+    }
+
+    FlowStats stats;
+    if (points.empty()) {
+        return stats;
+    }
+
+    std::vector<cv::Point2f> tracked;
+    std::vector<uchar> status;
+    std::vector<float> error;
+    cv::calcOpticalFlowPyrLK(prev, next, points, tracked, status, error,
+                             cv::Size(15, 15), 3,
+                             cv::TermCriteria(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, 20, 0.03));
+
+    MagnitudeAccumulator acc;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (!status[i]) {
+            continue;
+        }
+        double dx = tracked[i].x - points[i].x;
+        double dy = tracked[i].y - points[i].y;
+        acc.add(std::sqrt(dx * dx + dy * dy));
+    }
+
+    stats.mean = acc.mean();
+    stats.stddev = acc.stddev();
+    return stats;
+}
+
+FlowStats MotionEngine::blockFlowStats(const cv::Mat& prev, const cv::Mat& next) const {
+    MagnitudeAccumulator acc;
+
+    for (int by = SEARCH_RANGE; by + BLOCK_SIZE + SEARCH_RANGE <= prev.rows; by += BLOCK_SIZE) {
+        for (int bx = SEARCH_RANGE; bx + BLOCK_SIZE + SEARCH_RANGE <= prev.cols; bx += BLOCK_SIZE) {
+            int best_sad = std::numeric_limits<int>::max();
+            int best_dx = 0;
+            int best_dy = 0;
+
+            for (int dy = -SEARCH_RANGE; dy <= SEARCH_RANGE; ++dy) {
+                for (int dx = -SEARCH_RANGE; dx <= SEARCH_RANGE; ++dx) {
+                    int sad = 0;
+                    for (int y = 0; y < BLOCK_SIZE && sad <= best_sad; ++y) {
+                        const uchar* p = prev.ptr<uchar>(by + y) + bx;
+                        const uchar* n = next.ptr<uchar>(by + y + dy) + bx + dx;
+                        for (int x = 0; x < BLOCK_SIZE; ++x) {
+                            sad += std::abs(static_cast<int>(p[x]) - static_cast<int>(n[x]));
+                        }
+                    }
+
+                    // Prefer the shortest vector among equal matches
+                    if (sad < best_sad ||
+                        (sad == best_sad && dx * dx + dy * dy < best_dx * best_dx + best_dy * best_dy)) {
+                        best_sad = sad;
+                        best_dx = dx;
+                        best_dy = dy;
+                    }
+                }
+            }
+
+            acc.add(std::sqrt(static_cast<double>(best_dx * best_dx + best_dy * best_dy)));
+        }
+    }
+
+    FlowStats stats;
+    stats.mean = acc.mean();
+    stats.stddev = acc.stddev();
+    return stats;
+}
+
+FlowStats MotionEngine::flowMagnitudeStats(const cv::Mat& flow) {
+    MagnitudeAccumulator acc;
+
+    for (int y = 0; y < flow.rows; ++y) {
+        const cv::Vec2f* row = flow.ptr<cv::Vec2f>(y);
+        for (int x = 0; x < flow.cols; ++x) {
+            acc.add(std::sqrt(row[x][0] * row[x][0] + row[x][1] * row[x][1]));
+        }
+    }
+
+    FlowStats stats;
+    stats.mean = acc.mean();
+    stats.stddev = acc.stddev();
+    return stats;
+}
@@ -0,0 +1,267 @@
+#include "../include/near_duplicate_index.h"
+#include "../include/file_io.h"
+#include "../include/profiler.h"
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+PerceptualHash PerceptualHash::compute(const cv::Mat& image) {
+    ScopedTimer timer(ProfileStage::PerceptualHash);
+    cv::Mat gray;
+    if (image.channels() == 3) {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    } else if (image.channels() == 4) {
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    } else {
+        gray = image;
+    }
+
+    PerceptualHash hash;
+
+    // pHash: low frequencies above or below their median
+    cv::Mat thumbnail, spectrum;
+    cv::resize(gray, thumbnail, cv::Size(32, 32), 0, 0, cv::INTER_AREA);
+    thumbnail.convertTo(thumbnail, CV_32F);
+    cv::dct(thumbnail, spectrum);
+    float coefficients[64];
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            coefficients[y * 8 + x] = spectrum.at<float>(y, x);
+        }
+    }
+    float sorted[64];
+    std::copy(std::begin(coefficients), std::end(coefficients), sorted);
+    std::nth_element(sorted, sorted + 32, sorted + 64);
+    const float median = sorted[32];
+    for (int i = 0; i < 64; ++i) {
+        if (coefficients[i] > median) {
+            hash.phash |= 1ull << i;
+        }
+    }
+
+    // dHash: does brightness rise to the right
+    cv::Mat small;
+    cv::resize(gray, small, cv::Size(9, 8), 0, 0, cv::INTER_AREA);
+    small.convertTo(small, CV_32F);
+    for (int y = 0; y < 8; ++y) {
+        const float* row = small.ptr<float>(y);
+        for (int x = 0; x < 8; ++x) {
+            if (row[x + 1] > row[x]) {
+                hash.dhash |= 1ull << (y * 8 + x);
+            }
+        }
+    }
+    return hash;
+}
+
+int PerceptualHash::distance(uint64_t a, uint64_t b) {
+    return static_cast<int>(std::bitset<64>(a ^ b).count());
+}
+
+NearDuplicateIndex::NearDuplicateIndex(const NearDuplicateOptions& options)
+    : options_(options), fingerprint_(0), next_id_(0) {
+    options_.max_distance = std::min(std::max(options_.max_distance, 0), MAX_DISTANCE_LIMIT);
+    options_.capacity = std::max<size_t>(options_.capacity, 1);
+
+    // max_distance + 1 ranges of near-equal width
+    const int ranges = options_.max_distance + 1;
+    for (int r = 0; r <= ranges; ++r) {
+        range_start_.push_back(64 * r / ranges);
+    }
+    tables_.resize(ranges);
+}
+
+uint64_t NearDuplicateIndex::rangeKey(uint64_t phash, size_t range) const {
+    const int width = range_start_[range + 1] - range_start_[range];
+    const uint64_t mask = width >= 64 ? ~0ull : (1ull << width) - 1;
+    return (phash >> range_start_[range]) & mask;
+}
+
+bool NearDuplicateIndex::lookup(const PerceptualHash& hash, ModelScores& scores, int* distance) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Candidates share at least one range exactly; one may turn up in several tables
+    const Entry* best = nullptr;
+    int best_distance = 0;
+    for (size_t range = 0; range < tables_.size(); ++range) {
+        auto bucket = tables_[range].find(rangeKey(hash.phash, range));
+        if (bucket == tables_[range].end()) {
+            continue;
+        }
+        for (uint64_t id : bucket->second) {
+            const Entry& entry = entries_.at(id);
+            int phash_distance = PerceptualHash::distance(hash.phash, entry.hash.phash);
+            if (phash_distance > options_.max_distance ||
+                PerceptualHash::distance(hash.dhash, entry.hash.dhash) > options_.max_distance) {
+                continue;
+            }
+            if (!best || phash_distance < best_distance) {
+                best = &entry;
+                best_distance = phash_distance;
+            }
+        }
+    }
+    if (!best) {
+        Profiler::count(ProfileCounter::DuplicateMisses, 1);
+        return false;
+    }
+
+    scores.names = names_;
+    scores.scores = best->scores;
+    scores.combined = best->combined;
+    if (distance) {
+        *distance = best_distance;
+    }
+    recent_.splice(recent_.begin(), recent_, best->recent);
+    Profiler::count(ProfileCounter::DuplicateHits, 1);
+    return true;
+}
+
+void NearDuplicateIndex::insert(const PerceptualHash& hash, const ModelScores& scores) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (scores.names != names_) {
+        // Another set of models; nothing stored so far is comparable
+        clearLocked();
+        names_ = scores.names;
+    }
+    insertLocked(hash, scores.scores, scores.combined);
+}
+
+void NearDuplicateIndex::insertLocked(const PerceptualHash& hash, const std::vector<float>& scores, float combined) {
+    while (entries_.size() >= options_.capacity) {
+        evictLocked(recent_.back());
+    }
+
+    const uint64_t id = next_id_++;
+    recent_.push_front(id);
+    Entry& entry = entries_[id];
+    entry.hash = hash;
+    entry.scores = scores;
+    entry.combined = combined;
+    entry.recent = recent_.begin();
+    for (size_t range = 0; range < tables_.size(); ++range) {
+        tables_[range][rangeKey(hash.phash, range)].push_back(id);
+    }
+}
+
+void NearDuplicateIndex::evictLocked(uint64_t id) {
+    auto entry = entries_.find(id);
+    for (size_t range = 0; range < tables_.size(); ++range) {
+        auto bucket = tables_[range].find(rangeKey(entry->second.hash.phash, range));
+        auto& ids = bucket->second;
+        ids.erase(std::find(ids.begin(), ids.end(), id));
+        if (ids.empty()) {
+            tables_[range].erase(bucket);
+        }
+    }
+    recent_.erase(entry->second.recent);
+    entries_.erase(entry);
+}
+
+void NearDuplicateIndex::setModel(uint64_t fingerprint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fingerprint != fingerprint_) {
+        clearLocked();
+        fingerprint_ = fingerprint;
+    }
+}
+
+size_t NearDuplicateIndex::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void NearDuplicateIndex::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clearLocked();
+}
+
+void NearDuplicateIndex::clearLocked() {
+    entries_.clear();
+    for (auto& table : tables_) {
+        table.clear();
+    }
+    recent_.clear();
+    names_.clear();
+}
+
+bool NearDuplicateIndex::save(const std::string& path) const {
+    std::ostringstream out(std::ios::binary);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.write(MAGIC, sizeof(MAGIC));
+        put(out, VERSION);
+        put(out, fingerprint_);
+        put(out, static_cast<uint64_t>(names_.size()));
+        for (const auto& name : names_) {
+            putString(out, name);
+        }
+
+        // Oldest first, so loading in file order rebuilds the same recency
+        put(out, static_cast<uint64_t>(entries_.size()));
+        for (auto id = recent_.rbegin(); id != recent_.rend(); ++id) {
+            const Entry& entry = entries_.at(*id);
+            put(out, entry.hash.phash);
+            put(out, entry.hash.dhash);
+            put(out, entry.combined);
+            out.write(reinterpret_cast<const char*>(entry.scores.data()), entry.scores.size() * sizeof(float));
+        }
+    }
+
+    return writeSnapshot(path, out.str(), "near-duplicate index");
+}
+
+bool NearDuplicateIndex::load(const std::string& path) {
+    std::string data;
+    SnapshotStatus status = readSnapshot(path, data);
+    if (status == SnapshotStatus::Missing) {
+        return false;
+    }
+
+    std::istringstream in(data, std::ios::binary);
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t fingerprint = 0, name_count = 0;
+    if (status != SnapshotStatus::Ok ||
+        !in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !get(in, version) || version != VERSION || !get(in, fingerprint) ||
+        !get(in, name_count) || name_count > 1024) {
+        std::cerr << "Ignoring damaged near-duplicate index: " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fingerprint != fingerprint_) {
+        std::cerr << "Ignoring near-duplicate index of another model: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> names(name_count);
+    for (auto& name : names) {
+        if (!getString(in, name, MAX_NAME)) {
+            return false;
+        }
+    }
+    uint64_t count = 0;
+    if (!get(in, count)) {
+        return false;
+    }
+
+    clearLocked();
+    names_ = names;
+    std::vector<float> scores(name_count);
+    for (uint64_t i = 0; i < count; ++i) {
+        PerceptualHash hash;
+        float combined = 0.0f;
+        if (!get(in, hash.phash) || !get(in, hash.dhash) || !get(in, combined) ||
+            !in.read(reinterpret_cast<char*>(scores.data()), scores.size() * sizeof(float))) {
+            clearLocked();
+            return false;
+        }
+        // Over capacity the oldest entries are evicted as newer ones load
+        insertLocked(hash, scores, combined);
+    }
+    return true;
+}
@@ -1,11 +1,22 @@
 #include "../include/neural_network.h"
+#include "../include/checkpointer.h"
+#include "../include/cpu_dispatch.h"
+#include "../include/feature_dataset.h"
+#include "../include/profiler.h"
+#include "../include/scratch_arena.h"
 #include <iostream>
 #include <fstream>
 #include <random>
 #include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <sstream>
 
-NeuralNetwork::NeuralNetwork() : learning_rate_(0.01f) {
+NeuralNetwork::NeuralNetwork() : thread_pool_(nullptr), learning_rate_(0.01f) {
     rng_.seed(std::random_device{}());
 }
 
@@ -16,6 +27,8 @@ void NeuralNetwork::initialize(const std::vector<int>& layer_sizes) {
     
     weights_.clear();
     biases_.clear();
+    feature_defaults_.resize(0);
+    sparse_weights_.assign(layer_sizes.size() - 1, BlockSparseMatrix());
     
     // Initialize weights and biases for each layer
     for (size_t i = 0; i < layer_sizes.size() - 1; ++i) {
@@ -45,6 +58,7 @@ void NeuralNetwork::initialize(const std::vector<int>& layer_sizes) {
 }
 
 Eigen::VectorXf NeuralNetwork::forward(const Eigen::VectorXf& input) {
+    ScopedTimer timer(ProfileStage::Forward);
     if (weights_.empty()) {
         throw std::runtime_error("Network not initialized");
     }
@@ -55,7 +69,9 @@ Eigen::VectorXf NeuralNetwork::forward(const Eigen::VectorXf& input) {
     // Forward pass through all layers
     for (size_t i = 0; i < weights_.size(); ++i) {
         // Linear transformation
-        z_values_[i] = weights_[i] * activations_[i] + biases_[i];
+        z_values_[i].resize(weights_[i].rows());
+        multiplyLayer(i, activations_[i], z_values_[i]);
+        z_values_[i] += biases_[i];
         
         // Activation function (ReLU for hidden layers, sigmoid for output)
         if (i == weights_.size() - 1) {
@@ -76,9 +92,25 @@ void NeuralNetwork::train(const std::vector<Eigen::VectorXf>& inputs,
     if (inputs.size() != targets.size()) {
         throw std::invalid_argument("Input and target sizes must match");
     }
+    if (inputs.empty()) {
+        return;
+    }
     
     learning_rate_ = learning_rate;
     
+    // Weights change during training; run dense and re-derive sparse layers after
+    sparse_weights_.assign(weights_.size(), BlockSparseMatrix());
+    
+    Eigen::VectorXf feature_sum = Eigen::VectorXf::Zero(inputs[0].size());
+    for (const auto& input : inputs) {
+        feature_sum += input;
+    }
+    feature_defaults_ = feature_sum / static_cast<float>(inputs.size());
+    
+    const size_t batch_size = TrainingOptions().batch_size;
+    Eigen::MatrixXf batch(inputs[0].size(), batch_size);
+    Eigen::VectorXf batch_targets(batch_size);
+    
     for (int epoch = 0; epoch < epochs; ++epoch) {
         float total_loss = 0.0f;
         
@@ -87,19 +119,13 @@ void NeuralNetwork::train(const std::vector<Eigen::VectorXf>& inputs,
         std::iota(indices.begin(), indices.end(), 0);
         std::shuffle(indices.begin(), indices.end(), rng_);
         
-        for (size_t idx : indices) {
-            // Forward pass
-            Eigen::VectorXf output = forward(inputs[idx]);
-            
-            // Calculate loss
-            float loss = crossEntropyLoss(output, targets[idx]);
-            total_loss += loss;
-            
-            // Backward pass
-            backward(inputs[idx], targets[idx]);
-            
-            // Update weights
-            updateWeights(learning_rate_);
+        for (size_t start = 0; start < indices.size(); start += batch_size) {
+            size_t count = std::min(batch_size, indices.size() - start);
+            for (size_t k = 0; k < count; ++k) {
+                batch.col(k) = inputs[indices[start + k]];
+                batch_targets(k) = targets[indices[start + k]](0);
+            }
+            total_loss += trainBatch(batch.leftCols(count), batch_targets.head(count), learning_rate_) * count;
         }
         
         // Print progress
@@ -108,6 +134,217 @@ void NeuralNetwork::train(const std::vector<Eigen::VectorXf>& inputs,
                       << total_loss / inputs.size() << std::endl;
         }
     }
+    
+    compressLayers();
+}
+
+bool NeuralNetwork::train(DatasetReader& reader, const TrainingOptions& options) {
+    learning_rate_ = options.learning_rate;
+    sparse_weights_.assign(weights_.size(), BlockSparseMatrix());
+    
+    TrainingCheckpoint checkpoint;
+    int first_epoch = 0;
+    uint64_t replay_batches = 0;
+    uint64_t step = 0;
+    size_t batch_size = options.batch_size;
+    if (options.resume) {
+        if (Checkpointer::loadLatest(options.checkpoint_dir, checkpoint) &&
+            reader.setRngState(checkpoint.reader_rng)) {
+            restoreCheckpoint(checkpoint);
+            first_epoch = checkpoint.epoch;
+            replay_batches = checkpoint.batch;
+            step = checkpoint.step;
+            // The cursor counts batches of the original size
+            if (checkpoint.batch_size != batch_size) {
+                std::cout << "Keeping the checkpoint's batch size of " << checkpoint.batch_size << std::endl;
+                batch_size = static_cast<size_t>(checkpoint.batch_size);
+            }
+            std::cout << "Continuing at epoch " << first_epoch << ", batch " << replay_batches << std::endl;
+        } else {
+            std::cout << "No usable checkpoint in " << options.checkpoint_dir
+                      << ", training from the start" << std::endl;
+        }
+    }
+    
+    std::unique_ptr<Checkpointer> checkpointer;
+    if (!options.checkpoint_dir.empty() && options.checkpoint_every > 0) {
+        checkpointer = std::make_unique<Checkpointer>(options.checkpoint_dir);
+    }
+    auto saveCheckpoint = [&](int epoch, uint64_t batch, const std::string& reader_rng) {
+        // The weights are copied once, straight into the writer's staging buffer
+        checkpointer->submit([&](TrainingCheckpoint& staged) {
+            captureCheckpoint(staged);
+            staged.epoch = epoch;
+            staged.batch = batch;
+            staged.step = step;
+            staged.batch_size = batch_size;
+            staged.reader_rng = reader_rng;
+        });
+    };
+    
+    Eigen::MatrixXf batch;
+    Eigen::VectorXf batch_targets;
+    for (int epoch = first_epoch; epoch < options.epochs; ++epoch) {
+        double total_loss = 0.0;
+        size_t trained = 0;
+        size_t samples = 0;
+        Eigen::VectorXd feature_sum = Eigen::VectorXd::Zero(inputSize());
+        
+        std::string epoch_rng = reader.rngState();
+        reader.startEpoch();
+        
+        // Skip what the resumed epoch had already trained on; the reader
+        // regenerates the same batches from the restored RNG state, so they
+        // still count towards the feature means
+        uint64_t batch_index = 0;
+        while (batch_index < replay_batches) {
+            size_t count = reader.nextBatch(batch_size, batch, batch_targets);
+            if (count == 0) {
+                break;
+            }
+            feature_sum += batch.leftCols(count).rowwise().sum().cast<double>();
+            samples += count;
+            ++batch_index;
+        }
+        replay_batches = 0;
+        
+        while (size_t count = reader.nextBatch(batch_size, batch, batch_targets)) {
+            total_loss += static_cast<double>(trainBatch(batch, batch_targets, learning_rate_)) * count;
+            trained += count;
+            feature_sum += batch.leftCols(count).rowwise().sum().cast<double>();
+            samples += count;
+            ++batch_index;
+            ++step;
+            if (checkpointer && step % options.checkpoint_every == 0) {
+                saveCheckpoint(epoch, batch_index, epoch_rng);
+            }
+        }
+        if (reader.failed()) {
+            std::cerr << "Training stopped in epoch " << epoch << ": a dataset shard failed to load" << std::endl;
+            return false;
+        }
+        
+        std::cout << "Epoch " << epoch << ", Average Loss: "
+                  << (trained > 0 ? total_loss / trained : 0.0) << " over " << trained << " samples" << std::endl;
+        if (samples > 0) {
+            feature_defaults_ = (feature_sum / static_cast<double>(samples)).cast<float>();
+        }
+        if (checkpointer) {
+            saveCheckpoint(epoch + 1, 0, reader.rngState());
+        }
+    }
+    
+    if (checkpointer) {
+        checkpointer->flush();
+    }
+    compressLayers();
+    return true;
+}
+
+void NeuralNetwork::captureCheckpoint(TrainingCheckpoint& checkpoint) const {
+    checkpoint.layer_sizes.resize(weights_.size() + 1);
+    checkpoint.layer_sizes[0] = inputSize();
+    for (size_t i = 0; i < weights_.size(); ++i) {
+        checkpoint.layer_sizes[i + 1] = static_cast<int>(weights_[i].rows());
+    }
+    checkpoint.weights = weights_;
+    checkpoint.biases = biases_;
+    checkpoint.learning_rate = learning_rate_;
+    
+    std::ostringstream rng;
+    rng << rng_;
+    checkpoint.network_rng = rng.str();
+}
+
+void NeuralNetwork::restoreCheckpoint(const TrainingCheckpoint& checkpoint) {
+    initialize(checkpoint.layer_sizes);
+    weights_ = checkpoint.weights;
+    biases_ = checkpoint.biases;
+    learning_rate_ = checkpoint.learning_rate;
+    
+    std::istringstream rng(checkpoint.network_rng);
+    rng >> rng_;
+}
+
+void NeuralNetwork::train(const Eigen::MatrixXf& inputs, const Eigen::VectorXf& targets,
+                          const std::vector<Eigen::Index>& samples, const TrainingOptions& options) {
+    learning_rate_ = options.learning_rate;
+    sparse_weights_.assign(weights_.size(), BlockSparseMatrix());
+    
+    if (!samples.empty()) {
+        Eigen::VectorXd feature_sum = Eigen::VectorXd::Zero(inputs.rows());
+        for (Eigen::Index sample : samples) {
+            feature_sum += inputs.col(sample).cast<double>();
+        }
+        feature_defaults_ = (feature_sum / static_cast<double>(samples.size())).cast<float>();
+    }
+    
+    std::vector<Eigen::Index> order = samples;
+    Eigen::MatrixXf batch(inputs.rows(), options.batch_size);
+    Eigen::VectorXf batch_targets(options.batch_size);
+    for (int epoch = 0; epoch < options.epochs; ++epoch) {
+        std::shuffle(order.begin(), order.end(), rng_);
+        for (size_t start = 0; start < order.size(); start += options.batch_size) {
+            size_t count = std::min(options.batch_size, order.size() - start);
+            for (size_t k = 0; k < count; ++k) {
+                batch.col(k) = inputs.col(order[start + k]);
+                batch_targets(k) = targets(order[start + k]);
+            }
+            trainBatch(batch.leftCols(count), batch_targets.head(count), learning_rate_);
+        }
+    }
+    
+    compressLayers();
+}
+
+float NeuralNetwork::trainBatch(const Eigen::Ref<const Eigen::MatrixXf>& inputs,
+                                const Eigen::Ref<const Eigen::VectorXf>& targets, float learning_rate) {
+    if (weights_.empty()) {
+        throw std::runtime_error("Network not initialized");
+    }
+    if (inputs.rows() != weights_[0].cols() || inputs.cols() != targets.size()) {
+        throw std::invalid_argument("Batch does not match the network input");
+    }
+    
+    const size_t layers = weights_.size();
+    const float batch = static_cast<float>(inputs.cols());
+    batch_activations_.resize(layers + 1);
+    batch_z_.resize(layers);
+    
+    // Forward pass, keeping every layer's pre-activation for the backward pass
+    batch_activations_[0] = inputs;
+    for (size_t i = 0; i < layers; ++i) {
+        batch_z_[i].noalias() = weights_[i] * batch_activations_[i];
+        batch_z_[i].colwise() += biases_[i];
+        if (i == layers - 1) {
+            batch_activations_[i + 1] = batch_z_[i];
+            cpuKernels().sigmoid(batch_activations_[i + 1].data(), batch_activations_[i + 1].size());
+        } else {
+            batch_activations_[i + 1] = batch_z_[i];
+            cpuKernels().relu(batch_activations_[i + 1].data(), batch_activations_[i + 1].size());
+        }
+    }
+    
+    // Binary cross-entropy; with a sigmoid output its gradient wrt z is p - t
+    const float epsilon = 1e-7f;
+    Eigen::ArrayXf p = batch_activations_.back().row(0).transpose().array().max(epsilon).min(1.0f - epsilon);
+    Eigen::ArrayXf t = targets.array();
+    float loss = -(t * p.log() + (1.0f - t) * (1.0f - p).log()).mean();
+    delta_ = batch_activations_.back().rowwise() - targets.transpose();
+    
+    // Backward pass; the next delta uses the weights before this step's update
+    for (size_t i = layers; i-- > 0;) {
+        Eigen::MatrixXf weight_gradient = delta_ * batch_activations_[i].transpose() / batch;
+        Eigen::VectorXf bias_gradient = delta_.rowwise().sum() / batch;
+        if (i > 0) {
+            Eigen::MatrixXf previous = weights_[i].transpose() * delta_;
+            delta_ = (previous.array() * (batch_z_[i - 1].array() > 0.0f).cast<float>()).matrix();
+        }
+        weights_[i] -= learning_rate * weight_gradient;
+        biases_[i] -= learning_rate * bias_gradient;
+    }
+    
+    return loss;
 }
 
 float NeuralNetwork::predict(const Eigen::VectorXf& input) {
@@ -115,12 +352,218 @@ float NeuralNetwork::predict(const Eigen::VectorXf& input) {
     return output(0); // Return first (and only) output value
 }
 
+Eigen::VectorXf NeuralNetwork::predictBatch(const Eigen::MatrixXf& inputs) const {
+    ScopedTimer timer(ProfileStage::Forward);
+    if (weights_.empty()) {
+        throw std::runtime_error("Network not initialized");
+    }
+    
+    const Eigen::Index batch = inputs.cols();
+    size_t tasks = 1;
+    if (thread_pool_) {
+        tasks = std::min(thread_pool_->size(), static_cast<size_t>(batch / MIN_COLUMNS_PER_TASK));
+    }
+    if (tasks <= 1) {
+        return predictColumns(inputs);
+    }
+    
+    // Columns are independent; each task scores a contiguous block
+    Eigen::VectorXf predictions(batch);
+    std::vector<std::future<void>> pending;
+    for (size_t t = 0; t < tasks; ++t) {
+        Eigen::Index begin = batch * t / tasks;
+        Eigen::Index count = batch * (t + 1) / tasks - begin;
+        pending.push_back(thread_pool_->submit([this, &inputs, &predictions, begin, count]() {
+            predictions.segment(begin, count) = predictColumns(inputs.middleCols(begin, count));
+        }));
+    }
+    for (auto& future : pending) {
+        thread_pool_->wait(future);
+    }
+    return predictions;
+}
+
+Eigen::VectorXf NeuralNetwork::predictColumns(const Eigen::Ref<const Eigen::MatrixXf>& inputs) const {
+    // First layer GEMM for the whole block; layer outputs are scratch
+    ScratchScope scope;
+    ScratchArena& arena = ScratchArena::local();
+    const Eigen::Index batch = inputs.cols();
+    Eigen::Map<Eigen::MatrixXf> z(arena.floats(weights_[0].rows() * batch), weights_[0].rows(), batch);
+    multiplyLayer(0, inputs, z);
+    z.colwise() += biases_[0];
+    return predictFromLayer(0, z);
+}
+
+Eigen::VectorXf NeuralNetwork::predictFromLayer(size_t layer, const Eigen::Ref<const Eigen::MatrixXf>& preactivation) const {
+    ScratchScope scope;
+    ScratchArena& arena = ScratchArena::local();
+    const Eigen::Index batch = preactivation.cols();
+    Eigen::Map<Eigen::MatrixXf> activation(arena.floats(preactivation.size()), preactivation.rows(), batch);
+    activation = preactivation;
+    const CpuKernels& kernels = cpuKernels();
+    
+    for (size_t i = layer; ; ++i) {
+        if (i == weights_.size() - 1) {
+            // Output layer - sigmoid
+            kernels.sigmoid(activation.data(), activation.size());
+            break;
+        }
+        // Hidden layers - ReLU
+        kernels.relu(activation.data(), activation.size());
+        
+        // One GEMM per layer, then rebind the map to the new layer output
+        Eigen::Map<Eigen::MatrixXf> z(arena.floats(weights_[i + 1].rows() * batch), weights_[i + 1].rows(), batch);
+        multiplyLayer(i + 1, activation, z);
+        z.colwise() += biases_[i + 1];
+        new (&activation) Eigen::Map<Eigen::MatrixXf>(z.data(), z.rows(), batch);
+    }
+    
+    return activation.row(0).transpose();
+}
+
+void NeuralNetwork::multiplyLayer(size_t layer, const Eigen::Ref<const Eigen::MatrixXf>& inputs,
+                                  Eigen::Ref<Eigen::MatrixXf> out) const {
+    if (isSparseLayer(layer)) {
+        sparse_weights_[layer].multiply(inputs, out);
+    } else if (inputs.cols() == 1) {
+        // Single sample: the dispatched GEMV
+        const Eigen::MatrixXf& weights = weights_[layer];
+        cpuKernels().gemv(weights.data(), weights.rows(), weights.cols(), inputs.data(), out.data());
+    } else {
+        out.noalias() = weights_[layer] * inputs;
+    }
+}
+
+void NeuralNetwork::compressLayers() {
+    sparse_weights_.assign(weights_.size(), BlockSparseMatrix());
+    for (size_t i = 0; i < weights_.size(); ++i) {
+        BlockSparseMatrix sparse = BlockSparseMatrix::fromDense(weights_[i]);
+        if (sparse.density() <= SPARSE_DENSITY_LIMIT) {
+            sparse_weights_[i] = std::move(sparse);
+        }
+    }
+}
+
+void NeuralNetwork::prune(const PruneOptions& options, const Eigen::MatrixXf& calibration) {
+    if (weights_.empty()) {
+        throw std::runtime_error("Network not initialized");
+    }
+    if (calibration.cols() > 0 && calibration.rows() != weights_[0].cols()) {
+        throw std::invalid_argument("Calibration samples do not match the input size");
+    }
+    
+    pruneBlocks(options.sparsity);
+    if (options.remove_dead_neurons) {
+        removeDeadNeurons(calibration);
+        // Removed inputs shift the next layer's block grid; re-prune on the new grid
+        pruneBlocks(options.sparsity);
+    }
+    compressLayers();
+    
+    for (size_t i = 0; i < weights_.size(); ++i) {
+        float kept = static_cast<float>((weights_[i].array() != 0.0f).count()) / weights_[i].size();
+        std::cout << "Layer " << i << ": " << weights_[i].rows() << "x" << weights_[i].cols()
+                  << ", " << (kept * 100) << "% of weights kept"
+                  << (isSparseLayer(i) ? " (block-sparse)" : " (dense)") << std::endl;
+    }
+}
+
+void NeuralNetwork::pruneBlocks(float sparsity) {
+    const int block_rows = BlockSparseMatrix::BLOCK_ROWS;
+    const int block_cols = BlockSparseMatrix::BLOCK_COLS;
+    
+    // Structured magnitude pruning: the output layer is too small to bother
+    for (size_t i = 0; i + 1 < weights_.size(); ++i) {
+        Eigen::MatrixXf& weight = weights_[i];
+        struct BlockNorm {
+            float norm;
+            Eigen::Index row;
+            Eigen::Index col;
+        };
+        std::vector<BlockNorm> blocks;
+        for (Eigen::Index r = 0; r < weight.rows(); r += block_rows) {
+            for (Eigen::Index c = 0; c < weight.cols(); c += block_cols) {
+                Eigen::Index height = std::min<Eigen::Index>(block_rows, weight.rows() - r);
+                Eigen::Index width = std::min<Eigen::Index>(block_cols, weight.cols() - c);
+                blocks.push_back({weight.block(r, c, height, width).norm(), r, c});
+            }
+        }
+        
+        size_t drop = static_cast<size_t>(std::clamp(sparsity, 0.0f, 1.0f) * blocks.size());
+        std::nth_element(blocks.begin(), blocks.begin() + drop, blocks.end(),
+                         [](const BlockNorm& a, const BlockNorm& b) { return a.norm < b.norm; });
+        for (size_t b = 0; b < drop; ++b) {
+            Eigen::Index height = std::min<Eigen::Index>(block_rows, weight.rows() - blocks[b].row);
+            Eigen::Index width = std::min<Eigen::Index>(block_cols, weight.cols() - blocks[b].col);
+            weight.block(blocks[b].row, blocks[b].col, height, width).setZero();
+        }
+    }
+}
+
+void NeuralNetwork::removeDeadNeurons(const Eigen::MatrixXf& calibration) {
+    Eigen::MatrixXf activation = calibration;
+    if (activation.cols() == 0) {
+        activation.resize(weights_[0].cols(), 0);
+    }
+    for (size_t i = 0; i + 1 < weights_.size(); ++i) {
+        Eigen::MatrixXf z = weights_[i] * activation;
+        z.colwise() += biases_[i];
+        
+        // A neuron is dead if no input can activate it, or no calibration sample did
+        std::vector<int> alive;
+        for (Eigen::Index j = 0; j < weights_[i].rows(); ++j) {
+            bool unreachable = weights_[i].row(j).isZero(0.0f) && biases_[i](j) <= 0.0f;
+            bool never_active = z.cols() > 0 && (z.row(j).array() <= 0.0f).all();
+            if (!unreachable && !never_active) {
+                alive.push_back(static_cast<int>(j));
+            }
+        }
+        if (alive.empty()) {
+            alive.push_back(0); // Keep the layer connected
+        }
+        
+        // Drop the neuron's row here and the matching input column of the next layer
+        if (alive.size() < static_cast<size_t>(weights_[i].rows())) {
+            std::cout << "Layer " << i << ": removed " << (weights_[i].rows() - alive.size())
+                      << " dead neurons" << std::endl;
+            weights_[i] = Eigen::MatrixXf(weights_[i](alive, Eigen::all));
+            biases_[i] = Eigen::VectorXf(biases_[i](alive));
+            weights_[i + 1] = Eigen::MatrixXf(weights_[i + 1](Eigen::all, alive));
+            z = Eigen::MatrixXf(z(alive, Eigen::all));
+        }
+        activation = z.array().max(0.0f);
+    }
+}
+
+uint64_t NeuralNetwork::fingerprint() const {
+    // FNV-1a over every layer's shape, weights and biases
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    for (size_t i = 0; i < weights_.size(); ++i) {
+        const int64_t shape[2] = {weights_[i].rows(), weights_[i].cols()};
+        mix(shape, sizeof(shape));
+        mix(weights_[i].data(), weights_[i].size() * sizeof(float));
+        mix(biases_[i].data(), biases_[i].size() * sizeof(float));
+    }
+    return hash;
+}
+
 bool NeuralNetwork::saveModel(const std::string& filename) {
     std::ofstream file(filename, std::ios::binary);
     if (!file.is_open()) {
         return false;
     }
     
+    // Format tag and version
+    uint32_t version = MODEL_VERSION;
+    file.write(MODEL_MAGIC, sizeof(MODEL_MAGIC));
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    
     // Save network architecture
     size_t num_layers = weights_.size() + 1;
     file.write(reinterpret_cast<const char*>(&num_layers), sizeof(num_layers));
@@ -139,8 +582,16 @@ bool NeuralNetwork::saveModel(const std::string& filename) {
     file.write(reinterpret_cast<const char*>(layer_sizes.data()), 
                layer_sizes.size() * sizeof(int));
     
-    // Save weights
-    for (const auto& weight : weights_) {
+    // Save weights, pruned layers in block-sparse form
+    for (size_t i = 0; i < weights_.size(); ++i) {
+        uint8_t encoding = isSparseLayer(i) ? BLOCK_SPARSE_LAYER : DENSE_LAYER;
+        file.write(reinterpret_cast<const char*>(&encoding), sizeof(encoding));
+        if (encoding == BLOCK_SPARSE_LAYER) {
+            sparse_weights_[i].write(file);
+            continue;
+        }
+        
+        const Eigen::MatrixXf& weight = weights_[i];
         size_t rows = weight.rows();
         size_t cols = weight.cols();
         file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
@@ -157,7 +608,237 @@ bool NeuralNetwork::saveModel(const std::string& filename) {
                    bias.size() * sizeof(float));
     }
     
-    return true;
+    // Save trained feature means (may be empty)
+    uint64_t defaults_size = feature_defaults_.size();
+    file.write(reinterpret_cast<const char*>(&defaults_size), sizeof(defaults_size));
+    file.write(reinterpret_cast<const char*>(feature_defaults_.data()), 
+               feature_defaults_.size() * sizeof(float));
+    
+    return static_cast<bool>(file);
+}
+
+namespace {
+
+// Loops of a header written by exportCpp. They repeat the single-sample path
+// (gemv, relu and sigmoid of src/kernels.inl) operation for operation, so a
+// frozen model scores exactly like NeuralNetwork::predict when both are
+// built without floating-point contraction.
+const char* FROZEN_KERNELS = R"(namespace detail {
+
+// y = W x + b for a column-major ROWS x COLS W
+template <int ROWS, int COLS>
+inline void dense(const float* weights, const float* bias, const float* x, float* y) {
+    for (int r = 0; r < ROWS; ++r) {
+        y[r] = 0.0f;
+    }
+    constexpr int BLOCKED = COLS - COLS % 4;
+    for (int c = 0; c < BLOCKED; c += 4) {
+        const float* w0 = weights + c * ROWS;
+        const float* w1 = w0 + ROWS;
+        const float* w2 = w1 + ROWS;
+        const float* w3 = w2 + ROWS;
+        const float x0 = x[c], x1 = x[c + 1], x2 = x[c + 2], x3 = x[c + 3];
+        for (int r = 0; r < ROWS; ++r) {
+            float sum = y[r] + w0[r] * x0;
+            sum = sum + w1[r] * x1;
+            sum = sum + w2[r] * x2;
+            y[r] = sum + w3[r] * x3;
+        }
+    }
+    for (int c = BLOCKED; c < COLS; ++c) {
+        const float* w = weights + c * ROWS;
+        const float xc = x[c];
+        for (int r = 0; r < ROWS; ++r) {
+            y[r] = y[r] + w[r] * xc;
+        }
+    }
+    for (int r = 0; r < ROWS; ++r) {
+        y[r] = y[r] + bias[r];
+    }
+}
+
+template <int N>
+inline void relu(float* data) {
+    for (int i = 0; i < N; ++i) {
+        data[i] = data[i] > 0.0f ? data[i] : 0.0f;
+    }
+}
+
+// exp(x) from the Cephes single-precision polynomial
+inline float expPolynomial(float x) {
+    x = x < -87.3f ? -87.3f : x;
+    x = x > 88.3f ? 88.3f : x;
+    const float t = x * 1.44269504088896341f + 0.5f;
+    const int n = static_cast<int>(t + 128.0f) - 128;
+    const float fn = static_cast<float>(n);
+    float r = x - fn * 0.693359375f;
+    r = r - fn * -2.12194440e-4f;
+
+    float y = 1.9875691500e-4f;
+    y = y * r + 1.3981999507e-3f;
+    y = y * r + 8.3334519073e-3f;
+    y = y * r + 4.1665795894e-2f;
+    y = y * r + 1.6666665459e-1f;
+    y = y * r + 5.0000001201e-1f;
+    y = y * (r * r) + r + 1.0f;
+
+    const int32_t bits = (n + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return y * scale;
+}
+
+template <int N>
+inline void sigmoid(float* data) {
+    for (int i = 0; i < N; ++i) {
+        data[i] = 1.0f / (1.0f + expPolynomial(-data[i]));
+    }
+}
+
+} // namespace detail
+)";
+
+bool isIdentifier(const std::string& name) {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](unsigned char c) { return std::isalnum(c) || c == '_'; });
+}
+
+// An alignas(64) constexpr array of exact hexadecimal float literals
+void writeArray(std::ostream& out, const std::string& name, const float* values, size_t size) {
+    out << "alignas(64) inline constexpr float " << name << "[" << size << "] = {";
+    char literal[32];
+    for (size_t i = 0; i < size; ++i) {
+        std::snprintf(literal, sizeof(literal), "%af", static_cast<double>(values[i]));
+        out << (i % 6 == 0 ? "\n    " : " ") << literal << (i + 1 < size ? "," : "");
+    }
+    out << "\n};\n\n";
+}
+
+} // namespace
+
+bool NeuralNetwork::exportCpp(const std::string& filename, const std::string& name_space) const {
+    if (weights_.empty()) {
+        std::cerr << "Network not initialized" << std::endl;
+        return false;
+    }
+    if (!isIdentifier(name_space)) {
+        std::cerr << "Invalid namespace for the exported model: " << name_space << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < weights_.size(); ++i) {
+        if (!weights_[i].allFinite() || !biases_[i].allFinite()) {
+            std::cerr << "Cannot export a model with non-finite parameters" << std::endl;
+            return false;
+        }
+    }
+
+    const size_t layers = weights_.size();
+    std::vector<int> sizes = {static_cast<int>(weights_[0].cols())};
+    for (const auto& weight : weights_) {
+        sizes.push_back(static_cast<int>(weight.rows()));
+    }
+    std::string shape;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        shape += (i ? "-" : "") + std::to_string(sizes[i]);
+    }
+
+    std::ostringstream out;
+    char fingerprint_text[24];
+    std::snprintf(fingerprint_text, sizeof(fingerprint_text), "%016llx",
+                  static_cast<unsigned long long>(fingerprint()));
+    out << "// Generated by ai_detector export-cpp. Do not edit.\n";
+    out << "// Frozen " << shape << " network, fingerprint " << fingerprint_text << ".\n";
+    out << "//\n";
+    out << "// " << name_space << "::predict(features) scores one feature vector of INPUT_SIZE\n";
+    out << "// floats. AIDetector::initializeFrozen<" << name_space << "::Model>() loads the model\n";
+    out << "// into a detector without reading a file.\n";
+    out << "#pragma once\n\n";
+    out << "#include <cstdint>\n#include <cstring>\n\n";
+    out << "namespace " << name_space << " {\n\n";
+    out << "inline constexpr int LAYERS = " << layers << ";\n";
+    out << "inline constexpr int LAYER_SIZES[LAYERS + 1] = {";
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        out << (i ? ", " : "") << sizes[i];
+    }
+    out << "};\n";
+    out << "inline constexpr int INPUT_SIZE = " << sizes.front() << ";\n\n";
+
+    out << "// Layer l: W<l> is LAYER_SIZES[l + 1] x LAYER_SIZES[l], column-major; B<l> its biases\n";
+    for (size_t i = 0; i < layers; ++i) {
+        writeArray(out, "W" + std::to_string(i), weights_[i].data(), weights_[i].size());
+        writeArray(out, "B" + std::to_string(i), biases_[i].data(), biases_[i].size());
+    }
+    const bool has_defaults = feature_defaults_.size() > 0;
+    if (has_defaults) {
+        out << "// Trained feature means, for features skipped under a deadline\n";
+        writeArray(out, "FEATURE_DEFAULTS", feature_defaults_.data(), feature_defaults_.size());
+    }
+
+    out << FROZEN_KERNELS << "\n";
+
+    // One call per layer with its dimensions as template arguments
+    out << "inline float predict(const float* features) {\n";
+    for (size_t i = 0; i < layers; ++i) {
+        out << "    alignas(64) float a" << (i + 1) << "[" << sizes[i + 1] << "];\n";
+    }
+    for (size_t i = 0; i < layers; ++i) {
+        std::string input = i == 0 ? "features" : "a" + std::to_string(i);
+        std::string output = "a" + std::to_string(i + 1);
+        out << "    detail::dense<" << sizes[i + 1] << ", " << sizes[i] << ">(W" << i << ", B" << i
+            << ", " << input << ", " << output << ");\n";
+        out << "    detail::" << (i + 1 == layers ? "sigmoid<" : "relu<") << sizes[i + 1] << ">("
+            << output << ");\n";
+    }
+    out << "    return a" << layers << "[0];\n";
+    out << "}\n\n";
+
+    out << "// For NeuralNetwork::loadFrozen and AIDetector::initializeFrozen\n";
+    out << "struct Model {\n";
+    out << "    static constexpr int LAYERS = " << name_space << "::LAYERS;\n";
+    out << "    static constexpr const int* LAYER_SIZES = " << name_space << "::LAYER_SIZES;\n";
+    out << "    static constexpr const float* WEIGHTS[LAYERS] = {";
+    for (size_t i = 0; i < layers; ++i) {
+        out << (i ? ", " : "") << "W" << i;
+    }
+    out << "};\n";
+    out << "    static constexpr const float* BIASES[LAYERS] = {";
+    for (size_t i = 0; i < layers; ++i) {
+        out << (i ? ", " : "") << "B" << i;
+    }
+    out << "};\n";
+    out << "    static constexpr const float* FEATURE_DEFAULTS = "
+        << (has_defaults ? name_space + "::FEATURE_DEFAULTS" : std::string("nullptr")) << ";\n";
+    out << "    static constexpr uint64_t FINGERPRINT = 0x" << fingerprint_text << "ull;\n";
+    out << "};\n\n";
+    out << "} // namespace " << name_space << "\n";
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    file << out.str();
+    return static_cast<bool>(file);
+}
+
+void NeuralNetwork::loadParameters(const std::vector<int>& layer_sizes, const float* const* weights,
+                                   const float* const* biases, const float* feature_defaults) {
+    if (layer_sizes.size() < 2) {
+        throw std::invalid_argument("At least 2 layers required (input and output)");
+    }
+    
+    // Straight copies of the given arrays; no random initialization first
+    weights_.clear();
+    biases_.clear();
+    for (size_t i = 0; i + 1 < layer_sizes.size(); ++i) {
+        weights_.push_back(Eigen::Map<const Eigen::MatrixXf>(weights[i], layer_sizes[i + 1], layer_sizes[i]));
+        biases_.push_back(Eigen::Map<const Eigen::VectorXf>(biases[i], layer_sizes[i + 1]));
+    }
+    feature_defaults_.resize(0);
+    if (feature_defaults) {
+        feature_defaults_ = Eigen::Map<const Eigen::VectorXf>(feature_defaults, layer_sizes[0]);
+    }
+    activations_.resize(layer_sizes.size());
+    z_values_.resize(layer_sizes.size() - 1);
+    compressLayers();
 }
 
 bool NeuralNetwork::loadModel(const std::string& filename) {
@@ -166,6 +847,21 @@ bool NeuralNetwork::loadModel(const std::string& filename) {
         return false;
     }
     
+    // Versioned files start with the magic tag, unversioned ones with the layer count
+    char magic[sizeof(MODEL_MAGIC)] = {};
+    uint32_t version = 0;
+    file.read(magic, sizeof(magic));
+    if (file && std::equal(magic, magic + sizeof(magic), MODEL_MAGIC)) {
+        file.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if (!file || version > MODEL_VERSION) {
+            std::cerr << "Unsupported model version " << version << " in " << filename << std::endl;
+            return false;
+        }
+    } else {
+        file.clear();
+        file.seekg(0);
+    }
+    
     // Load network architecture
     size_t num_layers;
     file.read(reinterpret_cast<char*>(&num_layers), sizeof(num_layers));
@@ -173,106 +869,98 @@ bool NeuralNetwork::loadModel(const std::string& filename) {
     // Load layer sizes
     size_t layer_sizes_size;
     file.read(reinterpret_cast<char*>(&layer_sizes_size), sizeof(layer_sizes_size));
+    if (!file || layer_sizes_size < 2 || layer_sizes_size > MAX_LAYERS) {
+        return false;
+    }
     std::vector<int> layer_sizes(layer_sizes_size);
     file.read(reinterpret_cast<char*>(layer_sizes.data()), 
               layer_sizes.size() * sizeof(int));
+    if (!file) {
+        return false;
+    }
+    for (int size : layer_sizes) {
+        if (size <= 0 || size > MAX_LAYER_SIZE) {
+            return false;
+        }
+    }
     
-    // Initialize network
-    initialize(layer_sizes);
+    // Read into locals sized from the file: no random initialization, and a
+    // failed load leaves the current network untouched
+    std::vector<Eigen::MatrixXf> weights(layer_sizes.size() - 1);
+    std::vector<Eigen::VectorXf> biases(layer_sizes.size() - 1);
+    Eigen::VectorXf feature_defaults;
     
     // Load weights
-    for (auto& weight : weights_) {
+    for (size_t i = 0; i < weights.size(); ++i) {
+        uint8_t encoding = DENSE_LAYER;
+        if (version >= 1) {
+            file.read(reinterpret_cast<char*>(&encoding), sizeof(encoding));
+        }
+        if (encoding == BLOCK_SPARSE_LAYER) {
+            // The stored shape must be this layer's, or forward() would mismatch
+            BlockSparseMatrix sparse;
+            if (!sparse.read(file) || sparse.rows() != layer_sizes[i + 1] || sparse.cols() != layer_sizes[i]) {
+                return false;
+            }
+            weights[i] = sparse.toDense();
+            continue;
+        }
+        
         size_t rows, cols;
         file.read(reinterpret_cast<char*>(&rows), sizeof(rows));
         file.read(reinterpret_cast<char*>(&cols), sizeof(cols));
-        weight.resize(rows, cols);
-        file.read(reinterpret_cast<char*>(weight.data()), 
-                  weight.size() * sizeof(float));
+        if (!file || rows != static_cast<size_t>(layer_sizes[i + 1]) || cols != static_cast<size_t>(layer_sizes[i])) {
+            return false;
+        }
+        weights[i].resize(rows, cols);
+        file.read(reinterpret_cast<char*>(weights[i].data()), 
+                  weights[i].size() * sizeof(float));
     }
     
     // Load biases
-    for (auto& bias : biases_) {
+    for (size_t i = 0; i < biases.size(); ++i) {
         size_t size;
         file.read(reinterpret_cast<char*>(&size), sizeof(size));
-        bias.resize(size);
-        file.read(reinterpret_cast<char*>(bias.data()), 
-                  bias.size() * sizeof(float));
+        if (!file || size != static_cast<size_t>(layer_sizes[i + 1])) {
+            return false;
+        }
+        biases[i].resize(size);
+        file.read(reinterpret_cast<char*>(biases[i].data()), 
+                  biases[i].size() * sizeof(float));
+    }
+    
+    // Trained feature means, from version 2 on
+    if (version >= 2) {
+        uint64_t defaults_size = 0;
+        file.read(reinterpret_cast<char*>(&defaults_size), sizeof(defaults_size));
+        if (!file || (defaults_size != 0 && defaults_size != static_cast<uint64_t>(layer_sizes[0]))) {
+            return false;
+        }
+        feature_defaults.resize(static_cast<Eigen::Index>(defaults_size));
+        file.read(reinterpret_cast<char*>(feature_defaults.data()), 
+                  feature_defaults.size() * sizeof(float));
     }
     
+    if (!file) {
+        return false;
+    }
+    weights_ = std::move(weights);
+    biases_ = std::move(biases);
+    feature_defaults_ = std::move(feature_defaults);
+    activations_.resize(layer_sizes.size());
+    z_values_.resize(layer_sizes.size() - 1);
+    compressLayers();
     return true;
 }
 
 Eigen::VectorXf NeuralNetwork::sigmoid(const Eigen::VectorXf& x) {
-    return 1.0f / (1.0f + (-x).array().exp());
-}
-
-Eigen::VectorXf NeuralNetwork::sigmoidDerivative(const Eigen::VectorXf& x) {
-    Eigen::VectorXf sig = sigmoid(x);
-    return sig.array() * (1.0f - sig.array());
+    Eigen::VectorXf result = x;
+    cpuKernels().sigmoid(result.data(), result.size());
+    return result;
 }
 
 Eigen::VectorXf NeuralNetwork::relu(const Eigen::VectorXf& x) {
-    return x.array().max(0.0f);
-}
-
-Eigen::VectorXf NeuralNetwork::reluDerivative(const Eigen::VectorXf& x) {
-    return (x.array() > 0.0f).cast<float>();
-}
-
-float NeuralNetwork::crossEntropyLoss(const Eigen::VectorXf& predicted, const Eigen::VectorXf& target) {
-    // Binary cross-entropy loss
-    float epsilon = 1e-15f;
-    float p = std::max(std::min(predicted(0), 1.0f - epsilon), epsilon);
-    float t = target(0);
-    return -t * std::log(p) - (1.0f - t) * std::log(1.0f - p);
+    Eigen::VectorXf result = x;
+    cpuKernels().relu(result.data(), result.size());
+    return result;
 }
-
-Eigen::VectorXf NeuralNetwork::crossEntropyDerivative(const Eigen::VectorXf& predicted, const Eigen::VectorXf& target) {
-    // Derivative of binary cross-entropy loss
-    float epsilon = 1e-15f;
-    float p = std::max(std::min(predicted(0), 1.0f - epsilon), epsilon);
-    float t = target(0);
-    Eigen::VectorXf derivative(1);
-    derivative(0) = (p - t) / (p * (1.0f - p));
-    return derivative;
-}
-
-void NeuralNetwork::backward(const Eigen::VectorXf& input, const Eigen::VectorXf& target) {
-    // Calculate gradients for output layer
-    Eigen::VectorXf output_gradient = crossEntropyDerivative(activations_.back(), target);
-    
-    // Backpropagate through layers
-    for (int i = static_cast<int>(weights_.size()) - 1; i >= 0; --i) {
-        // Gradient with respect to weights
-        Eigen::MatrixXf weight_gradient = output_gradient * activations_[i].transpose();
-        
-        // Gradient with respect to bias
-        Eigen::VectorXf bias_gradient = output_gradient;
-        
-        // Gradient with respect to input (for next layer)
-        if (i > 0) {
-            Eigen::VectorXf input_gradient = weights_[i].transpose() * output_gradient;
-            
-            // Apply activation derivative
-            Eigen::VectorXf activation_derivative = reluDerivative(z_values_[i - 1]);
-            output_gradient = input_gradient.array() * activation_derivative.array();
-        }
-        
-        // Store gradients (in a real implementation, you'd accumulate these)
-        // For simplicity, we'll update weights directly in updateWeights()
-    }
-}
-
-void NeuralNetwork::updateWeights(float learning_rate) {
-    // Simplified weight update (in a real implementation, you'd use stored gradients)
-    // This is a placeholder for the actual gradient descent update
-    for (size_t i = 0; i < weights_.size(); ++i) {
-        // weights_[i] -= learning_rate * weight_gradients_[i];
-        // biases_[i] -= learning_rate * bias_gradients_[i];
-    }
-}
-
-Eigen::VectorXf NeuralNetwork::softmax(const Eigen::VectorXf& x) {
-    Eigen::VectorXf exp_x = x.array().exp();
-    return exp_x / exp_x.sum();
-} 
\ No newline at end of file
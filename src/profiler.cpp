@@ -0,0 +1,347 @@
+#include "../include/profiler.h"
+#include "../include/file_io.h"
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+std::atomic<bool> Profiler::enabled_(false);
+
+namespace {
+
+constexpr int STAGES = static_cast<int>(ProfileStage::Count);
+constexpr int COUNTERS = static_cast<int>(ProfileCounter::Count);
+
+// Log-linear buckets: values below 16ns are exact, above that each power of
+// two is split into 16 linear sub-buckets
+constexpr int SUB_BUCKET_BITS = 4;
+constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+constexpr int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+constexpr size_t MAX_TRACE_EVENTS = 1 << 20;    // Per thread
+
+int highestBit(uint64_t value) {
+    int bit = 0;
+    for (int shift = 32; shift > 0; shift /= 2) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+}
+
+int bucketIndex(uint64_t ns) {
+    if (ns < SUB_BUCKETS) {
+        return static_cast<int>(ns);
+    }
+    int exponent = highestBit(ns);
+    int sub = static_cast<int>((ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t bucketLowerBound(int index) {
+    if (index < SUB_BUCKETS) {
+        return static_cast<uint64_t>(index);
+    }
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t sub = static_cast<uint64_t>(index % SUB_BUCKETS);
+    return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+}
+
+uint64_t bucketUpperBound(int index) {
+    return index + 1 < BUCKETS ? bucketLowerBound(index + 1) : UINT64_MAX;
+}
+
+struct TraceEvent {
+    ProfileStage stage;
+    int64_t start_us;
+    int64_t duration_us;
+};
+
+// Written only by its own thread; other threads read with relaxed loads, so
+// recording never takes a lock. Trace events are the exception and only
+// exist while tracing.
+struct ThreadProfile {
+    int thread_id = 0;
+    std::atomic<uint64_t> buckets[STAGES][BUCKETS];
+    std::atomic<uint64_t> total_ns[STAGES];
+    std::atomic<uint64_t> max_ns[STAGES];
+    std::atomic<uint64_t> counters[COUNTERS];
+    std::mutex trace_mutex;
+    std::vector<TraceEvent> trace;
+
+    ThreadProfile() {
+        for (int s = 0; s < STAGES; ++s) {
+            for (int b = 0; b < BUCKETS; ++b) {
+                buckets[s][b].store(0, std::memory_order_relaxed);
+            }
+            total_ns[s].store(0, std::memory_order_relaxed);
+            max_ns[s].store(0, std::memory_order_relaxed);
+        }
+        for (int c = 0; c < COUNTERS; ++c) {
+            counters[c].store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+void bump(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Profiles outlive their threads so that reports still see them
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadProfile>> profiles;
+    std::atomic<bool> tracing{false};
+    Profiler::Clock::time_point epoch = Profiler::Clock::now();
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadProfile& threadProfile() {
+    thread_local ThreadProfile* profile = nullptr;
+    if (!profile) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.profiles.push_back(std::make_unique<ThreadProfile>());
+        profile = reg.profiles.back().get();
+        profile->thread_id = static_cast<int>(reg.profiles.size());
+    }
+    return *profile;
+}
+
+// All threads merged for one stage
+struct StageSummary {
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(BUCKETS, 0);
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+
+    double percentileMs(double fraction) const {
+        if (count == 0) {
+            return 0.0;
+        }
+        uint64_t rank = static_cast<uint64_t>(fraction * (count - 1));
+        uint64_t seen = 0;
+        for (int b = 0; b < BUCKETS; ++b) {
+            seen += buckets[b];
+            if (seen > rank) {
+                // Bucket midpoint, capped by the exact maximum
+                uint64_t upper = std::min(bucketUpperBound(b), max_ns);
+                uint64_t lower = std::min(bucketLowerBound(b), upper);
+                return (lower + (upper - lower) / 2) / 1e6;
+            }
+        }
+        return max_ns / 1e6;
+    }
+};
+
+struct Snapshot {
+    std::vector<StageSummary> stages = std::vector<StageSummary>(STAGES);
+    uint64_t counters[COUNTERS] = {};
+};
+
+Snapshot takeSnapshot() {
+    Snapshot snapshot;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& profile : reg.profiles) {
+        for (int s = 0; s < STAGES; ++s) {
+            StageSummary& stage = snapshot.stages[s];
+            for (int b = 0; b < BUCKETS; ++b) {
+                uint64_t n = profile->buckets[s][b].load(std::memory_order_relaxed);
+                stage.buckets[b] += n;
+                stage.count += n;
+            }
+            stage.total_ns += profile->total_ns[s].load(std::memory_order_relaxed);
+            stage.max_ns = std::max(stage.max_ns, profile->max_ns[s].load(std::memory_order_relaxed));
+        }
+        for (int c = 0; c < COUNTERS; ++c) {
+            snapshot.counters[c] += profile->counters[c].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+} // namespace
+
+void Profiler::enable(bool tracing) {
+    if (tracing) {
+        registry().tracing.store(true, std::memory_order_relaxed);
+    }
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::record(ProfileStage stage, Clock::time_point start, Clock::time_point end) {
+    ThreadProfile& profile = threadProfile();
+    int s = static_cast<int>(stage);
+    uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+
+    bump(profile.buckets[s][bucketIndex(ns)], 1);
+    bump(profile.total_ns[s], ns);
+    if (ns > profile.max_ns[s].load(std::memory_order_relaxed)) {
+        profile.max_ns[s].store(ns, std::memory_order_relaxed);
+    }
+
+    Registry& reg = registry();
+    if (reg.tracing.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(profile.trace_mutex);
+        if (profile.trace.size() < MAX_TRACE_EVENTS) {
+            auto start_us = std::chrono::duration_cast<std::chrono::microseconds>(start - reg.epoch).count();
+            auto duration_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            profile.trace.push_back({stage, static_cast<int64_t>(start_us), static_cast<int64_t>(duration_us)});
+        }
+    }
+}
+
+void Profiler::addCount(ProfileCounter counter, uint64_t amount) {
+    bump(threadProfile().counters[static_cast<int>(counter)], amount);
+}
+
+const char* Profiler::stageName(ProfileStage stage) {
+    switch (stage) {
+        case ProfileStage::Decode: return "decode";
+        case ProfileStage::FrameExtraction: return "frame_extraction";
+        case ProfileStage::Preprocess: return "preprocess";
+        case ProfileStage::StatisticalFeatures: return "statistical_features";
+        case ProfileStage::FrequencyFeatures: return "frequency_features";
+        case ProfileStage::TextureFeatures: return "texture_features";
+        case ProfileStage::NoiseFeatures: return "noise_features";
+        case ProfileStage::ColorFeatures: return "color_features";
+        case ProfileStage::IncrementalFeatures: return "incremental_features";
+        case ProfileStage::Forward: return "forward";
+        case ProfileStage::OpticalFlow: return "optical_flow";
+        case ProfileStage::TemporalAnalysis: return "temporal_analysis";
+        case ProfileStage::MotionAnalysis: return "motion_analysis";
+        case ProfileStage::PerceptualHash: return "perceptual_hash";
+        case ProfileStage::Count: break;
+    }
+    return "unknown";
+}
+
+void Profiler::printSummary(std::ostream& out) {
+    Snapshot snapshot = takeSnapshot();
+
+    out << "Profile (milliseconds)\n";
+    out << std::left << std::setw(22) << "stage" << std::right
+        << std::setw(9) << "count" << std::setw(11) << "total"
+        << std::setw(9) << "mean" << std::setw(9) << "p50"
+        << std::setw(9) << "p90" << std::setw(9) << "p99"
+        << std::setw(9) << "max" << "\n";
+    out << std::fixed << std::setprecision(3);
+    for (int s = 0; s < STAGES; ++s) {
+        const StageSummary& stage = snapshot.stages[s];
+        if (stage.count == 0) {
+            continue;
+        }
+        out << std::left << std::setw(22) << stageName(static_cast<ProfileStage>(s)) << std::right
+            << std::setw(9) << stage.count
+            << std::setw(11) << stage.total_ns / 1e6
+            << std::setw(9) << stage.total_ns / 1e6 / stage.count
+            << std::setw(9) << stage.percentileMs(0.50)
+            << std::setw(9) << stage.percentileMs(0.90)
+            << std::setw(9) << stage.percentileMs(0.99)
+            << std::setw(9) << stage.max_ns / 1e6 << "\n";
+    }
+    out << "bytes decoded: " << snapshot.counters[static_cast<int>(ProfileCounter::BytesDecoded)] << "\n";
+    out << "frames sampled: " << snapshot.counters[static_cast<int>(ProfileCounter::FramesSampled)] << "\n";
+    out << "near-duplicate hits: " << snapshot.counters[static_cast<int>(ProfileCounter::DuplicateHits)]
+        << ", misses: " << snapshot.counters[static_cast<int>(ProfileCounter::DuplicateMisses)] << "\n";
+    out << "video segments reused: " << snapshot.counters[static_cast<int>(ProfileCounter::SegmentsReused)]
+        << ", decoded: " << snapshot.counters[static_cast<int>(ProfileCounter::SegmentsDecoded)] << "\n";
+    out << "cascade early exits: " << snapshot.counters[static_cast<int>(ProfileCounter::CascadeExits)]
+        << ", passed on: " << snapshot.counters[static_cast<int>(ProfileCounter::CascadePassed)] << "\n";
+    out << std::defaultfloat;
+}
+
+bool Profiler::writePrometheus(const std::string& path) {
+    Snapshot snapshot = takeSnapshot();
+
+    // Exported bucket bounds in seconds, 1-2-5 steps from 10us to 10s
+    std::vector<double> bounds;
+    for (double decade = 1e-5; decade < 10.0; decade *= 10.0) {
+        bounds.push_back(decade);
+        bounds.push_back(decade * 2.0);
+        bounds.push_back(decade * 5.0);
+    }
+    bounds.push_back(10.0);
+
+    std::ostringstream out;
+    out << "# HELP ai_detector_stage_seconds Time spent in each pipeline stage.\n";
+    out << "# TYPE ai_detector_stage_seconds histogram\n";
+    for (int s = 0; s < STAGES; ++s) {
+        const StageSummary& stage = snapshot.stages[s];
+        const char* name = stageName(static_cast<ProfileStage>(s));
+
+        // A native bucket counts towards a bound once its upper edge is within it
+        int b = 0;
+        uint64_t cumulative = 0;
+        for (double bound : bounds) {
+            uint64_t bound_ns = static_cast<uint64_t>(bound * 1e9);
+            while (b < BUCKETS && bucketUpperBound(b) <= bound_ns) {
+                cumulative += stage.buckets[b++];
+            }
+            out << "ai_detector_stage_seconds_bucket{stage=\"" << name << "\",le=\"" << bound << "\"} "
+                << cumulative << "\n";
+        }
+        out << "ai_detector_stage_seconds_bucket{stage=\"" << name << "\",le=\"+Inf\"} " << stage.count << "\n";
+        out << "ai_detector_stage_seconds_sum{stage=\"" << name << "\"} " << stage.total_ns / 1e9 << "\n";
+        out << "ai_detector_stage_seconds_count{stage=\"" << name << "\"} " << stage.count << "\n";
+    }
+
+    out << "# HELP ai_detector_bytes_decoded_total Bytes of decoded frame data.\n";
+    out << "# TYPE ai_detector_bytes_decoded_total counter\n";
+    out << "ai_detector_bytes_decoded_total " << snapshot.counters[static_cast<int>(ProfileCounter::BytesDecoded)] << "\n";
+    out << "# HELP ai_detector_frames_sampled_total Frames sampled for analysis.\n";
+    out << "# TYPE ai_detector_frames_sampled_total counter\n";
+    out << "ai_detector_frames_sampled_total " << snapshot.counters[static_cast<int>(ProfileCounter::FramesSampled)] << "\n";
+    out << "# HELP ai_detector_duplicate_lookups_total Near-duplicate index lookups by result.\n";
+    out << "# TYPE ai_detector_duplicate_lookups_total counter\n";
+    out << "ai_detector_duplicate_lookups_total{result=\"hit\"} "
+        << snapshot.counters[static_cast<int>(ProfileCounter::DuplicateHits)] << "\n";
+    out << "ai_detector_duplicate_lookups_total{result=\"miss\"} "
+        << snapshot.counters[static_cast<int>(ProfileCounter::DuplicateMisses)] << "\n";
+    out << "# HELP ai_detector_video_segments_total Cached video analysis segments by source.\n";
+    out << "# TYPE ai_detector_video_segments_total counter\n";
+    out << "ai_detector_video_segments_total{source=\"cache\"} "
+        << snapshot.counters[static_cast<int>(ProfileCounter::SegmentsReused)] << "\n";
+    out << "ai_detector_video_segments_total{source=\"decoded\"} "
+        << snapshot.counters[static_cast<int>(ProfileCounter::SegmentsDecoded)] << "\n";
+    out << "# HELP ai_detector_cascade_images_total Images by the cascade stage that decided them.\n";
+    out << "# TYPE ai_detector_cascade_images_total counter\n";
+    out << "ai_detector_cascade_images_total{stage=\"1\"} "
+        << snapshot.counters[static_cast<int>(ProfileCounter::CascadeExits)] << "\n";
+    out << "ai_detector_cascade_images_total{stage=\"2\"} "
+        << snapshot.counters[static_cast<int>(ProfileCounter::CascadePassed)] << "\n";
+
+    return writeAtomically(path, out.str());
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+    std::ostringstream out;
+    out << "{\"traceEvents\":[";
+    bool first = true;
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& profile : reg.profiles) {
+        std::lock_guard<std::mutex> trace_lock(profile->trace_mutex);
+        for (const TraceEvent& event : profile->trace) {
+            out << (first ? "\n" : ",\n");
+            out << "{\"name\":\"" << stageName(event.stage) << "\",\"cat\":\"ai_detector\",\"ph\":\"X\""
+                << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us
+                << ",\"pid\":1,\"tid\":" << profile->thread_id << "}";
+            first = false;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    return writeAtomically(path, out.str());
+}
@@ -0,0 +1,116 @@
+#include "../include/scratch_arena.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+namespace {
+
+// cv::Mat allocator backed by the calling thread's arena while a scope is
+// open. Headers and data both live in the arena; deallocation only runs the
+// header's destructor. Everything else goes to the standard allocator, whose
+// UMatData then frees itself as usual.
+class ArenaMatAllocator : public cv::MatAllocator {
+public:
+    ArenaMatAllocator() : std_allocator_(cv::Mat::getStdAllocator()) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data0, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usage_flags) const override {
+        ScratchArena& arena = ScratchArena::local();
+        if (data0 || !arena.active()) {
+            return std_allocator_->allocate(dims, sizes, type, data0, step, flags, usage_flags);
+        }
+
+        // Continuous layout, as the standard allocator produces without user data
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; --i) {
+            if (step) {
+                step[i] = total;
+            }
+            total *= sizes[i];
+        }
+
+        void* header = arena.allocate(sizeof(cv::UMatData), alignof(cv::UMatData));
+        cv::UMatData* u = new (header) cv::UMatData(this);
+        u->data = u->origdata = static_cast<uchar*>(arena.allocate(total));
+        u->size = total;
+        return u;
+    }
+
+    bool allocate(cv::UMatData* u, cv::AccessFlag, cv::UMatUsageFlags) const override {
+        return u != nullptr;
+    }
+
+    void deallocate(cv::UMatData* u) const override {
+        // The memory itself is reclaimed when its scope rewinds the arena
+        if (u) {
+            u->~UMatData();
+        }
+    }
+
+private:
+    cv::MatAllocator* std_allocator_;
+};
+
+} // namespace
+
+ScratchArena& ScratchArena::local() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+void ScratchArena::installMatAllocator() {
+    static std::once_flag installed;
+    std::call_once(installed, []() {
+        // Never destroyed: matrices may still be released during static destruction
+        cv::Mat::setDefaultAllocator(new ArenaMatAllocator());
+    });
+}
+
+void* ScratchArena::allocate(size_t bytes, size_t alignment) {
+    while (current_ < chunks_.size()) {
+        Chunk& chunk = chunks_[current_];
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunk.memory.get());
+        uintptr_t aligned = (base + offset_ + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+        if (aligned + bytes <= base + chunk.size) {
+            offset_ = aligned + bytes - base;
+            return reinterpret_cast<void*>(aligned);
+        }
+
+        // Chunks past the current one are unused; drop them if too small to help
+        ++current_;
+        offset_ = 0;
+        if (current_ < chunks_.size() && chunks_[current_].size < bytes + alignment) {
+            chunks_.erase(chunks_.begin() + current_, chunks_.end());
+        }
+    }
+
+    size_t size = std::max(MIN_CHUNK_SIZE, bytes + alignment);
+    if (!chunks_.empty()) {
+        size = std::max(size, chunks_.back().size * 2);
+    }
+    chunks_.push_back({std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+    current_ = chunks_.size() - 1;
+    offset_ = 0;
+    return allocate(bytes, alignment);
+}
+
+void ScratchArena::trim() {
+    // Chunks up to the current one may still hold a paused caller's data
+    size_t kept = 0;
+    size_t count = 0;
+    while (count < chunks_.size() && (count <= current_ || kept + chunks_[count].size <= MAX_RETAINED)) {
+        kept += chunks_[count].size;
+        ++count;
+    }
+    chunks_.erase(chunks_.begin() + count, chunks_.end());
+}
+
+size_t ScratchArena::capacity() const {
+    size_t total = 0;
+    for (const auto& chunk : chunks_) {
+        total += chunk.size;
+    }
+    return total;
+}
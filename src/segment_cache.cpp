@@ -0,0 +1,190 @@
+#include "../include/segment_cache.h"
+#include "../include/file_io.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// FNV-1a of size bytes of a file starting at offset
+bool hashRange(std::ifstream& file, uint64_t offset, uint64_t size, uint64_t& hash) {
+    std::vector<char> buffer(size);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(offset));
+    if (!file.read(buffer.data(), static_cast<std::streamsize>(size))) {
+        return false;
+    }
+    hash = fnv1a(buffer.data(), buffer.size());
+    return true;
+}
+
+void putIdentity(std::ostream& out, const FileIdentity& identity) {
+    put(out, identity.size);
+    put(out, identity.mtime);
+    put(out, identity.head_hash);
+    put(out, identity.tail_hash);
+}
+
+bool getIdentity(std::istream& in, FileIdentity& identity) {
+    return get(in, identity.size) && get(in, identity.mtime) &&
+           get(in, identity.head_hash) && get(in, identity.tail_hash);
+}
+
+} // namespace
+
+bool FileIdentity::read(const std::string& path, FileIdentity& identity) {
+    std::error_code error;
+    identity.size = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    auto written = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+    identity.mtime = static_cast<int64_t>(written.time_since_epoch().count());
+
+    std::ifstream file(path, std::ios::binary);
+    const uint64_t span = std::min(identity.size, IDENTITY_BYTES);
+    return file && hashRange(file, 0, span, identity.head_hash) &&
+           hashRange(file, identity.size - span, span, identity.tail_hash);
+}
+
+bool FileIdentity::operator==(const FileIdentity& other) const {
+    return size == other.size && mtime == other.mtime &&
+           head_hash == other.head_hash && tail_hash == other.tail_hash;
+}
+
+bool FileIdentity::isPrefixOf(const std::string& path) const {
+    std::error_code error;
+    uint64_t current_size = std::filesystem::file_size(path, error);
+    // Same size with another identity is a rewrite, not an append
+    if (error || current_size <= size) {
+        return false;
+    }
+    std::ifstream file(path, std::ios::binary);
+    const uint64_t span = std::min(size, IDENTITY_BYTES);
+    uint64_t head = 0, tail = 0;
+    return file && hashRange(file, 0, span, head) && head == head_hash &&
+           hashRange(file, size - span, span, tail) && tail == tail_hash;
+}
+
+SegmentCache::SegmentCache(const std::string& directory) : directory_(directory) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Cannot create segment cache directory: " << directory << std::endl;
+    }
+}
+
+std::string SegmentCache::entryPath(const FileIdentity& identity) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.segments", static_cast<unsigned long long>(identity.head_hash));
+    return (std::filesystem::path(directory_) / name).string();
+}
+
+std::map<int, CachedSegment> SegmentCache::load(const std::string& path, const FileIdentity& identity,
+                                                uint64_t settings, int& total_frames) const {
+    std::map<int, CachedSegment> segments;
+    total_frames = 0;
+
+    const std::string entry = entryPath(identity);
+    std::string data;
+    SnapshotStatus status = readSnapshot(entry, data);
+    if (status == SnapshotStatus::Missing) {
+        return segments;
+    }
+
+    std::istringstream in(data, std::ios::binary);
+    char magic[4];
+    uint32_t version = 0;
+    FileIdentity cached;
+    uint64_t cached_settings = 0, count = 0;
+    int32_t cached_frames = 0;
+    if (status != SnapshotStatus::Ok ||
+        !in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !get(in, version) || version != VERSION || !getIdentity(in, cached) ||
+        !get(in, cached_settings) || !get(in, cached_frames) || !get(in, count)) {
+        std::cerr << "Ignoring damaged segment cache: " << entry << std::endl;
+        return segments;
+    }
+
+    // Another sampling layout or analyzer set, or a file that was rewritten
+    const bool unchanged = cached == identity;
+    if (cached_settings != settings || (!unchanged && !cached.isPrefixOf(path))) {
+        return segments;
+    }
+
+    for (uint64_t s = 0; s < count; ++s) {
+        int32_t index = 0;
+        uint8_t complete = 0;
+        uint32_t rows = 0, cols = 0, analyzers = 0;
+        if (!get(in, index) || !get(in, complete) || !get(in, rows) || !get(in, cols) ||
+            static_cast<uint64_t>(rows) * cols > (1u << 26)) {
+            segments.clear();
+            return segments;
+        }
+        CachedSegment segment;
+        segment.complete = complete != 0;
+        segment.features.resize(rows, cols);
+        in.read(reinterpret_cast<char*>(segment.features.data()), sizeof(float) * rows * cols);
+        if (!in || !get(in, analyzers) || analyzers > 1024) {
+            segments.clear();
+            return segments;
+        }
+        segment.samples.resize(analyzers);
+        for (auto& samples : segment.samples) {
+            uint32_t size = 0;
+            if (!get(in, size) || size > (1u << 24)) {
+                segments.clear();
+                return segments;
+            }
+            samples.resize(size);
+            in.read(reinterpret_cast<char*>(samples.data()), sizeof(float) * size);
+        }
+        if (!in) {
+            segments.clear();
+            return segments;
+        }
+
+        // After an append only segments that lay wholly in the old file are
+        // still right; the last one may now have more frames
+        if (unchanged || segment.complete) {
+            segments.emplace(index, std::move(segment));
+        }
+    }
+    if (unchanged) {
+        total_frames = cached_frames;
+    }
+    return segments;
+}
+
+bool SegmentCache::save(const FileIdentity& identity, uint64_t settings, int total_frames,
+                        const std::map<int, CachedSegment>& segments) const {
+    std::ostringstream out(std::ios::binary);
+    out.write(MAGIC, sizeof(MAGIC));
+    put(out, VERSION);
+    putIdentity(out, identity);
+    put(out, settings);
+    put(out, static_cast<int32_t>(total_frames));
+    put(out, static_cast<uint64_t>(segments.size()));
+    for (const auto& entry : segments) {
+        const CachedSegment& segment = entry.second;
+        put(out, static_cast<int32_t>(entry.first));
+        put(out, static_cast<uint8_t>(segment.complete ? 1 : 0));
+        put(out, static_cast<uint32_t>(segment.features.rows()));
+        put(out, static_cast<uint32_t>(segment.features.cols()));
+        out.write(reinterpret_cast<const char*>(segment.features.data()), sizeof(float) * segment.features.size());
+        put(out, static_cast<uint32_t>(segment.samples.size()));
+        for (const auto& samples : segment.samples) {
+            put(out, static_cast<uint32_t>(samples.size()));
+            out.write(reinterpret_cast<const char*>(samples.data()), sizeof(float) * samples.size());
+        }
+    }
+
+    return writeSnapshot(entryPath(identity), out.str(), "segment cache");
+}
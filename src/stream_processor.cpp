@@ -0,0 +1,213 @@
+#include "../include/stream_processor.h"
+#include "../include/video_processor.h"
+#include "../include/profiler.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Newest decoded frame waiting for the analyzer
+struct PendingFrame {
+    cv::Mat frame;
+    long long number = 0;
+    Clock::time_point arrival;
+};
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Stops and joins the reader thread on every way out of run(), including an
+// analyzer or the network throwing; the reader notices after its current frame
+struct ReaderJoiner {
+    std::thread& thread;
+    std::function<void()> stop;
+
+    ~ReaderJoiner() {
+        if (thread.joinable()) {
+            stop();
+            thread.join();
+        }
+    }
+};
+
+} // namespace
+
+StreamProcessor::StreamProcessor(FeatureExtractor& feature_extractor,
+                                 const NeuralNetwork& neural_network,
+                                 MotionQuality motion_quality)
+    : feature_extractor_(feature_extractor),
+      neural_network_(neural_network),
+      motion_engine_(motion_quality) {
+    frame_scorer_.setNeuralNetwork(&neural_network_);
+}
+
+bool StreamProcessor::run(FrameReader& reader, const StreamOptions& options,
+                          const std::function<void(const StreamScore&)>& on_score) {
+    const size_t window_size = static_cast<size_t>(std::max(2, options.window));
+    // Unscored frames must still be in the window when their batch is scored
+    const size_t emit_every = std::min(window_size, static_cast<size_t>(std::max(1, options.emit_every)));
+    const cv::Size analysis_size(options.analysis_size, options.analysis_size);
+    const auto budget = std::chrono::milliseconds(options.latency_budget_ms);
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    PendingFrame slot;
+    bool slot_full = false;
+    bool finished = false;
+    bool stopping = false;
+    long long dropped = 0;
+
+    // Reader: decode and reduce frames as they arrive, keeping only the newest
+    std::thread reader_thread([&]() {
+        cv::Mat frame;
+        long long number = 0;
+        while (reader.readFrame(frame)) {
+            Profiler::count(ProfileCounter::BytesDecoded, frame.total() * frame.elemSize());
+            PendingFrame item;
+            cv::resize(frame, item.frame, analysis_size, 0, 0, cv::INTER_AREA);
+            item.number = number++;
+            item.arrival = Clock::now();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) {
+                    break;
+                }
+                if (slot_full) {
+                    ++dropped;
+                }
+                slot = std::move(item);
+                slot_full = true;
+            }
+            ready.notify_one();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        ready.notify_one();
+    });
+    ReaderJoiner reader_joiner{reader_thread, [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }};
+
+    window_.clear();
+    std::vector<Eigen::VectorXf> pending_features;
+    IncrementalFeatureState feature_state;
+    cv::Mat prev_gray, prev_motion;
+    long long analyzed = 0;
+
+    auto emit = [&](const PendingFrame& newest) {
+        // Score every frame analyzed since the last emission in one batch
+        Eigen::MatrixXf batch(pending_features.front().size(), pending_features.size());
+        for (size_t i = 0; i < pending_features.size(); ++i) {
+            batch.col(i) = pending_features[i];
+        }
+        std::vector<float> predictions = frame_scorer_.score(batch);
+
+        size_t first = window_.size() - pending_features.size();
+        for (size_t i = 0; i < pending_features.size(); ++i) {
+            window_[first + i].score = predictions[i];
+            window_[first + i].scored = true;
+        }
+        pending_features.clear();
+
+        StreamScore result;
+        result.frame_number = newest.number;
+        result.score = rollingScore();
+        result.window_frames = static_cast<int>(window_.size());
+        result.analyzed = analyzed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result.dropped = dropped;
+        }
+        result.latency_ms = millisecondsSince(newest.arrival);
+        on_score(result);
+    };
+
+    PendingFrame item;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&]() { return slot_full || finished; });
+            if (!slot_full) {
+                break;
+            }
+            item = std::move(slot);
+            slot_full = false;
+
+            // A frame that already waited past the budget cannot be reported in time
+            if (Clock::now() - item.arrival > budget) {
+                ++dropped;
+                continue;
+            }
+        }
+
+        WindowEntry entry;
+        entry.frame_number = item.number;
+        Profiler::count(ProfileCounter::FramesSampled, 1);
+        if (options.incremental_features) {
+            pending_features.push_back(feature_extractor_.extractFeaturesIncremental(item.frame, feature_state));
+        } else {
+            pending_features.push_back(feature_extractor_.extractFeatures(item.frame));
+        }
+
+        // Differences are taken on grayscale; the gray frame also feeds motion
+        cv::Mat gray;
+        cv::cvtColor(item.frame, gray, cv::COLOR_BGR2GRAY);
+        cv::Mat motion_input = motion_engine_.prepareFrame(gray);
+        if (!prev_gray.empty()) {
+            ScopedTimer timer(ProfileStage::TemporalAnalysis);
+            cv::Mat diff;
+            cv::absdiff(prev_gray, gray, diff);
+            entry.difference = static_cast<float>(cv::mean(diff)[0] / 255.0);
+            entry.motion = motion_engine_.calculateUniformity(prev_motion, motion_input);
+            entry.has_pair = true;
+        }
+        prev_gray = gray;
+        prev_motion = motion_input;
+
+        window_.push_back(entry);
+        while (window_.size() > window_size) {
+            window_.pop_front();
+        }
+        ++analyzed;
+
+        if (pending_features.size() >= emit_every) {
+            emit(item);
+        }
+    }
+
+    reader_thread.join();
+
+    if (!pending_features.empty()) {
+        emit(item);
+    }
+
+    if (analyzed == 0) {
+        std::cerr << "No frames analyzed from stream" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+float StreamProcessor::rollingScore() const {
+    std::vector<float> frame_scores, differences, motion_scores;
+    for (size_t i = 0; i < window_.size(); ++i) {
+        if (window_[i].scored) {
+            frame_scores.push_back(window_[i].score);
+        }
+        // The first entry's pair reaches back to a frame outside the window
+        if (i > 0 && window_[i].has_pair) {
+            differences.push_back(window_[i].difference);
+            motion_scores.push_back(window_[i].motion);
+        }
+    }
+    return VideoProcessor::combineScores(frame_scores, differences, motion_scores);
+}
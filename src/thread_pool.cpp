@@ -0,0 +1,146 @@
+#include "../include/thread_pool.h"
+#include "../include/scratch_arena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// Pool and worker index of the calling thread
+struct WorkerIdentity {
+    const ThreadPool* pool = nullptr;
+    int index = -1;
+};
+
+thread_local WorkerIdentity current_worker;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t num_threads) : queued_(0), stopping_(false) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    queues_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+
+    workers_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_.emplace_back([this, i]() { workerLoop(static_cast<int>(i)); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::threadsFromEnvironment() {
+    const char* value = std::getenv("AI_DETECTOR_THREADS");
+    if (!value) {
+        return 0;
+    }
+    try {
+        return static_cast<size_t>(std::max(0, std::stoi(value)));
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+int ThreadPool::currentWorker() const {
+    return current_worker.pool == this ? current_worker.index : -1;
+}
+
+void ThreadPool::enqueue(Task task) {
+    int self = currentWorker();
+    WorkQueue& queue = self >= 0 ? *queues_[self] : injection_;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        ++queued_;
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::popTask(int self, Task& task) {
+    // Own work first, newest first: it is the most likely to be cache-warm
+    if (self >= 0) {
+        WorkQueue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(injection_.mutex);
+        if (!injection_.tasks.empty()) {
+            task = std::move(injection_.tasks.front());
+            injection_.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // Steal the oldest task of another worker, starting after our own slot
+    size_t count = queues_.size();
+    size_t start = self >= 0 ? static_cast<size_t>(self) + 1 : 0;
+    for (size_t k = 0; k < count; ++k) {
+        size_t victim = (start + k) % count;
+        if (static_cast<int>(victim) == self) {
+            continue;
+        }
+        WorkQueue& queue = *queues_[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runOne() {
+    Task task;
+    if (!popTask(currentWorker(), task)) {
+        return false;
+    }
+    --queued_;
+    // A task taken while waiting inside a ScratchScope is not part of the
+    // waiter's request; its results must not land in the waiter's arena
+    ScratchPause pause;
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(int index) {
+    current_worker.pool = this;
+    current_worker.index = index;
+
+    while (true) {
+        if (runOne()) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        // Drain remaining work before exiting
+        if (stopping_ && queued_.load() <= 0) {
+            return;
+        }
+        wake_.wait(lock, [this]() { return stopping_ || queued_.load() > 0; });
+    }
+}
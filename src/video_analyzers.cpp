@@ -0,0 +1,214 @@
+#include "../include/video_analyzers.h"
+#include "../include/profiler.h"
+#include "../include/scratch_arena.h"
+#include <algorithm>
+#include <cmath>
+
+FrameProducts::FrameProducts(const MotionEngine& motion_engine, FeatureSource feature_source)
+    : motion_engine_(motion_engine), feature_source_(std::move(feature_source)) {}
+
+void FrameProducts::addFrame(int index, const cv::Mat& frame, bool owned) {
+    Entry entry;
+    entry.index = index;
+    entry.owned = owned;
+    entry.frame = frame;
+    if (owned) {
+        Profiler::count(ProfileCounter::FramesSampled, 1);
+    }
+
+    auto position = std::upper_bound(entries_.begin(), entries_.end(), index,
+                                     [](int value, const Entry& e) { return value < e.index; });
+    entries_.insert(position, std::move(entry));
+}
+
+const cv::Mat& FrameProducts::gray(size_t position) {
+    Entry& entry = entries_[position];
+    if (entry.gray.empty()) {
+        if (entry.frame.channels() == 3) {
+            cv::cvtColor(entry.frame, entry.gray, cv::COLOR_BGR2GRAY);
+        } else {
+            entry.gray = entry.frame;
+        }
+    }
+    return entry.gray;
+}
+
+const cv::Mat& FrameProducts::motionInput(size_t position) {
+    Entry& entry = entries_[position];
+    if (entry.motion_input.empty()) {
+        entry.motion_input = motion_engine_.prepareFrame(gray(position));
+    }
+    return entry.motion_input;
+}
+
+Eigen::MatrixXf FrameProducts::ownedFeatures() {
+    // Extract everything still missing in one call so the source can batch it
+    std::vector<cv::Mat> missing_frames;
+    std::vector<size_t> missing_positions;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].owned && entries_[i].features.size() == 0) {
+            missing_frames.push_back(entries_[i].frame);
+            missing_positions.push_back(i);
+        }
+    }
+    if (!missing_frames.empty()) {
+        Eigen::MatrixXf extracted = feature_source_(missing_frames);
+        for (size_t k = 0; k < missing_positions.size(); ++k) {
+            entries_[missing_positions[k]].features = extracted.col(k);
+        }
+    }
+
+    std::vector<size_t> owned;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (entries_[i].owned) {
+            owned.push_back(i);
+        }
+    }
+
+    Eigen::MatrixXf features;
+    if (owned.empty()) {
+        return features;
+    }
+    features.resize(entries_[owned[0]].features.size(), owned.size());
+    for (size_t k = 0; k < owned.size(); ++k) {
+        features.col(k) = entries_[owned[k]].features;
+    }
+    return features;
+}
+
+std::pair<int, int> FrameProducts::pairKey(size_t position) const {
+    return std::make_pair(entries_[position - 1].index, entries_[position].index);
+}
+
+float FrameProducts::difference(size_t position) {
+    auto key = pairKey(position);
+    auto cached = differences_.find(key);
+    if (cached != differences_.end()) {
+        return cached->second;
+    }
+
+    ScratchScope scope;
+    cv::Mat diff;
+    cv::absdiff(entries_[position - 1].frame, entries_[position].frame, diff);
+
+    // Convert to grayscale if needed
+    if (diff.channels() == 3) {
+        cv::cvtColor(diff, diff, cv::COLOR_BGR2GRAY);
+    }
+
+    // Calculate mean difference
+    float value = static_cast<float>(cv::mean(diff)[0] / 255.0f);
+    differences_.emplace(key, value);
+    return value;
+}
+
+const FlowStats& FrameProducts::flowStats(size_t position) {
+    auto key = pairKey(position);
+    auto cached = flow_stats_.find(key);
+    if (cached == flow_stats_.end()) {
+        FlowStats stats = motion_engine_.calculateFlowStats(motionInput(position - 1), motionInput(position));
+        cached = flow_stats_.emplace(key, stats).first;
+    }
+    return cached->second;
+}
+
+std::vector<float> FrameScoreAnalyzer::collect(FrameProducts& products) {
+    return score(products.ownedFeatures());
+}
+
+std::vector<float> FrameScoreAnalyzer::score(const Eigen::MatrixXf& features) const {
+    std::vector<float> scores;
+    if (features.cols() == 0) {
+        return scores;
+    }
+
+    if (ensemble_ && ensemble_->size() > 0 && ensemble_->inputSize() == features.rows()) {
+        // All member models share the features and the first-layer GEMM
+        Eigen::VectorXf combined = ensemble_->combine(ensemble_->predictBatch(features));
+        return std::vector<float>(combined.data(), combined.data() + combined.size());
+    }
+
+    if (neural_network_ && neural_network_->inputSize() == features.rows()) {
+        // Single batched forward pass over all owned frames
+        Eigen::VectorXf predictions = neural_network_->predictBatch(features);
+        return std::vector<float>(predictions.data(), predictions.data() + predictions.size());
+    }
+
+    for (int i = 0; i < features.cols(); ++i) {
+        // Calculate feature statistics
+        float mean = features.col(i).mean();
+        float stddev = std::sqrt((features.col(i).array() - mean).square().mean());
+
+        // Simple heuristic: AI-generated content often has more uniform feature distributions
+        scores.push_back(1.0f - std::min(stddev, 1.0f));
+    }
+    return scores;
+}
+
+float FrameScoreAnalyzer::reduce(const std::vector<float>& samples) const {
+    if (samples.empty()) {
+        return 0.5f;
+    }
+
+    float avg_frame_score = 0.0f;
+    for (float score : samples) {
+        avg_frame_score += score;
+    }
+    return avg_frame_score / samples.size();
+}
+
+std::vector<float> TemporalConsistencyAnalyzer::collect(FrameProducts& products) {
+    ScopedTimer timer(ProfileStage::TemporalAnalysis);
+    std::vector<float> differences;
+    for (size_t i = 1; i < products.frameCount(); ++i) {
+        if (products.isOwned(i)) {
+            differences.push_back(products.difference(i));
+        }
+    }
+    return differences;
+}
+
+float TemporalConsistencyAnalyzer::reduce(const std::vector<float>& samples) const {
+    if (samples.empty()) {
+        return 0.5f; // Neutral score for single frame
+    }
+
+    float mean_diff = 0.0f;
+    for (float diff : samples) {
+        mean_diff += diff;
+    }
+    mean_diff /= samples.size();
+
+    float variance = 0.0f;
+    for (float diff : samples) {
+        variance += (diff - mean_diff) * (diff - mean_diff);
+    }
+    variance /= samples.size();
+
+    // AI-generated videos often have more consistent frame-to-frame differences
+    // Real videos typically have more natural variation
+    return 1.0f - std::min(variance, 1.0f);
+}
+
+std::vector<float> MotionPatternAnalyzer::collect(FrameProducts& products) {
+    ScopedTimer timer(ProfileStage::MotionAnalysis);
+    std::vector<float> motion_scores;
+    for (size_t i = 1; i < products.frameCount(); ++i) {
+        if (products.isOwned(i)) {
+            motion_scores.push_back(MotionEngine::uniformity(products.flowStats(i)));
+        }
+    }
+    return motion_scores;
+}
+
+float MotionPatternAnalyzer::reduce(const std::vector<float>& samples) const {
+    if (samples.empty()) {
+        return 0.5f; // Neutral score for single frame
+    }
+
+    float avg_motion_score = 0.0f;
+    for (float score : samples) {
+        avg_motion_score += score;
+    }
+    return avg_motion_score / samples.size();
+}
@@ -1,208 +1,987 @@
 #include "../include/video_processor.h"
+#include "../include/profiler.h"
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <sstream>
 
-VideoProcessor::VideoProcessor() {
+namespace {
+
+// Timed decode; bytes are counted for frames that are actually converted
+bool readFrame(cv::VideoCapture& cap, cv::Mat& frame) {
+    ScopedTimer timer(ProfileStage::Decode);
+    if (!cap.read(frame)) {
+        return false;
+    }
+    Profiler::count(ProfileCounter::BytesDecoded, frame.total() * frame.elemSize());
+    return true;
+}
+
+bool grabFrame(cv::VideoCapture& cap) {
+    ScopedTimer timer(ProfileStage::Decode);
+    return cap.grab();
+}
+
+bool retrieveFrame(cv::VideoCapture& cap, cv::Mat& frame) {
+    ScopedTimer timer(ProfileStage::Decode);
+    if (!cap.retrieve(frame)) {
+        return false;
+    }
+    Profiler::count(ProfileCounter::BytesDecoded, frame.total() * frame.elemSize());
+    return true;
+}
+
+// Frames to back off by when a seek does not land where it was asked to
+constexpr int SEEK_BACKOFF = 16;
+
+// Position the capture at or before target and return the frame it is at.
+// Seeking inter-coded streams is not exact, so a seek is only trusted when
+// the capture reports the frame asked for; otherwise earlier frames are
+// tried, down to a fresh capture at frame 0. Returns -1 if it cannot reopen.
+int seekAtOrBefore(cv::VideoCapture& cap, const std::string& video_path, int target) {
+    for (int back = 0; target - back > 0; back = std::max(SEEK_BACKOFF, back * 2)) {
+        int start = target - back;
+        if (cap.set(cv::CAP_PROP_POS_FRAMES, start) &&
+            std::llround(cap.get(cv::CAP_PROP_POS_FRAMES)) == start) {
+            return start;
+        }
+    }
+    if (target > 0 && !cap.open(video_path)) {
+        return -1;
+    }
+    return 0;
+}
+
+// Wait for every future before rethrowing the first failure: the tasks
+// reference state on the caller's stack
+template <typename T, typename Consume>
+void waitAll(ThreadPool& pool, std::vector<std::future<T>>& pending, Consume consume) {
+    std::exception_ptr failure;
+    for (size_t i = 0; i < pending.size(); ++i) {
+        try {
+            consume(i, pool.wait(pending[i]));
+        } catch (...) {
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+} // namespace
+
+VideoProcessor::VideoProcessor() : thread_pool_(nullptr), parallel_segments_(1), incremental_features_(false) {
     feature_extractor_ = std::make_unique<FeatureExtractor>();
+    
+    auto frame_analyzer = std::make_unique<FrameScoreAnalyzer>();
+    frame_analyzer_ = frame_analyzer.get();
+    registerAnalyzer(std::move(frame_analyzer), 0.6f);
+    registerAnalyzer(std::make_unique<TemporalConsistencyAnalyzer>(), 0.2f);
+    
+    auto motion_analyzer = std::make_unique<MotionPatternAnalyzer>();
+    motion_analyzer_ = motion_analyzer.get();
+    registerAnalyzer(std::move(motion_analyzer), 0.2f);
+}
+
+void VideoProcessor::registerAnalyzer(std::unique_ptr<VideoAnalyzer> analyzer, float weight) {
+    analyzers_.push_back({std::move(analyzer), weight});
+}
+
+void VideoProcessor::setThreadPool(ThreadPool* pool) {
+    thread_pool_ = pool;
+    feature_extractor_->setThreadPool(pool);
+}
+
+void VideoProcessor::setParallelSegments(int segments) {
+    parallel_segments_ = std::max(1, segments);
+}
+
+ThreadPool& VideoProcessor::threadPool() {
+    if (thread_pool_) {
+        return *thread_pool_;
+    }
+    // Standalone use: a private pool, one worker per hardware thread
+    if (!own_thread_pool_) {
+        own_thread_pool_ = std::make_unique<ThreadPool>();
+    }
+    return *own_thread_pool_;
 }
 
 float VideoProcessor::processVideo(const std::string& video_path) {
+    return analyzeVideo(video_path).score;
+}
+
+VideoAnalysis VideoProcessor::analyzeVideo(const std::string& video_path) {
+    if (adaptive_.enabled) {
+        return analyzeVideoAdaptive(video_path);
+    }
+    if (shots_.enabled) {
+        return analyzeVideoShots(video_path);
+    }
+    if (caching_.enabled) {
+        return analyzeVideoCached(video_path);
+    }
+    if (parallel_segments_ > 1) {
+        return analyzeVideoParallel(video_path);
+    }
+    return analyzeVideoSequential(video_path);
+}
+
+VideoAnalysis VideoProcessor::analyzeVideo(const std::string& video_path, const Deadline& deadline) {
+    if (!deadline.limited()) {
+        return analyzeVideo(video_path);
+    }
+    return analyzeVideoDeadline(video_path, deadline);
+}
+
+VideoAnalysis VideoProcessor::analyzeVideoSequential(const std::string& video_path) {
     // Extract frames from video
     std::vector<cv::Mat> frames = extractFrames(video_path);
     
     if (frames.empty()) {
         std::cerr << "No frames extracted from video: " << video_path << std::endl;
-        return -1.0f;
+        return VideoAnalysis();
     }
     
-    // Process individual frames
-    std::vector<float> frame_scores = processFrames(frames);
+    return analyzeFrameSet(frames);
+}
+
+VideoAnalysis VideoProcessor::analyzeFrameSet(const std::vector<cv::Mat>& frames) {
+    VideoAnalysis analysis;
     
-    // Analyze temporal consistency
-    float temporal_score = analyzeTemporalConsistency(frames);
+    FrameProducts products = makeProducts(frames, true);
+    AnalyzerSamples samples = collectSamples(products);
     
-    // Analyze motion patterns
-    float motion_score = analyzeMotionPatterns(frames);
+    analysis.score = reduceSamples(samples, analysis);
+    analysis.frames_used = static_cast<int>(frames.size());
+    return analysis;
+}
+
+VideoAnalysis VideoProcessor::analyzeVideoParallel(const std::string& video_path) {
+    VideoAnalysis analysis;
     
-    // Combine scores (weighted average)
-    float avg_frame_score = 0.0f;
-    for (float score : frame_scores) {
-        avg_frame_score += score;
+    cv::VideoCapture cap(video_path);
+    if (!cap.isOpened()) {
+        std::cerr << "Failed to open video: " << video_path << std::endl;
+        return analysis;
     }
-    avg_frame_score /= frame_scores.size();
+    int total_frames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    cap.release();
     
-    // Final score combines frame analysis, temporal consistency, and motion patterns
-    float final_score = 0.6f * avg_frame_score + 0.2f * temporal_score + 0.2f * motion_score;
+    // Without a reliable frame count the timeline cannot be split up front
+    std::vector<int> indices = sampleFrameIndices(total_frames, MAX_FRAMES);
+    int num_segments = std::min(parallel_segments_, static_cast<int>(indices.size()));
+    if (num_segments < 2) {
+        return analyzeVideoSequential(video_path);
+    }
     
-    return final_score;
+    // Every segment after the first also decodes the previous segment's last
+    // sampled frame so the boundary pair gets temporal and motion analysis
+    std::vector<std::future<bool>> pending;
+    std::vector<AnalyzerSamples> segments(num_segments);
+    for (int s = 0; s < num_segments; ++s) {
+        size_t begin = indices.size() * s / num_segments;
+        size_t end = indices.size() * (s + 1) / num_segments;
+        size_t first = (s == 0) ? begin : begin - 1;
+        std::vector<int> segment_indices(indices.begin() + first, indices.begin() + end);
+        size_t first_owned = begin - first;
+        
+        pending.push_back(threadPool().submit([this, &video_path, &segment = segments[s],
+                                               segment_indices, first_owned]() {
+            return processSegment(video_path, segment_indices, first_owned, segment);
+        }));
+    }
+    bool decoded = true;
+    waitAll(threadPool(), pending, [&decoded](size_t, bool ok) { decoded = decoded && ok; });
+    
+    // A segment that stopped short would score the video on fewer frames
+    if (!decoded) {
+        std::cerr << "Failed to decode every sampled frame of video: " << video_path << std::endl;
+        return analysis;
+    }
+    
+    // Concatenate in timeline order so the reduction matches the sequential path
+    AnalyzerSamples samples(analyzers_.size());
+    for (const auto& segment : segments) {
+        for (size_t a = 0; a < samples.size(); ++a) {
+            samples[a].insert(samples[a].end(), segment[a].begin(), segment[a].end());
+        }
+    }
+    
+    if (samples[0].empty()) {
+        std::cerr << "No frames extracted from video: " << video_path << std::endl;
+        return analysis;
+    }
+    
+    analysis.score = reduceSamples(samples, analysis);
+    analysis.frames_used = static_cast<int>(samples[0].size());
+    return analysis;
 }
 
-std::vector<cv::Mat> VideoProcessor::extractFrames(const std::string& video_path, int max_frames) {
+bool VideoProcessor::processSegment(const std::string& video_path, const std::vector<int>& frame_indices,
+                                    size_t first_owned, AnalyzerSamples& samples) {
+    // Segment tasks wait on their feature tasks by helping the pool
+    FrameProducts products = makeProducts(true);
+    if (!decodeFrames(video_path, frame_indices, first_owned, products)) {
+        return false;
+    }
+    samples = collectSamples(products);
+    return true;
+}
+
+bool VideoProcessor::decodeFrames(const std::string& video_path, const std::vector<int>& frame_indices,
+                                  size_t first_owned, FrameProducts& products) {
+    // Each segment owns an independent capture
     cv::VideoCapture cap(video_path);
     if (!cap.isOpened()) {
         std::cerr << "Failed to open video: " << video_path << std::endl;
-        return {};
+        return false;
     }
     
-    std::vector<cv::Mat> frames;
-    int total_frames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
-    int frame_interval = std::max(1, total_frames / max_frames);
+    int position = seekAtOrBefore(cap, video_path, frame_indices.front());
+    if (position < 0) {
+        std::cerr << "Failed to open video: " << video_path << std::endl;
+        return false;
+    }
     
+    // Grab every frame but only convert the sampled ones
+    ScopedTimer timer(ProfileStage::FrameExtraction);
+    size_t next = 0;
     cv::Mat frame;
-    int frame_count = 0;
-    
-    while (cap.read(frame) && frames.size() < static_cast<size_t>(max_frames)) {
-        if (frame_count % frame_interval == 0) {
-            // Resize frame to minimum size
-            if (frame.rows < MIN_FRAME_SIZE || frame.cols < MIN_FRAME_SIZE) {
-                cv::resize(frame, frame, cv::Size(MIN_FRAME_SIZE, MIN_FRAME_SIZE));
+    while (next < frame_indices.size() && grabFrame(cap)) {
+        if (position == frame_indices[next]) {
+            if (!retrieveFrame(cap, frame)) {
+                break;
             }
-            frames.push_back(frame.clone());
+            normalizeFrameSize(frame);
+            products.addFrame(position, frame.clone(), next >= first_owned);
+            ++next;
         }
-        frame_count++;
+        ++position;
     }
-    
     cap.release();
-    return frames;
+    return next == frame_indices.size();
 }
 
-std::vector<float> VideoProcessor::processFrames(const std::vector<cv::Mat>& frames) {
-    std::vector<float> scores;
+VideoAnalysis VideoProcessor::analyzeVideoCached(const std::string& video_path) {
+    VideoAnalysis analysis;
     
-    for (const auto& frame : frames) {
-        // Extract features from frame
-        Eigen::VectorXf features = feature_extractor_->extractFeatures(frame);
-        
-        // For now, we'll use a simple heuristic based on feature statistics
-        // In a real implementation, you'd use the trained neural network
-        
-        // Calculate feature statistics
-        float mean = features.mean();
-        float stddev = std::sqrt((features.array() - mean).square().mean());
-        
-        // Simple heuristic: AI-generated content often has more uniform feature distributions
-        float uniformity_score = 1.0f - std::min(stddev, 1.0f);
+    FileIdentity identity;
+    if (!FileIdentity::read(video_path, identity)) {
+        std::cerr << "Failed to open video: " << video_path << std::endl;
+        return analysis;
+    }
+    SegmentCache cache(caching_.directory);
+    const uint64_t settings = cacheSettings();
+    int total_frames = 0;
+    std::map<int, CachedSegment> segments = cache.load(video_path, identity, settings, total_frames);
+    
+    // An unchanged file keeps its stored frame count and is never opened
+    if (total_frames <= 0) {
+        cv::VideoCapture cap(video_path);
+        if (!cap.isOpened()) {
+            std::cerr << "Failed to open video: " << video_path << std::endl;
+            return analysis;
+        }
+        total_frames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+        cap.release();
+    }
+    
+    // Without a frame count there is no segment grid to cache against
+    if (total_frames <= 0) {
+        return analyzeVideoSequential(video_path);
+    }
+    
+    // Segment s owns samples [s * per_segment, (s + 1) * per_segment), each
+    // frame_stride source frames apart
+    const int stride = std::max(1, caching_.frame_stride);
+    const int per_segment = std::max(1, caching_.segment_samples);
+    const int sample_count = (total_frames + stride - 1) / stride;
+    const int segment_count = (sample_count + per_segment - 1) / per_segment;
+    segments.erase(segments.lower_bound(segment_count), segments.end());
+    
+    // Decode the missing segments in parallel; as in the parallel path, each
+    // one after the first also decodes the previous sample for the boundary pair
+    std::vector<int> missing;
+    std::vector<std::future<bool>> pending;
+    std::vector<CachedSegment> decoded(segment_count);
+    for (int s = 0; s < segment_count; ++s) {
+        if (segments.count(s)) {
+            continue;
+        }
+        int begin = s * per_segment;
+        int end = std::min(begin + per_segment, sample_count);
+        int first = (s == 0) ? begin : begin - 1;
+        std::vector<int> segment_indices;
+        for (int k = first; k < end; ++k) {
+            segment_indices.push_back(k * stride);
+        }
+        size_t first_owned = static_cast<size_t>(begin - first);
         
-        scores.push_back(uniformity_score);
+        missing.push_back(s);
+        pending.push_back(threadPool().submit([this, &video_path, &segment = decoded[s],
+                                               segment_indices, first_owned]() {
+            return processCachedSegment(video_path, segment_indices, first_owned, segment);
+        }));
+    }
+    // Saved every few segments, so an interrupted run keeps what it decoded;
+    // a segment that stopped short is not cached and fails the analysis
+    size_t unsaved = 0;
+    bool complete = true;
+    waitAll(threadPool(), pending, [&](size_t m, bool ok) {
+        if (!ok) {
+            complete = false;
+            return;
+        }
+        // Only a full-length segment stays valid once the file grows
+        int planned = std::min(per_segment, sample_count - missing[m] * per_segment);
+        decoded[missing[m]].complete = planned == per_segment;
+        segments[missing[m]] = std::move(decoded[missing[m]]);
+        if (++unsaved >= CACHE_SAVE_BATCH) {
+            cache.save(identity, settings, total_frames, segments);
+            unsaved = 0;
+        }
+    });
+    if (unsaved > 0) {
+        cache.save(identity, settings, total_frames, segments);
+    }
+    if (!complete) {
+        std::cerr << "Failed to decode every sampled frame of video: " << video_path << std::endl;
+        return analysis;
     }
+    Profiler::count(ProfileCounter::SegmentsReused, segment_count - missing.size());
+    Profiler::count(ProfileCounter::SegmentsDecoded, missing.size());
     
-    return scores;
+    // Model-independent samples come straight from the segments; frames are
+    // scored with the current model in one batch
+    const size_t frame_slot = analyzerSlot(frame_analyzer_);
+    AnalyzerSamples samples(analyzers_.size());
+    Eigen::Index rows = 0, cols = 0;
+    for (const auto& entry : segments) {
+        const CachedSegment& segment = entry.second;
+        if (segment.features.cols() > 0) {
+            rows = segment.features.rows();
+            cols += segment.features.cols();
+        }
+        for (size_t a = 0; a < samples.size() && a < segment.samples.size(); ++a) {
+            samples[a].insert(samples[a].end(), segment.samples[a].begin(), segment.samples[a].end());
+        }
+    }
+    if (cols == 0) {
+        std::cerr << "No frames extracted from video: " << video_path << std::endl;
+        return analysis;
+    }
+    Eigen::MatrixXf features(rows, cols);
+    Eigen::Index column = 0;
+    for (const auto& entry : segments) {
+        const Eigen::MatrixXf& segment_features = entry.second.features;
+        if (segment_features.cols() > 0) {
+            features.middleCols(column, segment_features.cols()) = segment_features;
+            column += segment_features.cols();
+        }
+    }
+    samples[frame_slot] = frame_analyzer_->score(features);
+    
+    analysis.score = reduceSamples(samples, analysis);
+    analysis.frames_used = static_cast<int>(cols);
+    analysis.segments = segment_count;
+    analysis.segments_reused = segment_count - static_cast<int>(missing.size());
+    return analysis;
 }
 
-float VideoProcessor::analyzeTemporalConsistency(const std::vector<cv::Mat>& frames) {
-    if (frames.size() < 2) {
-        return 0.5f; // Neutral score for single frame
+bool VideoProcessor::processCachedSegment(const std::string& video_path,
+                                          const std::vector<int>& frame_indices,
+                                          size_t first_owned, CachedSegment& segment) {
+    FrameProducts products = makeProducts(true);
+    if (!decodeFrames(video_path, frame_indices, first_owned, products)) {
+        return false;
+    }
+    
+    // Features instead of frame scores, so another model can reuse the segment
+    segment.features = products.ownedFeatures();
+    segment.samples.resize(analyzers_.size());
+    for (size_t a = 0; a < analyzers_.size(); ++a) {
+        if (analyzers_[a].analyzer.get() != frame_analyzer_) {
+            segment.samples[a] = analyzers_[a].analyzer->collect(products);
+        }
+    }
+    return true;
+}
+
+uint64_t VideoProcessor::cacheSettings() const {
+    std::ostringstream settings;
+    settings << "stride=" << caching_.frame_stride << ";segment=" << caching_.segment_samples
+             << ";min_size=" << MIN_FRAME_SIZE
+             << ";motion=" << static_cast<int>(motion_engine_.getQuality())
+             << ";incremental=" << incremental_features_ << ";analyzers=";
+    for (const auto& entry : analyzers_) {
+        settings << entry.analyzer->name() << ",";
+    }
+    
+    // FNV-1a
+    uint64_t hash = 1469598103934665603ull;
+    for (char c : settings.str()) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+VideoAnalysis VideoProcessor::analyzeVideoAdaptive(const std::string& video_path) {
+    VideoAnalysis analysis;
+    
+    cv::VideoCapture cap(video_path);
+    if (!cap.isOpened()) {
+        std::cerr << "Failed to open video: " << video_path << std::endl;
+        return analysis;
+    }
+    int total_frames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    
+    // Seeking needs a frame count; fall back to the uniform path without one
+    int max_frames = std::max(1, adaptive_.max_frames);
+    std::vector<int> grid = sampleFrameIndices(total_frames, max_frames);
+    if (grid.empty()) {
+        cap.release();
+        return analyzeVideoSequential(video_path);
     }
     
-    std::vector<float> frame_differences = calculateFrameDifferences(frames);
+    // One product cache for the whole run: features and pair results of
+    // earlier rounds are reused as new frames are inserted between them
+    std::vector<size_t> order = coarseToFineOrder(grid.size());
+    FrameProducts products = makeProducts(true);
     
-    // Calculate temporal variance
-    float temporal_variance = calculateTemporalVariance(frames);
+    // Rounds double in size so each round refines the previous coverage and
+    // its frames are still scored in one batch
+    size_t next = 0;
+    size_t round_size = 1;
+    size_t min_frames = static_cast<size_t>(std::max(2, adaptive_.min_frames));
+    cv::Mat frame;
+    while (next < order.size()) {
+        size_t added = 0;
+        while (added < round_size && next < order.size()) {
+            int index = grid[order[next++]];
+            cap.set(cv::CAP_PROP_POS_FRAMES, index);
+            if (!readFrame(cap, frame)) {
+                continue;
+            }
+            normalizeFrameSize(frame);
+            products.addFrame(index, frame.clone());
+            ++added;
+        }
+        round_size = std::max<size_t>(1, products.frameCount());
+        
+        if (products.frameCount() < min_frames) {
+            continue;
+        }
+        
+        float margin = 0.0f;
+        analysis.score = estimateAdaptiveScore(products, margin);
+        if (analysis.score - margin > adaptive_.high_threshold ||
+            analysis.score + margin < adaptive_.low_threshold) {
+            analysis.stopped_early = next < order.size();
+            break;
+        }
+    }
+    cap.release();
     
-    // AI-generated videos often have more consistent frame-to-frame differences
-    // Real videos typically have more natural variation
-    float consistency_score = 1.0f - std::min(temporal_variance, 1.0f);
+    if (products.frameCount() == 0) {
+        std::cerr << "No frames extracted from video: " << video_path << std::endl;
+        return analysis;
+    }
     
-    return consistency_score;
+    AnalyzerSamples samples = collectSamples(products);
+    analysis.score = reduceSamples(samples, analysis);
+    analysis.frames_used = static_cast<int>(products.frameCount());
+    return analysis;
 }
 
-float VideoProcessor::analyzeMotionPatterns(const std::vector<cv::Mat>& frames) {
-    if (frames.size() < 2) {
-        return 0.5f; // Neutral score for single frame
+VideoAnalysis VideoProcessor::analyzeVideoDeadline(const std::string& video_path, const Deadline& deadline) {
+    using Clock = std::chrono::steady_clock;
+    VideoAnalysis analysis;
+    
+    cv::VideoCapture cap(video_path);
+    if (!cap.isOpened()) {
+        std::cerr << "Failed to open video: " << video_path << std::endl;
+        return analysis;
+    }
+    int total_frames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    
+    // Rounds need seeking, and seeking needs a frame count
+    int max_frames = adaptive_.enabled ? std::max(1, adaptive_.max_frames) : MAX_FRAMES;
+    std::vector<int> grid = sampleFrameIndices(total_frames, max_frames);
+    if (grid.empty()) {
+        cap.release();
+        return analyzeVideoSequential(video_path);
     }
     
-    std::vector<float> motion_scores;
+    const size_t motion_slot = analyzerSlot(motion_analyzer_);
     
-    for (size_t i = 1; i < frames.size(); ++i) {
-        cv::Mat flow = calculateOpticalFlow(frames[i-1], frames[i]);
+    std::vector<size_t> order = coarseToFineOrder(grid.size());
+    FrameProducts products = makeProducts(true);
+    AnalyzerSamples samples(analyzers_.size());
+    const MotionQuality requested_quality = products.motionQuality();
+    bool motion_planned = false;
+    bool motion_running = true;
+    double frame_cost_ms = 0.0;     // Decode and non-motion stages, per frame
+    
+    size_t next = 0;
+    size_t round_size = 1;
+    cv::Mat frame;
+    while (next < order.size()) {
+        if (products.frameCount() > 0 && !deadline.allows(frame_cost_ms * round_size)) {
+            analysis.quality.add(DegradedStage::FramesReduced);
+            break;
+        }
         
-        // Calculate motion magnitude
-        cv::Mat magnitude, angle;
-        std::vector<cv::Mat> flow_parts;
-        cv::split(flow, flow_parts);
-        cv::cartToPolar(flow_parts[0], flow_parts[1], magnitude, angle);
+        auto round_start = Clock::now();
+        size_t added = 0;
+        while (added < round_size && next < order.size()) {
+            int index = grid[order[next++]];
+            cap.set(cv::CAP_PROP_POS_FRAMES, index);
+            if (!readFrame(cap, frame)) {
+                continue;
+            }
+            normalizeFrameSize(frame);
+            products.addFrame(index, frame.clone());
+            ++added;
+        }
+        round_size = std::max<size_t>(1, products.frameCount());
+        if (added == 0) {
+            continue;
+        }
         
-        // Calculate motion statistics
-        cv::Scalar mean_magnitude = cv::mean(magnitude);
-        cv::Scalar stddev_magnitude;
-        cv::meanStdDev(magnitude, cv::noArray(), stddev_magnitude);
+        for (size_t a = 0; a < analyzers_.size(); ++a) {
+            if (a != motion_slot) {
+                samples[a] = analyzers_[a].analyzer->collect(products);
+            }
+        }
+        frame_cost_ms = std::chrono::duration<double, std::milli>(Clock::now() - round_start).count() / added;
+        
+        if (motion_slot == analyzers_.size() || !motion_running || products.frameCount() < 2) {
+            continue;
+        }
         
-        // AI-generated videos often have more uniform motion patterns
-        float motion_uniformity = 1.0f - std::min(stddev_magnitude[0] / (mean_magnitude[0] + 1e-6f), 1.0f);
-        motion_scores.push_back(motion_uniformity);
+        // Pick the flow tier once, before any frame is prepared for it
+        if (!motion_planned) {
+            motion_planned = true;
+            double remaining_frames = static_cast<double>(order.size() - next);
+            double plan_ms = motion_cost_ms_[static_cast<int>(requested_quality)].load() * (grid.size() - 1) +
+                             frame_cost_ms * remaining_frames;
+            if (requested_quality != MotionQuality::Block && !deadline.allows(plan_ms)) {
+                products.setMotionQuality(MotionQuality::Block);
+                analysis.quality.add(DegradedStage::MotionReduced);
+            }
+        }
+        
+        // Each inserted frame splits one pair into two
+        std::atomic<double>& pair_cost_ms = motion_cost_ms_[static_cast<int>(products.motionQuality())];
+        size_t new_pairs = std::min(products.frameCount() - 1, added * 2);
+        if (!deadline.allows(pair_cost_ms.load() * new_pairs)) {
+            // Keep the pairs scored so far
+            motion_running = false;
+            analysis.quality.add(samples[motion_slot].empty() ? DegradedStage::MotionSkipped
+                                                               : DegradedStage::MotionReduced);
+            continue;
+        }
+        auto motion_start = Clock::now();
+        samples[motion_slot] = analyzers_[motion_slot].analyzer->collect(products);
+        double measured = std::chrono::duration<double, std::milli>(Clock::now() - motion_start).count() / new_pairs;
+        // Concurrent analyses may race here; the estimate only has to stay plausible
+        double cost = pair_cost_ms.load();
+        pair_cost_ms.store(cost + COST_SMOOTHING * (measured - cost));
     }
+    cap.release();
     
-    // Average motion score
-    float avg_motion_score = 0.0f;
-    for (float score : motion_scores) {
-        avg_motion_score += score;
+    if (products.frameCount() == 0) {
+        std::cerr << "No frames extracted from video: " << video_path << std::endl;
+        return analysis;
+    }
+    if (motion_slot < analyzers_.size() && samples[motion_slot].empty() && grid.size() > 1) {
+        analysis.quality.add(DegradedStage::MotionSkipped);
     }
-    avg_motion_score /= motion_scores.size();
     
-    return avg_motion_score;
+    // Stages skipped altogether are left out and the others reweighted
+    float score = 0.0f;
+    float weight = 0.0f;
+    for (size_t a = 0; a < analyzers_.size(); ++a) {
+        if (a == motion_slot && analysis.quality.has(DegradedStage::MotionSkipped)) {
+            continue;
+        }
+        float analyzer_score = analyzers_[a].analyzer->reduce(samples[a]);
+        analysis.analyzer_scores[analyzers_[a].analyzer->name()] = analyzer_score;
+        score += analyzers_[a].weight * analyzer_score;
+        weight += analyzers_[a].weight;
+    }
+    analysis.score = weight > 0.0f ? score / weight : -1.0f;
+    analysis.frames_used = static_cast<int>(products.frameCount());
+    return analysis;
 }
 
-cv::Mat VideoProcessor::calculateOpticalFlow(const cv::Mat& frame1, const cv::Mat& frame2) {
-    cv::Mat gray1, gray2;
+VideoAnalysis VideoProcessor::analyzeVideoShots(const std::string& video_path) {
+    cv::VideoCapture cap(video_path);
+    if (!cap.isOpened()) {
+        std::cerr << "Failed to open video: " << video_path << std::endl;
+        return VideoAnalysis();
+    }
     
-    if (frame1.channels() == 3) {
-        cv::cvtColor(frame1, gray1, cv::COLOR_BGR2GRAY);
-    } else {
-        gray1 = frame1.clone();
+    // Pre-pass: grab every frame, convert only a few thumbnails per second
+    std::vector<std::pair<int, int>> shots = detectShots(cap);
+    std::vector<int> selected = selectShotFrames(shots);
+    if (selected.empty()) {
+        cap.release();
+        return analyzeVideoSequential(video_path);
     }
     
-    if (frame2.channels() == 3) {
-        cv::cvtColor(frame2, gray2, cv::COLOR_BGR2GRAY);
-    } else {
-        gray2 = frame2.clone();
+    // Second pass: seek straight to the representatives
+    std::vector<cv::Mat> frames;
+    {
+        ScopedTimer timer(ProfileStage::FrameExtraction);
+        cv::Mat frame;
+        for (int index : selected) {
+            cap.set(cv::CAP_PROP_POS_FRAMES, index);
+            if (!readFrame(cap, frame)) {
+                continue;
+            }
+            normalizeFrameSize(frame);
+            frames.push_back(frame.clone());
+        }
+        cap.release();
     }
     
-    // Calculate optical flow using Farneback method
-    cv::Mat flow;
-    cv::calcOpticalFlowFarneback(gray1, gray2, flow, 0.5, 3, 15, 3, 5, 1.2, 0);
+    if (frames.empty()) {
+        std::cerr << "No frames extracted from video: " << video_path << std::endl;
+        return VideoAnalysis();
+    }
     
-    return flow;
+    // Only the representatives go through feature extraction and optical flow
+    VideoAnalysis analysis = analyzeFrameSet(frames);
+    analysis.shots = static_cast<int>(shots.size());
+    return analysis;
 }
 
-std::vector<float> VideoProcessor::calculateFrameDifferences(const std::vector<cv::Mat>& frames) {
-    std::vector<float> differences;
+std::vector<std::pair<int, int>> VideoProcessor::detectShots(cv::VideoCapture& cap) const {
+    std::vector<std::pair<int, int>> shots;
     
-    for (size_t i = 1; i < frames.size(); ++i) {
-        cv::Mat diff;
-        cv::absdiff(frames[i-1], frames[i], diff);
-        
-        // Convert to grayscale if needed
-        if (diff.channels() == 3) {
-            cv::cvtColor(diff, diff, cv::COLOR_BGR2GRAY);
+    double fps = cap.get(cv::CAP_PROP_FPS);
+    int stride = 1;
+    if (fps > 0.0 && shots_.samples_per_second > 0.0f) {
+        stride = std::max(1, static_cast<int>(fps / shots_.samples_per_second));
+    }
+    
+    const int channels[] = {0};
+    const int bins[] = {shots_.histogram_bins};
+    const float range[] = {0.0f, 256.0f};
+    const float* ranges[] = {range};
+    
+    cv::Mat frame, thumbnail, gray, histogram, prev_histogram;
+    int position = 0;
+    int shot_start = 0;
+    while (grabFrame(cap)) {
+        if (position % stride == 0 && retrieveFrame(cap, frame)) {
+            cv::resize(frame, thumbnail, cv::Size(shots_.thumbnail_size, shots_.thumbnail_size), 0, 0, cv::INTER_AREA);
+            if (thumbnail.channels() == 3) {
+                cv::cvtColor(thumbnail, gray, cv::COLOR_BGR2GRAY);
+            } else {
+                gray = thumbnail;
+            }
+            cv::calcHist(&gray, 1, channels, cv::noArray(), histogram, 1, bins, ranges);
+            cv::normalize(histogram, histogram, 1.0, 0.0, cv::NORM_L1);
+            
+            if (!prev_histogram.empty() &&
+                cv::compareHist(prev_histogram, histogram, cv::HISTCMP_BHATTACHARYYA) > shots_.cut_threshold) {
+                shots.emplace_back(shot_start, position);
+                shot_start = position;
+            }
+            prev_histogram = histogram.clone();
         }
-        
-        // Calculate mean difference
-        cv::Scalar mean_diff = cv::mean(diff);
-        differences.push_back(mean_diff[0] / 255.0f);
+        ++position;
     }
     
-    return differences;
+    if (position > shot_start) {
+        shots.emplace_back(shot_start, position);
+    }
+    return shots;
 }
 
-float VideoProcessor::calculateTemporalVariance(const std::vector<cv::Mat>& frames) {
-    if (frames.size() < 2) {
-        return 0.0f;
+std::vector<int> VideoProcessor::selectShotFrames(const std::vector<std::pair<int, int>>& shots) const {
+    std::vector<int> selected;
+    if (shots.empty()) {
+        return selected;
     }
     
-    std::vector<float> differences = calculateFrameDifferences(frames);
+    int total = shots.back().second - shots.front().first;
+    int budget = std::max(1, shots_.max_frames);
+    int per_shot_cap = std::max(1, shots_.frames_per_shot);
     
-    // Calculate variance of frame differences
-    float mean_diff = 0.0f;
-    for (float diff : differences) {
-        mean_diff += diff;
+    // Share the budget by shot length: at least one frame per shot, at most the cap
+    std::vector<int> counts(shots.size());
+    int assigned = 0;
+    for (size_t i = 0; i < shots.size(); ++i) {
+        int length = shots[i].second - shots[i].first;
+        int share = static_cast<int>(static_cast<double>(length) * budget / std::max(1, total) + 0.5);
+        counts[i] = std::min({std::max(1, share), per_shot_cap, length});
+        assigned += counts[i];
+    }
+    
+    // Over budget (many short shots): drop frames from the shortest shots first
+    std::vector<size_t> by_length(shots.size());
+    for (size_t i = 0; i < shots.size(); ++i) {
+        by_length[i] = i;
+    }
+    std::sort(by_length.begin(), by_length.end(), [&shots](size_t a, size_t b) {
+        return shots[a].second - shots[a].first < shots[b].second - shots[b].first;
+    });
+    for (size_t k = 0; assigned > budget && k < by_length.size(); ++k) {
+        int removed = std::min(counts[by_length[k]], assigned - budget);
+        counts[by_length[k]] -= removed;
+        assigned -= removed;
     }
-    mean_diff /= differences.size();
     
+    // Representatives are evenly spaced inside each shot, away from the cuts
+    for (size_t i = 0; i < shots.size(); ++i) {
+        int length = shots[i].second - shots[i].first;
+        for (int j = 0; j < counts[i]; ++j) {
+            selected.push_back(shots[i].first + static_cast<int>((j + 0.5) * length / counts[i]));
+        }
+    }
+    return selected;
+}
+
+float VideoProcessor::estimateAdaptiveScore(FrameProducts& products, float& margin) {
+    AnalyzerSamples samples = collectSamples(products);
+    VideoAnalysis analysis;
+    float score = reduceSamples(samples, analysis);
+    
+    // Confidence interval on the frame term; the other stages are taken as
+    // point estimates
+    const size_t frame_slot = analyzerSlot(frame_analyzer_);
+    const std::vector<float>& frame_scores = samples[frame_slot];
+    float n = static_cast<float>(frame_scores.size());
+    float mean = 0.0f;
+    for (float value : frame_scores) {
+        mean += value;
+    }
+    mean /= n;
     float variance = 0.0f;
-    for (float diff : differences) {
-        variance += (diff - mean_diff) * (diff - mean_diff);
+    for (float value : frame_scores) {
+        variance += (value - mean) * (value - mean);
     }
-    variance /= differences.size();
+    variance /= std::max(1.0f, n - 1.0f);
+    float total_weight = totalWeight();
+    float share = total_weight > 0.0f ? analyzers_[frame_slot].weight / total_weight : 0.0f;
+    margin = share * adaptive_.confidence_z * std::sqrt(variance / n);
     
-    return variance;
-} 
\ No newline at end of file
+    return score;
+}
+
+std::vector<size_t> VideoProcessor::coarseToFineOrder(size_t count) const {
+    // Van der Corput (bit-reversal) order: 0, 1/2, 1/4, 3/4, 1/8, ... of the timeline
+    std::vector<size_t> order;
+    std::vector<bool> seen(count, false);
+    size_t levels = 1;
+    while (levels < count) {
+        levels <<= 1;
+    }
+    for (size_t k = 0; k < levels; ++k) {
+        double position = 0.0;
+        double scale = 0.5;
+        for (size_t bits = k; bits > 0; bits >>= 1, scale *= 0.5) {
+            if (bits & 1) {
+                position += scale;
+            }
+        }
+        size_t index = static_cast<size_t>(position * count);
+        if (index < count && !seen[index]) {
+            seen[index] = true;
+            order.push_back(index);
+        }
+    }
+    return order;
+}
+
+std::vector<cv::Mat> VideoProcessor::extractFrames(const std::string& video_path, int max_frames) {
+    ScopedTimer timer(ProfileStage::FrameExtraction);
+    cv::VideoCapture cap(video_path);
+    if (!cap.isOpened()) {
+        std::cerr << "Failed to open video: " << video_path << std::endl;
+        return {};
+    }
+    
+    std::vector<cv::Mat> frames;
+    int total_frames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    int frame_interval = std::max(1, total_frames / max_frames);
+    
+    cv::Mat frame;
+    int frame_count = 0;
+    
+    while (readFrame(cap, frame) && frames.size() < static_cast<size_t>(max_frames)) {
+        if (frame_count % frame_interval == 0) {
+            normalizeFrameSize(frame);
+            frames.push_back(frame.clone());
+        }
+        frame_count++;
+    }
+    
+    cap.release();
+    return frames;
+}
+
+std::vector<float> VideoProcessor::processFrames(const std::vector<cv::Mat>& frames) {
+    FrameProducts products = makeProducts(frames, true);
+    return frame_analyzer_->collect(products);
+}
+
+float VideoProcessor::analyzeTemporalConsistency(const std::vector<cv::Mat>& frames) {
+    if (frames.size() < 2) {
+        return 0.5f; // Neutral score for single frame
+    }
+    
+    TemporalConsistencyAnalyzer analyzer;
+    FrameProducts products = makeProducts(frames, false);
+    return analyzer.reduce(analyzer.collect(products));
+}
+
+float VideoProcessor::analyzeMotionPatterns(const std::vector<cv::Mat>& frames) {
+    if (frames.size() < 2) {
+        return 0.5f; // Neutral score for single frame
+    }
+    
+    MotionPatternAnalyzer analyzer;
+    FrameProducts products = makeProducts(frames, false);
+    return analyzer.reduce(analyzer.collect(products));
+}
+
+FrameProducts VideoProcessor::makeProducts(bool parallel) {
+    return FrameProducts(motion_engine_, [this, parallel](const std::vector<cv::Mat>& frames) {
+        return extractFrameFeatures(frames, parallel);
+    });
+}
+
+FrameProducts VideoProcessor::makeProducts(const std::vector<cv::Mat>& frames, bool parallel) {
+    FrameProducts products = makeProducts(parallel);
+    for (size_t i = 0; i < frames.size(); ++i) {
+        products.addFrame(static_cast<int>(i), frames[i]);
+    }
+    return products;
+}
+
+VideoProcessor::AnalyzerSamples VideoProcessor::collectSamples(FrameProducts& products) {
+    AnalyzerSamples samples;
+    for (auto& entry : analyzers_) {
+        samples.push_back(entry.analyzer->collect(products));
+    }
+    return samples;
+}
+
+float VideoProcessor::reduceSamples(const AnalyzerSamples& samples, VideoAnalysis& analysis) const {
+    float score = 0.0f;
+    for (size_t a = 0; a < analyzers_.size(); ++a) {
+        float analyzer_score = analyzers_[a].analyzer->reduce(samples[a]);
+        analysis.analyzer_scores[analyzers_[a].analyzer->name()] = analyzer_score;
+        score += analyzers_[a].weight * analyzer_score;
+    }
+    float total_weight = totalWeight();
+    return total_weight > 0.0f ? score / total_weight : -1.0f;
+}
+
+float VideoProcessor::totalWeight() const {
+    float weight = 0.0f;
+    for (const auto& entry : analyzers_) {
+        weight += entry.weight;
+    }
+    return weight;
+}
+
+size_t VideoProcessor::analyzerSlot(const VideoAnalyzer* analyzer) const {
+    for (size_t a = 0; a < analyzers_.size(); ++a) {
+        if (analyzers_[a].analyzer.get() == analyzer) {
+            return a;
+        }
+    }
+    return analyzers_.size();
+}
+
+Eigen::MatrixXf VideoProcessor::extractFrameFeatures(const std::vector<cv::Mat>& frames, bool parallel) {
+    // Frames arrive in timeline order; in incremental mode each chain of
+    // consecutive frames carries the previous frame's accumulators forward
+    auto extract = [this](const cv::Mat& frame, IncrementalFeatureState& state) {
+        return incremental_features_ ? feature_extractor_->extractFeaturesIncremental(frame, state)
+                                     : feature_extractor_->extractFeatures(frame);
+    };
+    
+    IncrementalFeatureState first_state;
+    Eigen::VectorXf first = extract(frames[0], first_state);
+    Eigen::MatrixXf features(first.size(), frames.size());
+    features.col(0) = first;
+    
+    if (!parallel || frames.size() < 2) {
+        for (size_t i = 1; i < frames.size(); ++i) {
+            features.col(i) = extract(frames[i], first_state);
+        }
+        return features;
+    }
+    
+    // One contiguous chain per task; each task writes its own columns, so no
+    // synchronization is needed
+    size_t remaining = frames.size() - 1;
+    size_t chains = std::min(threadPool().size(), remaining);
+    std::vector<std::future<void>> pending;
+    for (size_t c = 0; c < chains; ++c) {
+        size_t begin = 1 + remaining * c / chains;
+        size_t end = 1 + remaining * (c + 1) / chains;
+        pending.push_back(threadPool().submit([&extract, &frames, &features, begin, end]() {
+            IncrementalFeatureState state;
+            for (size_t i = begin; i < end; ++i) {
+                features.col(i) = extract(frames[i], state);
+            }
+        }));
+    }
+    for (auto& future : pending) {
+        threadPool().wait(future);
+    }
+    
+    return features;
+}
+
+std::vector<int> VideoProcessor::sampleFrameIndices(int total_frames, int max_frames) const {
+    // Same sampling as extractFrames: every frame_interval-th frame up to max_frames
+    std::vector<int> indices;
+    if (total_frames <= 0) {
+        return indices;
+    }
+    
+    int frame_interval = std::max(1, total_frames / max_frames);
+    for (int i = 0; i < max_frames && i * frame_interval < total_frames; ++i) {
+        indices.push_back(i * frame_interval);
+    }
+    
+    return indices;
+}
+
+void VideoProcessor::normalizeFrameSize(cv::Mat& frame) const {
+    // Resize frame to minimum size
+    if (frame.rows < MIN_FRAME_SIZE || frame.cols < MIN_FRAME_SIZE) {
+        cv::resize(frame, frame, cv::Size(MIN_FRAME_SIZE, MIN_FRAME_SIZE));
+    }
+}
+
+float VideoProcessor::temporalScore(const std::vector<float>& differences) {
+    return TemporalConsistencyAnalyzer().reduce(differences);
+}
+
+float VideoProcessor::motionScore(const std::vector<float>& motion_scores) {
+    return MotionPatternAnalyzer().reduce(motion_scores);
+}
+
+float VideoProcessor::combineScores(const std::vector<float>& frame_scores,
+                                   const std::vector<float>& differences,
+                                   const std::vector<float>& motion_scores) {
+    // Same weights as the built-in analyzers
+    return 0.6f * FrameScoreAnalyzer().reduce(frame_scores) +
+           0.2f * temporalScore(differences) +
+           0.2f * motionScore(motion_scores);
+}
@@ -71,6 +71,16 @@ if not errorlevel 1 (
 
 echo Missing arguments handling works correctly.
 
+REM Check the SIMD kernel builds against the scalar reference
+echo Testing SIMD kernels...
+ai_detector.exe verify-kernels
+if errorlevel 1 (
+    echo Error: SIMD kernels disagree with the scalar reference.
+    exit /b 1
+)
+
+echo SIMD kernels match the scalar reference.
+
 echo.
 echo All tests passed! The AI detector is ready to use.
 echo.
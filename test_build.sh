@@ -67,6 +67,15 @@ fi
 
 echo "Missing arguments handling works correctly."
 
+# Check the SIMD kernel builds against the scalar reference
+echo "Testing SIMD kernels..."
+if ! ./ai_detector verify-kernels; then
+    echo "Error: SIMD kernels disagree with the scalar reference."
+    exit 1
+fi
+
+echo "SIMD kernels match the scalar reference."
+
 echo ""
 echo "All tests passed! The AI detector is ready to use."
 echo ""